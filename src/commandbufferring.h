@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+
+struct CommandBufferRingCounters
+{
+    uint32_t capacity;
+    uint32_t creations;
+    uint32_t stalls;
+    uint32_t peakDepth;
+};
+
+// Fixed-capacity set of command buffers kept in submission order. Submissions complete in order, so acquiring
+// only looks at the oldest entry: it is reused once the GPU is done with it, a new entry is created while the
+// ring is below capacity, and otherwise the caller waits for the oldest one. Every acquired entry has to be
+// submitted before the ring wraps around to it again.
+template<typename T>
+class CommandBufferRing
+{
+public:
+    explicit CommandBufferRing(uint32_t capacity) : m_Order((std::max)(capacity, 1u))
+    {
+        m_Counters.capacity = static_cast<uint32_t>(m_Order.size());
+        m_Slots.reserve(m_Order.size());
+    }
+
+    // isComplete(slot) must not block, create(slot) fills a new slot and returns false on failure, wait(slot)
+    // blocks until the GPU is done with slot. Returns nullptr only if no slot exists and none could be created.
+    template<typename IsComplete, typename Create, typename Wait>
+    T* Acquire(IsComplete isComplete, Create create, Wait wait)
+    {
+        if (m_Count > 0 && isComplete(m_Slots[m_Order[m_Head]])) {
+            return Rotate();
+        }
+        if (m_Slots.size() < m_Order.size()) {
+            T slot = {};
+            if (create(slot)) {
+                m_Slots.push_back(slot);
+                m_Order[(m_Head + m_Count) % m_Order.size()] = static_cast<uint32_t>(m_Slots.size() - 1);
+                ++m_Count;
+                ++m_Counters.creations;
+                // The oldest entry is still in flight, so is every other one.
+                m_Counters.peakDepth = (std::max)(m_Counters.peakDepth, m_Count);
+                return &m_Slots.back();
+            }
+        }
+        if (m_Count == 0) {
+            return nullptr;
+        }
+        ++m_Counters.stalls;
+        m_Counters.peakDepth = (std::max)(m_Counters.peakDepth, m_Count);
+        wait(m_Slots[m_Order[m_Head]]);
+        return Rotate();
+    }
+
+    // Newest first, the slot being submitted is almost always the one acquired last.
+    template<typename Predicate>
+    T* Find(Predicate predicate)
+    {
+        for (uint32_t i = m_Count; i > 0; --i) {
+            T& slot = m_Slots[m_Order[(m_Head + i - 1) % m_Order.size()]];
+            if (predicate(slot)) {
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    template<typename Function>
+    void ForEach(Function function)
+    {
+        for (T& slot : m_Slots) {
+            function(slot);
+        }
+    }
+
+    void Clear()
+    {
+        m_Slots.clear();
+        m_Head = 0;
+        m_Count = 0;
+    }
+
+    const CommandBufferRingCounters& GetCounters() const { return m_Counters; }
+
+private:
+    CommandBufferRing(const CommandBufferRing&) = delete;
+    CommandBufferRing& operator=(const CommandBufferRing&) = delete;
+
+    // Moves the oldest slot to the back as the newest.
+    T* Rotate()
+    {
+        uint32_t index = m_Order[m_Head];
+        m_Head = (m_Head + 1) % m_Order.size();
+        m_Order[(m_Head + m_Count - 1) % m_Order.size()] = index;
+        return &m_Slots[index];
+    }
+
+private:
+    std::vector<T> m_Slots;
+    std::vector<uint32_t> m_Order;
+    uint32_t m_Head = 0;
+    uint32_t m_Count = 0;
+    CommandBufferRingCounters m_Counters = {};
+};
\ No newline at end of file
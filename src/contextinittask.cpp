@@ -0,0 +1,44 @@
+#include "contextinittask.h"
+
+
+// Abandoned creations still running. Their futures are kept here since destroying one blocks until the
+// creation has finished; finished ones are dropped whenever another creation is abandoned.
+static std::mutex s_AbandonedMutex;
+static std::vector<std::future<void>> s_Abandoned;
+
+void ContextInitTask::Abandon()
+{
+    std::shared_ptr<Job> job = std::move(m_Job);
+    if (job == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->abandoned = true;
+    }
+    std::future<void> task = std::move(m_Task);
+    if (!task.valid() || task.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(s_AbandonedMutex);
+    for (auto it = s_Abandoned.begin(); it != s_Abandoned.end();) {
+        if (it->wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            it = s_Abandoned.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    s_Abandoned.push_back(std::move(task));
+}
+
+void ContextInitTask::WaitForAbandoned()
+{
+    std::vector<std::future<void>> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(s_AbandonedMutex);
+        abandoned.swap(s_Abandoned);
+    }
+    for (auto& task : abandoned) {
+        task.wait();
+    }
+}
\ No newline at end of file
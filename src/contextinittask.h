@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "fsrunityplugin.h"
+
+
+// Tracks the creation of one instance's FFX context. In async mode the creation runs on a worker thread while
+// the render thread keeps going. The worker only builds the context; commit() hands it to the instance while
+// the task is still current, and the status is published with release semantics right after, so a thread that
+// observes INIT_STATUS_READY also sees what commit() wrote.
+//
+// Starting over or resetting never waits for a pending creation. The creation is abandoned instead: once it
+// finishes, discard() releases whatever it created and the instance is not touched again.
+class ContextInitTask
+{
+public:
+    ContextInitTask() = default;
+    ~ContextInitTask() { Abandon(); }
+
+    // create() builds the context and returns whether it succeeded. commit(created) runs if the task is still
+    // current when create() returns, discard() instead if it was superseded after creating a context.
+    template<typename Create, typename Commit, typename Discard>
+    void Start(Create create, Commit commit, Discard discard, bool async)
+    {
+        Abandon();
+        if (!async) {
+            bool created = create();
+            commit(created);
+            Finish(created);
+            return;
+        }
+        struct Callbacks
+        {
+            Create create;
+            Commit commit;
+            Discard discard;
+        };
+        std::shared_ptr<Callbacks> callbacks(new Callbacks{create, commit, discard});
+        std::shared_ptr<Job> job = std::make_shared<Job>();
+        m_Job = job;
+        m_Status.store(FSRUnityPlugin::INIT_STATUS_PENDING, std::memory_order_release);
+        m_Task = std::async(std::launch::async, [this, job, callbacks]() mutable {
+            bool created = callbacks->create();
+            {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                if (job->abandoned) {
+                    if (created) {
+                        callbacks->discard();
+                    }
+                } else {
+                    callbacks->commit(created);
+                    Finish(created);
+                }
+            }
+            // The future keeps this lambda until it is destroyed, drop what the callbacks hold now.
+            callbacks.reset();
+        });
+    }
+
+    void Reset()
+    {
+        Abandon();
+        m_Status.store(FSRUnityPlugin::INIT_STATUS_NONE, std::memory_order_relaxed);
+    }
+
+    uint32_t GetStatus() const { return m_Status.load(std::memory_order_acquire); }
+    bool IsReady() const { return GetStatus() == FSRUnityPlugin::INIT_STATUS_READY; }
+    bool IsPending() const { return GetStatus() == FSRUnityPlugin::INIT_STATUS_PENDING; }
+
+    // Blocks until every abandoned creation has finished and released its context. Called before the device
+    // goes away.
+    static void WaitForAbandoned();
+
+private:
+    ContextInitTask(const ContextInitTask&) = delete;
+    ContextInitTask& operator=(const ContextInitTask&) = delete;
+
+    struct Job
+    {
+        std::mutex mutex;
+        bool abandoned = false;
+    };
+
+    void Finish(bool created)
+    {
+        m_Status.store(created ? FSRUnityPlugin::INIT_STATUS_READY : FSRUnityPlugin::INIT_STATUS_FAILED, std::memory_order_release);
+    }
+
+    // Only waits for a commit() in progress, never for the creation itself.
+    void Abandon();
+
+private:
+    std::atomic<uint32_t> m_Status = {FSRUnityPlugin::INIT_STATUS_NONE};
+    std::shared_ptr<Job> m_Job;
+    std::future<void> m_Task;
+};
\ No newline at end of file
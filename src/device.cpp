@@ -14,6 +14,9 @@
 #if defined(FSR_BACKEND_VK) || defined(FSR_BACKEND_ALL)
 #include "device_vk.h"
 #endif
+#if defined(FSR_BACKEND_NULL)
+#include "device_null.h"
+#endif
 
 
 Device& Device::Instance(UnityGfxRenderer deviceType)
@@ -38,6 +41,11 @@ Device& Device::Instance(UnityGfxRenderer deviceType)
         break;
 #endif
     case kUnityGfxRendererNull:
+#if defined(FSR_BACKEND_NULL)
+        if (!instance) {
+            instance.reset(new DeviceNull);
+        }
+#endif
         break;
     default:
         FSR_ERROR("Unsupported backend");
@@ -57,9 +65,81 @@ bool Device::Init(IUnityInterfaces* unityInterfaces)
 
 void Device::Destroy()
 {
+    StopGpuTimestamps();
     if (m_Initialized) {
         m_pUnityInterfaces = nullptr;
         m_Initialized = false;
         InternalDestroy();
     }
+}
+
+void Device::DeferRelease(uint64_t fenceValue, std::function<void()> release)
+{
+    std::lock_guard<std::mutex> lock(m_DeferredReleaseMutex);
+    m_DeferredReleases.push_back(DeferredRelease{fenceValue, std::move(release)});
+    m_DeferredReleaseCount.store(static_cast<uint32_t>(m_DeferredReleases.size()), std::memory_order_release);
+}
+
+void Device::RetireDeferredReleases()
+{
+    if (m_DeferredReleaseCount.load(std::memory_order_acquire) == 0) {
+        return;
+    }
+    uint64_t completedValue = GetCompletedFenceValue();
+    {
+        std::lock_guard<std::mutex> lock(m_DeferredReleaseMutex);
+        m_RetiringReleases.swap(m_DeferredReleases);
+        m_DeferredReleaseCount.store(0, std::memory_order_release);
+    }
+    // Released outside the lock, a release may queue further work. The two queues trade buffers, so retiring does
+    // not allocate once they have grown; releases whose fence is still pending are queued again.
+    for (auto& deferred : m_RetiringReleases) {
+        if (deferred.fenceValue <= completedValue) {
+            deferred.release();
+        } else {
+            DeferRelease(deferred.fenceValue, std::move(deferred.release));
+        }
+    }
+    m_RetiringReleases.clear();
+}
+
+void Device::FlushDeferredReleases()
+{
+    std::vector<DeferredRelease> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_DeferredReleaseMutex);
+        pending.swap(m_DeferredReleases);
+        m_DeferredReleaseCount.store(0, std::memory_order_release);
+    }
+    if (!pending.empty()) {
+        Wait();
+    }
+    for (auto& deferred : pending) {
+        deferred.release();
+    }
+}
+
+bool Device::SetGpuTimestamps(bool enabled)
+{
+    if (!enabled) {
+        StopGpuTimestamps();
+        return true;
+    }
+    if (!m_Initialized || !InternalInitGpuTimers()) {
+        return false;
+    }
+    m_GpuTimestamps.store(true, std::memory_order_release);
+    return true;
+}
+
+GpuTimerStatus Device::ReadGpuTimer(uint64_t timer, uint64_t fenceValue, uint64_t& nanoseconds)
+{
+    // The backend may release its queries once timestamps are off.
+    if (timer == InvalidGpuTimer || m_LastGpuTimer - timer >= GpuTimerCapacity || !m_GpuTimestamps.load(std::memory_order_acquire)) {
+        return GPU_TIMER_LOST;
+    }
+    if (GetCompletedFenceValue() < fenceValue) {
+        return GPU_TIMER_PENDING;
+    }
+    return InternalReadGpuTimer(static_cast<uint32_t>(timer % GpuTimerCapacity), nanoseconds);
 }
\ No newline at end of file
@@ -1,16 +1,39 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
 
 #include "IUnityInterface.h"
 #include "IUnityGraphics.h"
+#include "commandbufferring.h"
 
 
+enum GpuTimerStatus
+{
+    GPU_TIMER_PENDING = 0,
+    GPU_TIMER_READY,
+    // The timer's queries were reused before its result was read, or the GPU reported none.
+    GPU_TIMER_LOST
+};
+
 class Device
 {
 public:
     static Device& Instance(UnityGfxRenderer deviceType = kUnityGfxRendererNull);
 
+    // Frames the GPU may run behind and plugin submissions per frame. Their product bounds the command buffers a
+    // backend keeps per queue, see CommandBufferRing.
+    static constexpr uint32_t FramesInFlight = 3;
+    static constexpr uint32_t DispatchesPerFrame = 8;
+    static constexpr uint32_t CommandBufferRingCapacity = FramesInFlight * DispatchesPerFrame;
+    // Timers whose queries are kept, a timer is lost once this many later ones have begun. Leaves room for a
+    // batch of instances timed separately in every submission of a frame.
+    static constexpr uint32_t GpuTimerCapacity = 256;
+    static constexpr uint64_t InvalidGpuTimer = 0;
+
 protected:
     Device() {}
 
@@ -21,7 +44,8 @@ private:
     Device& operator=(const Device&&) = delete;
 
 public:
-    virtual ~Device() { Destroy(); }
+    // Each backend destroys itself in its own destructor, InternalDestroy cannot be reached from this one.
+    virtual ~Device() = default;
     bool Init(IUnityInterfaces* unityInterfaces);
     void Destroy();
     virtual UnityGfxRenderer GetDeviceType() = 0;
@@ -34,11 +58,88 @@ public:
     virtual void Wait() {}
     virtual void Wait(uint64_t fenceValue) {}
 
+    // Records plugin work into the command buffer the host is currently recording instead of a private
+    // submission. Returns false if the backend cannot do that.
+    virtual bool SetRecordIntoHostCommandList(bool enabled) { return false; }
+    // Called once per plugin event that records GPU work, before the event is first issued.
+    virtual void ConfigurePluginEvent(int eventID) {}
+    // Called by the plugin event callback with the event it is about to run, and with 0 once it returns. Work
+    // recorded outside an event has no event ID.
+    virtual void SetCurrentPluginEvent(int eventID) {}
+    // Runs plugin work on an asynchronous compute queue. Returns false if the backend has none.
+    virtual bool SetAsyncCompute(bool enabled) { return false; }
+    // Submits the graphics queue half of the async compute hand-offs still pending.
+    virtual void AcquireAsyncCompute() {}
+    // Records the transitions for the states requested through GetNativeResource since the last flush.
+    virtual void FlushResourceBarriers(void* commandList) {}
+    virtual CommandBufferRingCounters GetCommandBufferCounters() { return {}; }
+
+    // Timestamps around plugin recordings, off by default. Returns false if the backend cannot take them.
+    bool SetGpuTimestamps(bool enabled);
+    bool GetGpuTimestamps() const { return m_GpuTimestamps.load(std::memory_order_acquire); }
+    // Writes the start timestamp of a timer into commandList, InvalidGpuTimer while timestamps are off. The
+    // other timer functions do nothing for InvalidGpuTimer, so a disabled timer costs one flag check.
+    uint64_t BeginGpuTimer(void* commandList)
+    {
+        if (!m_GpuTimestamps.load(std::memory_order_acquire) || commandList == nullptr) {
+            return InvalidGpuTimer;
+        }
+        uint64_t timer = ++m_LastGpuTimer;
+        InternalBeginGpuTimer(commandList, static_cast<uint32_t>(timer % GpuTimerCapacity));
+        return timer;
+    }
+    void EndGpuTimer(void* commandList, uint64_t timer)
+    {
+        if (timer != InvalidGpuTimer) {
+            InternalEndGpuTimer(commandList, static_cast<uint32_t>(timer % GpuTimerCapacity));
+        }
+    }
+    // GPU time between the two timestamps of a timer submitted with fenceValue. Never waits for the GPU.
+    GpuTimerStatus ReadGpuTimer(uint64_t timer, uint64_t fenceValue, uint64_t& nanoseconds);
+
+    // Takes ownership of something the GPU may still use until fenceValue completes. release runs once a later
+    // GetNativeCommandList/ExecuteCommandList observes the fence, so the caller never blocks on the GPU.
+    void DeferRelease(uint64_t fenceValue, std::function<void()> release);
+    // Waits for the GPU and runs every pending release.
+    void FlushDeferredReleases();
+
+protected:
+    // Runs the pending releases whose fence has completed. Never waits for the GPU. Render thread only: it reads
+    // the backend's fences and the releases destroy FFX contexts.
+    void RetireDeferredReleases();
+    // Highest fence value known to be complete, must not block.
+    virtual uint64_t GetCompletedFenceValue() { return UINT64_MAX; }
+    // Clears the timestamp flag before the backend releases its query objects.
+    void StopGpuTimestamps() { m_GpuTimestamps.store(false, std::memory_order_release); }
+
 private:
     virtual bool InternalInit() = 0;
+    // Runs FlushDeferredReleases first, while the queues and fences the releases wait on still exist.
     virtual void InternalDestroy() = 0;
+    // Creates the query objects of GpuTimerCapacity timers on first use, false if the backend has no timestamps.
+    virtual bool InternalInitGpuTimers() { return false; }
+    virtual void InternalBeginGpuTimer(void* commandList, uint32_t slot) {}
+    virtual void InternalEndGpuTimer(void* commandList, uint32_t slot) {}
+    // Called once fenceValue has completed.
+    virtual GpuTimerStatus InternalReadGpuTimer(uint32_t slot, uint64_t& nanoseconds) { return GPU_TIMER_LOST; }
 
 protected:
     bool m_Initialized = false;
     IUnityInterfaces* m_pUnityInterfaces = nullptr;
+
+private:
+    struct DeferredRelease
+    {
+        uint64_t fenceValue;
+        std::function<void()> release;
+    };
+    std::mutex m_DeferredReleaseMutex;
+    std::vector<DeferredRelease> m_DeferredReleases = {};
+    // Render thread only, see RetireDeferredReleases.
+    std::vector<DeferredRelease> m_RetiringReleases = {};
+    std::atomic<uint32_t> m_DeferredReleaseCount = {0};
+
+    std::atomic<bool> m_GpuTimestamps = {false};
+    // Timers begin and are read on the render thread.
+    uint64_t m_LastGpuTimer = InvalidGpuTimer;
 };
\ No newline at end of file
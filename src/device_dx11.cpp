@@ -1,5 +1,8 @@
 #include "device_dx11.h"
 
+#include "fsrunityplugin.h"
+#include "trace.h"
+
 
 bool DeviceDX11::InternalInit()
 {
@@ -18,6 +21,8 @@ bool DeviceDX11::InternalInit()
 
 void DeviceDX11::InternalDestroy()
 {
+    FlushDeferredReleases();
+    ReleaseGpuTimers();
     m_pD3D11DeviceContext->Release();
     m_pD3D11Device = nullptr;
     m_pUnityGraphicsD3D11 = nullptr;
@@ -58,5 +63,86 @@ void* DeviceDX11::GetNativeDevice()
 
 void* DeviceDX11::GetNativeCommandList()
 {
+    FSR_TRACE_SCOPE("Device::GetNativeCommandList");
+    RetireDeferredReleases();
     return m_pD3D11DeviceContext;
+}
+
+bool DeviceDX11::InternalInitGpuTimers()
+{
+    if (m_GpuTimersCreated) {
+        return true;
+    }
+    if (m_pD3D11Device == nullptr) {
+        return false;
+    }
+    D3D11_QUERY_DESC disjointDesc = {D3D11_QUERY_TIMESTAMP_DISJOINT, 0};
+    D3D11_QUERY_DESC timestampDesc = {D3D11_QUERY_TIMESTAMP, 0};
+    for (GpuTimer& timer : m_GpuTimers) {
+        if (FAILED(m_pD3D11Device->CreateQuery(&disjointDesc, &timer.disjoint)) ||
+            FAILED(m_pD3D11Device->CreateQuery(&timestampDesc, &timer.timestamps[0])) ||
+            FAILED(m_pD3D11Device->CreateQuery(&timestampDesc, &timer.timestamps[1]))) {
+            FSR_ERROR("Failed to create timestamp queries!");
+            m_GpuTimersCreated = true;
+            ReleaseGpuTimers();
+            return false;
+        }
+    }
+    m_GpuTimersCreated = true;
+    return true;
+}
+
+void DeviceDX11::ReleaseGpuTimers()
+{
+    if (!m_GpuTimersCreated) {
+        return;
+    }
+    for (GpuTimer& timer : m_GpuTimers) {
+        for (ID3D11Query* query : {timer.disjoint, timer.timestamps[0], timer.timestamps[1]}) {
+            if (query != nullptr) {
+                query->Release();
+            }
+        }
+        timer = {};
+    }
+    m_GpuTimersCreated = false;
+}
+
+void DeviceDX11::InternalBeginGpuTimer(void* commandList, uint32_t slot)
+{
+    ID3D11DeviceContext* context = static_cast<ID3D11DeviceContext*>(commandList);
+    context->Begin(m_GpuTimers[slot].disjoint);
+    context->End(m_GpuTimers[slot].timestamps[0]);
+}
+
+void DeviceDX11::InternalEndGpuTimer(void* commandList, uint32_t slot)
+{
+    ID3D11DeviceContext* context = static_cast<ID3D11DeviceContext*>(commandList);
+    context->End(m_GpuTimers[slot].timestamps[1]);
+    context->End(m_GpuTimers[slot].disjoint);
+}
+
+GpuTimerStatus DeviceDX11::InternalReadGpuTimer(uint32_t slot, uint64_t& nanoseconds)
+{
+    // DONOTFLUSH keeps the poll from submitting the immediate context.
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint = {};
+    HRESULT hr = m_pD3D11DeviceContext->GetData(m_GpuTimers[slot].disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+    if (hr == S_FALSE) {
+        return GPU_TIMER_PENDING;
+    }
+    if (FAILED(hr) || disjoint.Disjoint || disjoint.Frequency == 0) {
+        return GPU_TIMER_LOST;
+    }
+    UINT64 timestamps[2] = {};
+    for (int i = 0; i < 2; ++i) {
+        hr = m_pD3D11DeviceContext->GetData(m_GpuTimers[slot].timestamps[i], &timestamps[i], sizeof(UINT64), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+        if (hr == S_FALSE) {
+            return GPU_TIMER_PENDING;
+        }
+        if (FAILED(hr)) {
+            return GPU_TIMER_LOST;
+        }
+    }
+    nanoseconds = static_cast<uint64_t>((timestamps[1] - timestamps[0]) * (1e9 / disjoint.Frequency));
+    return GPU_TIMER_READY;
 }
\ No newline at end of file
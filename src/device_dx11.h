@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+
 #include <d3d11.h>
 
 #include "IUnityGraphicsD3D11.h"
@@ -13,6 +15,7 @@ private:
     friend class Device;
 
 public:
+    virtual ~DeviceDX11() override { Destroy(); }
     virtual UnityGfxRenderer GetDeviceType() override { return kUnityGfxRendererD3D11; }
     virtual void* GetGraphicsInterfaces() { return m_pUnityGraphicsD3D11; }
     virtual void* GetNativeResource(void* resource, void* desc = nullptr, uint32_t state = 0, bool observeOnly = true) override;
@@ -23,10 +26,24 @@ public:
 private:
     virtual bool InternalInit() override;
     virtual void InternalDestroy() override;
+    virtual bool InternalInitGpuTimers() override;
+    virtual void InternalBeginGpuTimer(void* commandList, uint32_t slot) override;
+    virtual void InternalEndGpuTimer(void* commandList, uint32_t slot) override;
+    virtual GpuTimerStatus InternalReadGpuTimer(uint32_t slot, uint64_t& nanoseconds) override;
+    void ReleaseGpuTimers();
 
 private:
     IUnityGraphicsD3D11* m_pUnityGraphicsD3D11 = nullptr;
 
     ID3D11Device* m_pD3D11Device = nullptr;
     ID3D11DeviceContext* m_pD3D11DeviceContext = nullptr;
+
+    // The timestamps of a GPU timer slot are only comparable if its disjoint query reports a stable clock.
+    struct GpuTimer
+    {
+        ID3D11Query* disjoint;
+        ID3D11Query* timestamps[2];
+    };
+    std::array<GpuTimer, GpuTimerCapacity> m_GpuTimers = {};
+    bool m_GpuTimersCreated = false;
 };
\ No newline at end of file
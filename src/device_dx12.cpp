@@ -1,6 +1,10 @@
 #include "device_dx12.h"
 
+#include <algorithm>
+#include <limits>
+
 #include "fsrunityplugin.h"
+#include "trace.h"
 
 
 bool DeviceDX12::InternalInit()
@@ -17,10 +21,22 @@ bool DeviceDX12::InternalInit()
 
 void DeviceDX12::InternalDestroy()
 {
+    FlushDeferredReleases();
     Wait();
-    for (auto& commandBuffer : m_CommandBufferList) {
+    m_CommandBufferRing.ForEach([](CommandBuffer& commandBuffer) {
         commandBuffer.d3d12CommandAllocator->Release();
         commandBuffer.d3d12CommandList->Release();
+    });
+    m_CommandBufferRing.Clear();
+    if (m_pTimestampReadback != nullptr) {
+        m_pTimestampReadback->Unmap(0, nullptr);
+        m_pTimestampReadback->Release();
+        m_pTimestampReadback = nullptr;
+        m_pTimestamps = nullptr;
+    }
+    if (m_pTimestampHeap != nullptr) {
+        m_pTimestampHeap->Release();
+        m_pTimestampHeap = nullptr;
     }
     m_pD3D12Device = nullptr;
     m_pD3D12Fence = nullptr;
@@ -33,9 +49,7 @@ void* DeviceDX12::GetNativeResource(void* resource, void* desc, uint32_t state,
         *static_cast<D3D12_RESOURCE_DESC*>(desc) = static_cast<ID3D12Resource*>(resource)->GetDesc();
     }
     if (resource) {
-        m_ResourceState.push_back(UnityGraphicsD3D12ResourceState{static_cast<ID3D12Resource*>(resource),
-            static_cast<D3D12_RESOURCE_STATES>(state),
-            static_cast<D3D12_RESOURCE_STATES>(state)});
+        TrackResourceState(static_cast<ID3D12Resource*>(resource), static_cast<D3D12_RESOURCE_STATES>(state));
     }
     return resource;
 }
@@ -50,13 +64,25 @@ void* DeviceDX12::GetNativeResourceByID(UnityTextureID textureID, void* desc, ui
         *static_cast<D3D12_RESOURCE_DESC*>(desc) = static_cast<ID3D12Resource*>(resource)->GetDesc();
     }
     if (resource) {
-        m_ResourceState.push_back(UnityGraphicsD3D12ResourceState{static_cast<ID3D12Resource*>(resource),
-            static_cast<D3D12_RESOURCE_STATES>(state),
-            static_cast<D3D12_RESOURCE_STATES>(state)});
+        TrackResourceState(static_cast<ID3D12Resource*>(resource), static_cast<D3D12_RESOURCE_STATES>(state));
     }
     return resource;
 }
 
+void DeviceDX12::TrackResourceState(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
+{
+    // A resource shared by several dispatches of one command list is declared to Unity once. Unity has to put it
+    // in the state the first of them asked for before the command list runs, and it is left in the state the
+    // last of them asked for.
+    for (auto& resourceState : m_ResourceState) {
+        if (resourceState.resource == resource) {
+            resourceState.current = state;
+            return;
+        }
+    }
+    m_ResourceState.push_back(UnityGraphicsD3D12ResourceState{resource, state, state});
+}
+
 void* DeviceDX12::GetNativeDevice()
 {
     return m_pD3D12Device;
@@ -64,82 +90,82 @@ void* DeviceDX12::GetNativeDevice()
 
 void* DeviceDX12::GetNativeCommandList()
 {
-    ID3D12CommandAllocator* d3d12CommandAllocator = nullptr;
-    ID3D12GraphicsCommandList2* d3d12CommandList = nullptr;
-    if (m_pD3D12Fence != nullptr) {
-        for (auto& commandBuffer : m_CommandBufferList) {
-            if (m_pD3D12Fence->GetCompletedValue() >= commandBuffer.fenceValue) {
-                d3d12CommandAllocator = commandBuffer.d3d12CommandAllocator;
-                d3d12CommandList = commandBuffer.d3d12CommandList;
-                commandBuffer.fenceValue = (std::numeric_limits<uint64_t>::max)();
-                break;
-            }
-        }
-        if (d3d12CommandAllocator != nullptr && d3d12CommandList != nullptr) {
-            HRESULT hr = d3d12CommandAllocator->Reset();
-            if (FAILED(hr)) {
-                FSR_ERROR("Failed to reset command allocator!");
-            }
-            hr = d3d12CommandList->Reset(d3d12CommandAllocator, nullptr);
-            if (FAILED(hr)) {
-                FSR_ERROR("Failed to reset command list!");
-            }
-        }
+    FSR_TRACE_SCOPE("Device::GetNativeCommandList");
+    RetireDeferredReleases();
+    if (m_pD3D12Device == nullptr) {
+        return nullptr;
     }
-    if (!d3d12CommandList) {
-        if (m_pD3D12Device != nullptr) {
-            HRESULT hr = m_pD3D12Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&d3d12CommandAllocator));
+    // A new command list is created open, a reused one has to be reset.
+    bool created = false;
+    CommandBuffer* commandBuffer = m_CommandBufferRing.Acquire(
+        [this](const CommandBuffer& slot) { return m_pD3D12Fence != nullptr && m_pD3D12Fence->GetCompletedValue() >= slot.fenceValue; },
+        [this, &created](CommandBuffer& slot) {
+            FSR_TRACE_SCOPE("Device::CreateCommandBuffer");
+            HRESULT hr = m_pD3D12Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&slot.d3d12CommandAllocator));
             if (FAILED(hr)) {
                 FSR_ERROR("Failed to create command allocator!");
+                return false;
             }
-            hr = m_pD3D12Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, d3d12CommandAllocator, nullptr, IID_PPV_ARGS(&d3d12CommandList));
+            hr = m_pD3D12Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, slot.d3d12CommandAllocator, nullptr, IID_PPV_ARGS(&slot.d3d12CommandList));
             if (FAILED(hr)) {
                 FSR_ERROR("Failed to create command list!");
+                slot.d3d12CommandAllocator->Release();
+                return false;
             }
-            m_CommandBufferList.push_back(CommandBuffer{d3d12CommandAllocator, d3d12CommandList, (std::numeric_limits<uint64_t>::max)()});
+            created = true;
+            return true;
+        },
+        [this](const CommandBuffer& slot) { Wait(slot.fenceValue); });
+    if (commandBuffer == nullptr) {
+        return nullptr;
+    }
+    commandBuffer->fenceValue = (std::numeric_limits<uint64_t>::max)();
+    if (!created) {
+        HRESULT hr = commandBuffer->d3d12CommandAllocator->Reset();
+        if (FAILED(hr)) {
+            FSR_ERROR("Failed to reset command allocator!");
+        }
+        hr = commandBuffer->d3d12CommandList->Reset(commandBuffer->d3d12CommandAllocator, nullptr);
+        if (FAILED(hr)) {
+            FSR_ERROR("Failed to reset command list!");
         }
     }
-    return d3d12CommandList;
+    return commandBuffer->d3d12CommandList;
 }
 
 uint64_t DeviceDX12::ExecuteCommandList(void* commandList)
 {
+    FSR_TRACE_SCOPE("Device::ExecuteCommandList");
     uint64_t fenceValue = 0;
     static_cast<ID3D12GraphicsCommandList2*>(commandList)->Close();
     if (m_pUnityGraphicsD3D12 != nullptr) {
         //m_pUnityGraphicsD3D12->GetCommandQueue()->ExecuteCommandLists(1, reinterpret_cast<ID3D12CommandList* const*>(&commandList));
         fenceValue = m_pUnityGraphicsD3D12->ExecuteCommandList(static_cast<ID3D12GraphicsCommandList*>(commandList), static_cast<int>(m_ResourceState.size()), m_ResourceState.data());
-        for (auto& commandBuffer : m_CommandBufferList) {
-            if (commandList == commandBuffer.d3d12CommandList) {
-                commandBuffer.fenceValue = fenceValue;
-                break;
-            }
+        CommandBuffer* commandBuffer = m_CommandBufferRing.Find([commandList](const CommandBuffer& slot) { return slot.d3d12CommandList == commandList; });
+        if (commandBuffer != nullptr) {
+            commandBuffer->fenceValue = fenceValue;
         }
         m_ResourceState.clear();
     }
+    RetireDeferredReleases();
     return fenceValue;
 }
 
 void DeviceDX12::Wait()
 {
-    if (m_pD3D12Fence != nullptr) {
-        for (auto& commandBuffer : m_CommandBufferList) {
-            if (m_pD3D12Fence->GetCompletedValue() < commandBuffer.fenceValue) {
-                HANDLE hHandleFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-                HRESULT hr = m_pD3D12Fence->SetEventOnCompletion(commandBuffer.fenceValue, hHandleFenceEvent);
-                if (FAILED(hr)) {
-                    FSR_ERROR("Failed to set event on completion!");
-                    break;
-                }
-                WaitForSingleObject(hHandleFenceEvent, INFINITE);
-                CloseHandle(hHandleFenceEvent);
-            }
+    // Submissions complete in order, waiting for the newest one covers the rest.
+    uint64_t fenceValue = 0;
+    m_CommandBufferRing.ForEach([&fenceValue](const CommandBuffer& commandBuffer) {
+        if (commandBuffer.fenceValue != (std::numeric_limits<uint64_t>::max)()) {
+            fenceValue = (std::max)(fenceValue, commandBuffer.fenceValue);
         }
-    }
+    });
+    Wait(fenceValue);
 }
 
 void DeviceDX12::Wait(uint64_t fenceValue)
 {
+    FSR_TRACE_SCOPE("Device::Wait");
     if (m_pD3D12Fence != nullptr) {
         if (m_pD3D12Fence->GetCompletedValue() < fenceValue) {
             HANDLE hHandleFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
@@ -152,4 +178,88 @@ void DeviceDX12::Wait(uint64_t fenceValue)
             CloseHandle(hHandleFenceEvent);
         }
     }
+}
+
+uint64_t DeviceDX12::GetCompletedFenceValue()
+{
+    return m_pD3D12Fence != nullptr ? m_pD3D12Fence->GetCompletedValue() : UINT64_MAX;
+}
+
+bool DeviceDX12::InternalInitGpuTimers()
+{
+    if (m_pTimestampHeap != nullptr) {
+        return true;
+    }
+    if (m_pD3D12Device == nullptr || m_pUnityGraphicsD3D12 == nullptr) {
+        return false;
+    }
+    HRESULT hr = m_pUnityGraphicsD3D12->GetCommandQueue()->GetTimestampFrequency(&m_TimestampFrequency);
+    if (FAILED(hr) || m_TimestampFrequency == 0) {
+        FSR_LOG("The D3D12 queue does not support timestamps");
+        return false;
+    }
+
+    D3D12_QUERY_HEAP_DESC heapDesc = {};
+    heapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    heapDesc.Count = GpuTimerCapacity * 2;
+    heapDesc.NodeMask = 0;
+    hr = m_pD3D12Device->CreateQueryHeap(&heapDesc, IID_PPV_ARGS(&m_pTimestampHeap));
+    if (FAILED(hr)) {
+        FSR_ERROR("Failed to create the timestamp query heap!");
+        m_pTimestampHeap = nullptr;
+        return false;
+    }
+
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    heapProperties.Type = D3D12_HEAP_TYPE_READBACK;
+    D3D12_RESOURCE_DESC bufferDesc = {};
+    bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDesc.Width = GpuTimerCapacity * 2 * sizeof(uint64_t);
+    bufferDesc.Height = 1;
+    bufferDesc.DepthOrArraySize = 1;
+    bufferDesc.MipLevels = 1;
+    bufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+    bufferDesc.SampleDesc.Count = 1;
+    bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    hr = m_pD3D12Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_pTimestampReadback));
+    void* mapped = nullptr;
+    if (SUCCEEDED(hr)) {
+        hr = m_pTimestampReadback->Map(0, nullptr, &mapped);
+        if (FAILED(hr)) {
+            m_pTimestampReadback->Release();
+        }
+    }
+    if (FAILED(hr)) {
+        FSR_ERROR("Failed to create the timestamp readback buffer!");
+        m_pTimestampReadback = nullptr;
+        m_pTimestampHeap->Release();
+        m_pTimestampHeap = nullptr;
+        return false;
+    }
+    m_pTimestamps = static_cast<const uint64_t*>(mapped);
+    return true;
+}
+
+void DeviceDX12::InternalBeginGpuTimer(void* commandList, uint32_t slot)
+{
+    static_cast<ID3D12GraphicsCommandList2*>(commandList)->EndQuery(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, slot * 2);
+}
+
+void DeviceDX12::InternalEndGpuTimer(void* commandList, uint32_t slot)
+{
+    ID3D12GraphicsCommandList2* d3d12CommandList = static_cast<ID3D12GraphicsCommandList2*>(commandList);
+    d3d12CommandList->EndQuery(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, slot * 2 + 1);
+    d3d12CommandList->ResolveQueryData(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, slot * 2, 2, m_pTimestampReadback, slot * 2 * sizeof(uint64_t));
+}
+
+GpuTimerStatus DeviceDX12::InternalReadGpuTimer(uint32_t slot, uint64_t& nanoseconds)
+{
+    // The resolve is part of the submission, so its fence having completed means the values have landed.
+    uint64_t begin = m_pTimestamps[slot * 2];
+    uint64_t end = m_pTimestamps[slot * 2 + 1];
+    if (end < begin) {
+        return GPU_TIMER_LOST;
+    }
+    nanoseconds = static_cast<uint64_t>((end - begin) * (1e9 / m_TimestampFrequency));
+    return GPU_TIMER_READY;
 }
\ No newline at end of file
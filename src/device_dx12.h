@@ -16,6 +16,7 @@ private:
     friend class Device;
 
 public:
+    virtual ~DeviceDX12() override { Destroy(); }
     virtual UnityGfxRenderer GetDeviceType() override { return kUnityGfxRendererD3D12; }
     virtual void* GetGraphicsInterfaces() { return m_pUnityGraphicsD3D12; }
     virtual void* GetNativeResource(void* resource, void* desc = nullptr, uint32_t state = 0, bool observeOnly = true) override;
@@ -25,10 +26,17 @@ public:
     virtual uint64_t ExecuteCommandList(void* commandList) override;
     virtual void Wait() override;
     virtual void Wait(uint64_t fenceValue) override;
+    virtual CommandBufferRingCounters GetCommandBufferCounters() override { return m_CommandBufferRing.GetCounters(); }
 
 private:
+    virtual uint64_t GetCompletedFenceValue() override;
     virtual bool InternalInit() override;
     virtual void InternalDestroy() override;
+    void TrackResourceState(ID3D12Resource* resource, D3D12_RESOURCE_STATES state);
+    virtual bool InternalInitGpuTimers() override;
+    virtual void InternalBeginGpuTimer(void* commandList, uint32_t slot) override;
+    virtual void InternalEndGpuTimer(void* commandList, uint32_t slot) override;
+    virtual GpuTimerStatus InternalReadGpuTimer(uint32_t slot, uint64_t& nanoseconds) override;
 
 private:
     IUnityGraphicsD3D12v7* m_pUnityGraphicsD3D12 = nullptr;
@@ -42,7 +50,13 @@ private:
         ID3D12GraphicsCommandList2* d3d12CommandList;
         uint64_t fenceValue;
     };
-    std::vector<CommandBuffer> m_CommandBufferList = {};
+    CommandBufferRing<CommandBuffer> m_CommandBufferRing{CommandBufferRingCapacity};
 
     std::vector<UnityGraphicsD3D12ResourceState> m_ResourceState;
+
+    // Two timestamps per GPU timer slot, resolved into a readback buffer that stays mapped.
+    ID3D12QueryHeap* m_pTimestampHeap = nullptr;
+    ID3D12Resource* m_pTimestampReadback = nullptr;
+    const uint64_t* m_pTimestamps = nullptr;
+    uint64_t m_TimestampFrequency = 0;
 };
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "device_null.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+
+#include "fsrunityplugin.h"
+#include "trace.h"
+
+
+bool DeviceNull::InternalInit()
+{
+    const char* latency = std::getenv("FSR_NULL_GPU_LATENCY_US");
+    if (latency != nullptr) {
+        SetGpuLatency(static_cast<uint32_t>(std::strtoul(latency, nullptr, 10)));
+    }
+    return true;
+}
+
+void DeviceNull::InternalDestroy()
+{
+    FlushDeferredReleases();
+    Wait();
+    m_CommandBufferRing.Clear();
+    m_SubmittedValue = 0;
+    m_CompletedValue = 0;
+}
+
+void* DeviceNull::GetNativeResource(void* resource, void* desc, uint32_t state, bool observeOnly)
+{
+    ++m_Counters.nativeResource;
+    return resource;
+}
+
+void* DeviceNull::GetNativeResourceByID(UnityTextureID textureID, void* desc, uint32_t state, bool observeOnly)
+{
+    ++m_Counters.nativeResource;
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(textureID));
+}
+
+void* DeviceNull::GetNativeDevice()
+{
+    // There is no native device, but callers treat nullptr as "not initialized".
+    return this;
+}
+
+void* DeviceNull::GetNativeCommandList()
+{
+    FSR_TRACE_SCOPE("Device::GetNativeCommandList");
+    ++m_Counters.nativeCommandList;
+    RetireDeferredReleases();
+    // Command lists are the ring slots themselves.
+    CommandBuffer* commandBuffer = m_CommandBufferRing.Acquire(
+        [this](const CommandBuffer& slot) { return GetCompletedFenceValue() >= slot.fenceValue; },
+        [this](CommandBuffer& slot) {
+            ++m_Counters.commandListCreated;
+            return true;
+        },
+        [this](const CommandBuffer& slot) { Wait(slot.fenceValue); });
+    commandBuffer->fenceValue = (std::numeric_limits<uint64_t>::max)();
+    return commandBuffer;
+}
+
+uint64_t DeviceNull::ExecuteCommandList(void* commandList)
+{
+    FSR_TRACE_SCOPE("Device::ExecuteCommandList");
+    ++m_Counters.executeCommandList;
+    CommandBuffer* commandBuffer = m_CommandBufferRing.Find([commandList](const CommandBuffer& slot) { return &slot == commandList; });
+    if (commandBuffer == nullptr) {
+        FSR_ERROR("Invalid null device command list");
+        return 0;
+    }
+
+    // The simulated GPU executes submissions in order, each taking m_GpuLatency.
+    Clock::time_point now = Clock::now();
+    m_LastCompletionTime = ((std::max)(now, m_LastCompletionTime)) + m_GpuLatency;
+    *commandBuffer = CommandBuffer{++m_SubmittedValue, m_LastCompletionTime};
+    RetireDeferredReleases();
+    return m_SubmittedValue;
+}
+
+void DeviceNull::Wait()
+{
+    Wait(m_SubmittedValue);
+}
+
+void DeviceNull::Wait(uint64_t fenceValue)
+{
+    FSR_TRACE_SCOPE("Device::Wait");
+    ++m_Counters.wait;
+    if (GetCompletedFenceValue() >= fenceValue) {
+        return;
+    }
+    ++m_Counters.waitStalled;
+    Clock::time_point completionTime = {};
+    m_CommandBufferRing.ForEach([fenceValue, &completionTime](const CommandBuffer& commandBuffer) {
+        if (commandBuffer.fenceValue <= fenceValue && commandBuffer.completionTime > completionTime) {
+            completionTime = commandBuffer.completionTime;
+        }
+    });
+    std::this_thread::sleep_until(completionTime);
+    GetCompletedFenceValue();
+}
+
+uint64_t DeviceNull::GetCompletedFenceValue()
+{
+    Clock::time_point now = Clock::now();
+    m_CommandBufferRing.ForEach([this, now](const CommandBuffer& commandBuffer) {
+        if (commandBuffer.fenceValue > m_CompletedValue && commandBuffer.fenceValue <= m_SubmittedValue && commandBuffer.completionTime <= now) {
+            m_CompletedValue = commandBuffer.fenceValue;
+        }
+    });
+    return m_CompletedValue;
+}
+
+GpuTimerStatus DeviceNull::InternalReadGpuTimer(uint32_t slot, uint64_t& nanoseconds)
+{
+    nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(m_GpuTimerDurations[slot]).count());
+    return GPU_TIMER_READY;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+
+#include "IUnityGraphics.h"
+#include "device.h"
+
+
+class DeviceNull : public Device
+{
+private:
+    DeviceNull() : Device() {}
+    friend class Device;
+
+public:
+    struct Counters
+    {
+        uint64_t nativeResource;
+        uint64_t nativeCommandList;
+        uint64_t commandListCreated;
+        uint64_t executeCommandList;
+        uint64_t wait;
+        uint64_t waitStalled;
+    };
+
+public:
+    virtual ~DeviceNull() override { Destroy(); }
+    virtual UnityGfxRenderer GetDeviceType() override { return kUnityGfxRendererNull; }
+    virtual void* GetGraphicsInterfaces() override { return nullptr; }
+    virtual void* GetNativeResource(void* resource, void* desc = nullptr, uint32_t state = 0, bool observeOnly = true) override;
+    virtual void* GetNativeResourceByID(UnityTextureID textureID, void* desc = nullptr, uint32_t state = 0, bool observeOnly = true) override;
+    virtual void* GetNativeDevice() override;
+    virtual void* GetNativeCommandList() override;
+    virtual uint64_t ExecuteCommandList(void* commandList) override;
+    virtual void Wait() override;
+    virtual void Wait(uint64_t fenceValue) override;
+    virtual CommandBufferRingCounters GetCommandBufferCounters() override { return m_CommandBufferRing.GetCounters(); }
+
+    // Simulated time between a submission and its fence being signaled.
+    void SetGpuLatency(uint32_t microseconds) { m_GpuLatency = std::chrono::microseconds(microseconds); }
+    const Counters& GetCounters() const { return m_Counters; }
+    void ResetCounters() { m_Counters = {}; }
+
+private:
+    virtual uint64_t GetCompletedFenceValue() override;
+    virtual bool InternalInit() override;
+    virtual void InternalDestroy() override;
+    virtual bool InternalInitGpuTimers() override { return true; }
+    virtual void InternalBeginGpuTimer(void* commandList, uint32_t slot) override {}
+    virtual void InternalEndGpuTimer(void* commandList, uint32_t slot) override { m_GpuTimerDurations[slot] = m_GpuLatency; }
+    virtual GpuTimerStatus InternalReadGpuTimer(uint32_t slot, uint64_t& nanoseconds) override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::chrono::microseconds m_GpuLatency = {};
+    uint64_t m_SubmittedValue = 0;
+    uint64_t m_CompletedValue = 0;
+    Clock::time_point m_LastCompletionTime = {};
+
+    struct CommandBuffer
+    {
+        uint64_t fenceValue;
+        Clock::time_point completionTime;
+    };
+    CommandBufferRing<CommandBuffer> m_CommandBufferRing{CommandBufferRingCapacity};
+    // A timed recording takes as long as the submission holding it.
+    std::array<std::chrono::microseconds, GpuTimerCapacity> m_GpuTimerDurations = {};
+
+    Counters m_Counters = {};
+};
\ No newline at end of file
@@ -1,6 +1,175 @@
 #include "device_vk.h"
 
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
 #include "fsrunityplugin.h"
+#include "trace.h"
+
+
+// Compute-only queue family added to Unity's device in InterceptCreateDevice, UINT32_MAX if there is none.
+static uint32_t s_ComputeQueueFamilyIndex = UINT32_MAX;
+// Whether InterceptCreateDevice created Unity's device with the timelineSemaphore feature enabled.
+static bool s_TimelineSemaphoreEnabled = false;
+static VkInstance s_VkInstance = VK_NULL_HANDLE;
+static PFN_vkGetInstanceProcAddr s_pfnGetInstanceProcAddr = nullptr;
+static PFN_vkCreateDevice s_pfnCreateDevice = nullptr;
+
+static bool SupportsTimelineSemaphore(VkPhysicalDevice physicalDevice)
+{
+    auto getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(s_pfnGetInstanceProcAddr(s_VkInstance, "vkGetPhysicalDeviceFeatures2"));
+    if (getPhysicalDeviceFeatures2 == nullptr) {
+        getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(s_pfnGetInstanceProcAddr(s_VkInstance, "vkGetPhysicalDeviceFeatures2KHR"));
+    }
+    if (getPhysicalDeviceFeatures2 == nullptr) {
+        return false;
+    }
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &timelineFeatures;
+    getPhysicalDeviceFeatures2(physicalDevice, &features);
+    return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+static bool HasDeviceExtension(VkPhysicalDevice physicalDevice, const char* name)
+{
+    auto enumerateDeviceExtensionProperties = reinterpret_cast<PFN_vkEnumerateDeviceExtensionProperties>(s_pfnGetInstanceProcAddr(s_VkInstance, "vkEnumerateDeviceExtensionProperties"));
+    if (enumerateDeviceExtensionProperties == nullptr) {
+        return false;
+    }
+    uint32_t extensionCount = 0;
+    enumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    enumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+    for (uint32_t i = 0; i < extensionCount; ++i) {
+        if (strcmp(extensions[i].extensionName, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL InterceptCreateDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDevice* pDevice)
+{
+    s_ComputeQueueFamilyIndex = UINT32_MAX;
+    s_TimelineSemaphoreEnabled = false;
+    auto getQueueFamilyProperties = reinterpret_cast<PFN_vkGetPhysicalDeviceQueueFamilyProperties>(s_pfnGetInstanceProcAddr(s_VkInstance, "vkGetPhysicalDeviceQueueFamilyProperties"));
+    if (getQueueFamilyProperties != nullptr) {
+        uint32_t familyCount = 0;
+        getQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        getQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        for (uint32_t i = 0; i < familyCount; ++i) {
+            if ((families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && families[i].queueCount > 0) {
+                s_ComputeQueueFamilyIndex = i;
+                break;
+            }
+        }
+    }
+
+    VkDeviceCreateInfo createInfo = *pCreateInfo;
+    std::vector<VkDeviceQueueCreateInfo> queueInfos(pCreateInfo->pQueueCreateInfos, pCreateInfo->pQueueCreateInfos + pCreateInfo->queueCreateInfoCount);
+    bool requested = false;
+    for (const VkDeviceQueueCreateInfo& queueInfo : queueInfos) {
+        requested |= queueInfo.queueFamilyIndex == s_ComputeQueueFamilyIndex;
+    }
+    if (s_ComputeQueueFamilyIndex != UINT32_MAX && !requested) {
+        static const float queuePriority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo = {};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = s_ComputeQueueFamilyIndex;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &queuePriority;
+        queueInfos.push_back(queueInfo);
+        createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueInfos.size());
+        createInfo.pQueueCreateInfos = queueInfos.data();
+    }
+
+    // Submissions are tracked, and async compute hands work between the queues, with timeline semaphores, which
+    // Unity does not necessarily enable. If Unity already chains a feature struct that carries the flag, it is
+    // set there for the duration of the call, a struct of its own is chained otherwise.
+    std::vector<const char*> extensions(pCreateInfo->ppEnabledExtensionNames, pCreateInfo->ppEnabledExtensionNames + pCreateInfo->enabledExtensionCount);
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+    VkBool32* timelineSemaphore = nullptr;
+    VkBool32 timelineSemaphoreRequested = VK_FALSE;
+    if (SupportsTimelineSemaphore(physicalDevice)) {
+        bool vulkan12Features = false;
+        for (VkBaseOutStructure* next = reinterpret_cast<VkBaseOutStructure*>(const_cast<void*>(pCreateInfo->pNext)); next != nullptr; next = next->pNext) {
+            if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES) {
+                timelineSemaphore = &reinterpret_cast<VkPhysicalDeviceVulkan12Features*>(next)->timelineSemaphore;
+                vulkan12Features = true;
+            } else if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES) {
+                timelineSemaphore = &reinterpret_cast<VkPhysicalDeviceTimelineSemaphoreFeatures*>(next)->timelineSemaphore;
+            }
+        }
+        // Without the Vulkan 1.2 feature struct the device may be created for Vulkan 1.1, which needs the extension.
+        bool extensionEnabled = vulkan12Features;
+        for (const char* extension : extensions) {
+            extensionEnabled |= strcmp(extension, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0;
+        }
+        if (!extensionEnabled && HasDeviceExtension(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+            extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+            createInfo.ppEnabledExtensionNames = extensions.data();
+            extensionEnabled = true;
+        }
+        if (extensionEnabled) {
+            if (timelineSemaphore == nullptr) {
+                timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+                timelineFeatures.pNext = const_cast<void*>(createInfo.pNext);
+                createInfo.pNext = &timelineFeatures;
+                timelineSemaphore = &timelineFeatures.timelineSemaphore;
+            }
+            timelineSemaphoreRequested = *timelineSemaphore;
+            *timelineSemaphore = VK_TRUE;
+        } else {
+            timelineSemaphore = nullptr;
+        }
+    }
+
+    if (createInfo.pQueueCreateInfos != pCreateInfo->pQueueCreateInfos || timelineSemaphore != nullptr) {
+        VkResult res = s_pfnCreateDevice(physicalDevice, &createInfo, pAllocator, pDevice);
+        if (timelineSemaphore != nullptr) {
+            *timelineSemaphore = timelineSemaphoreRequested;
+        }
+        if (res == VK_SUCCESS) {
+            s_TimelineSemaphoreEnabled = timelineSemaphore != nullptr;
+            return res;
+        }
+        s_ComputeQueueFamilyIndex = UINT32_MAX;
+        s_TimelineSemaphoreEnabled = false;
+    }
+    return s_pfnCreateDevice(physicalDevice, pCreateInfo, pAllocator, pDevice);
+}
+
+static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL InterceptGetInstanceProcAddr(VkInstance instance, const char* pName)
+{
+    if (instance != VK_NULL_HANDLE && strcmp(pName, "vkCreateDevice") == 0) {
+        s_VkInstance = instance;
+        s_pfnCreateDevice = reinterpret_cast<PFN_vkCreateDevice>(s_pfnGetInstanceProcAddr(instance, pName));
+        if (s_pfnCreateDevice != nullptr) {
+            return reinterpret_cast<PFN_vkVoidFunction>(&InterceptCreateDevice);
+        }
+    }
+    return s_pfnGetInstanceProcAddr(instance, pName);
+}
+
+static PFN_vkGetInstanceProcAddr UNITY_INTERFACE_API InterceptVulkanInitialization(PFN_vkGetInstanceProcAddr getInstanceProcAddr, void* userdata)
+{
+    s_pfnGetInstanceProcAddr = getInstanceProcAddr;
+    return &InterceptGetInstanceProcAddr;
+}
+
+void DeviceVK::InterceptInitialization(IUnityInterfaces* unityInterfaces)
+{
+    IUnityGraphicsVulkanV2* unityGraphicsVulkan = unityInterfaces->Get<IUnityGraphicsVulkanV2>();
+    if (unityGraphicsVulkan != nullptr) {
+        unityGraphicsVulkan->AddInterceptInitialization(InterceptVulkanInitialization, nullptr, 0);
+    }
+}
 
 
 bool DeviceVK::InternalInit()
@@ -10,61 +179,209 @@ bool DeviceVK::InternalInit()
         if (m_pUnityGraphicsVulkan != nullptr) {
             m_VkDevice = m_pUnityGraphicsVulkan->Instance().device;
             m_VkQueue = m_pUnityGraphicsVulkan->Instance().graphicsQueue;
-
-            //VkSemaphoreTypeCreateInfo typeCreateInfo = {};
-            //typeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
-            //typeCreateInfo.pNext = nullptr;
-            //typeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
-            //typeCreateInfo.initialValue = m_SemaphoreValue;
-
-            //VkSemaphoreCreateInfo createInfo = {};
-            //createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-            //createInfo.pNext = &typeCreateInfo;
-            //createInfo.flags = 0;
-            //VkResult res = vkCreateSemaphore(m_VkDevice, &createInfo, nullptr, &m_VkSemaphore);
-            //if (res != VK_SUCCESS) {
-            //    FSR_ERROR("Failed to create queue semaphore!");
-            //}
+            if (m_VkDevice != VK_NULL_HANDLE && !InitTimelineSemaphore()) {
+                FSR_LOG("Timeline semaphores are not enabled on the device, falling back to fences");
+            }
+            // Async compute hands work between the queues with a second timeline semaphore.
+            if (m_VkSemaphore != VK_NULL_HANDLE && s_ComputeQueueFamilyIndex != UINT32_MAX && CreateTimelineSemaphore(m_VkHandoffSemaphore)) {
+                m_ComputeQueueFamilyIndex = s_ComputeQueueFamilyIndex;
+                vkGetDeviceQueue(m_VkDevice, m_ComputeQueueFamilyIndex, 0, &m_VkComputeQueue);
+            }
         }
     }
     return m_VkDevice != VK_NULL_HANDLE;
 }
 
+bool DeviceVK::InitTimelineSemaphore()
+{
+    // Supporting the feature is not enough, it has to be enabled on the device, which only InterceptCreateDevice
+    // can ensure. Without it, e.g. when the plugin was not loaded at startup, submissions are tracked with fences.
+    if (!s_TimelineSemaphoreEnabled) {
+        return false;
+    }
+
+    // The device hands out the core entry points for Vulkan 1.2, the KHR ones for the extension.
+    m_pfnGetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(vkGetDeviceProcAddr(m_VkDevice, "vkGetSemaphoreCounterValue"));
+    m_pfnWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphores>(vkGetDeviceProcAddr(m_VkDevice, "vkWaitSemaphores"));
+    if (m_pfnGetSemaphoreCounterValue == nullptr || m_pfnWaitSemaphores == nullptr) {
+        m_pfnGetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(vkGetDeviceProcAddr(m_VkDevice, "vkGetSemaphoreCounterValueKHR"));
+        m_pfnWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphores>(vkGetDeviceProcAddr(m_VkDevice, "vkWaitSemaphoresKHR"));
+    }
+    if (m_pfnGetSemaphoreCounterValue == nullptr || m_pfnWaitSemaphores == nullptr) {
+        m_pfnGetSemaphoreCounterValue = nullptr;
+        m_pfnWaitSemaphores = nullptr;
+        return false;
+    }
+
+    return CreateTimelineSemaphore(m_VkSemaphore);
+}
+
+bool DeviceVK::CreateTimelineSemaphore(VkSemaphore& semaphore)
+{
+    VkSemaphoreTypeCreateInfo typeCreateInfo = {};
+    typeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeCreateInfo.pNext = nullptr;
+    typeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeCreateInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    createInfo.pNext = &typeCreateInfo;
+    createInfo.flags = 0;
+    VkResult res = vkCreateSemaphore(m_VkDevice, &createInfo, nullptr, &semaphore);
+    if (res != VK_SUCCESS) {
+        FSR_ERROR("Failed to create queue semaphore!");
+        semaphore = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+uint64_t DeviceVK::GetSemaphoreCounterValue()
+{
+    uint64_t semaphoreValue = 0;
+    VkResult res = m_pfnGetSemaphoreCounterValue(m_VkDevice, m_VkSemaphore, &semaphoreValue);
+    if (res != VK_SUCCESS) {
+        FSR_ERROR("Failed to read the queue semaphore.");
+    }
+    return semaphoreValue;
+}
+
+void DeviceVK::WaitSemaphore(uint64_t semaphoreValue)
+{
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.pNext = nullptr;
+    waitInfo.flags = 0;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_VkSemaphore;
+    waitInfo.pValues = &semaphoreValue;
+    VkResult res = m_pfnWaitSemaphores(m_VkDevice, &waitInfo, UINT64_MAX);
+    if (res != VK_SUCCESS) {
+        FSR_ERROR("Failed to wait on the queue semaphore.");
+    }
+}
+
 void DeviceVK::InternalDestroy()
 {
+    FlushDeferredReleases();
     Wait();
-    for (auto& commandBuffer : m_CommandBufferList) {
+    ForEachCommandBuffer([this](CommandBuffer& commandBuffer) {
         vkFreeCommandBuffers(m_VkDevice, commandBuffer.vkCommandPool, 1, &commandBuffer.vkCommandBuffer);
         vkDestroyCommandPool(m_VkDevice, commandBuffer.vkCommandPool, nullptr);
-        vkDestroyFence(m_VkDevice, commandBuffer.vkFence, nullptr);
+        if (commandBuffer.vkFence != VK_NULL_HANDLE) {
+            vkDestroyFence(m_VkDevice, commandBuffer.vkFence, nullptr);
+        }
+        if (commandBuffer.vkTransferCommandPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(m_VkDevice, commandBuffer.vkTransferCommandPool, nullptr);
+        }
+    });
+    m_CommandBufferRing.Clear();
+    m_ComputeCommandBufferRing.Clear();
+    m_RecordedSubmissions.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_PluginEventMutex);
+        m_PluginEvents.clear();
+        m_RecordIntoUnityEvents.clear();
+    }
+    m_RecordIntoCurrentEvent = false;
+    m_RecordingCommandBuffer = VK_NULL_HANDLE;
+    m_AsyncCommandBuffer = VK_NULL_HANDLE;
+    m_AsyncImages.clear();
+    m_PendingAcquire = {};
+    m_ImageTransitions.clear();
+    if (m_VkQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(m_VkDevice, m_VkQueryPool, nullptr);
+        m_VkQueryPool = VK_NULL_HANDLE;
     }
-    //if (m_VkSemaphore != VK_NULL_HANDLE) {
-    //    vkDestroySemaphore(m_VkDevice, m_VkSemaphore, nullptr);
-    //}
+    if (m_VkHandoffSemaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(m_VkDevice, m_VkHandoffSemaphore, nullptr);
+        m_VkHandoffSemaphore = VK_NULL_HANDLE;
+    }
+    m_VkComputeQueue = VK_NULL_HANDLE;
+    m_ComputeQueueFamilyIndex = UINT32_MAX;
+    if (m_VkSemaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(m_VkDevice, m_VkSemaphore, nullptr);
+        m_VkSemaphore = VK_NULL_HANDLE;
+    }
+    m_pfnGetSemaphoreCounterValue = nullptr;
+    m_pfnWaitSemaphores = nullptr;
     m_VkDevice = VK_NULL_HANDLE;
     m_VkQueue = VK_NULL_HANDLE;
     m_pUnityGraphicsVulkan = nullptr;
 }
 
+// Stages and accesses FFX uses an image with in the layout it requested for it.
+static void GetLayoutScope(VkImageLayout layout, VkPipelineStageFlags& stages, VkAccessFlags& access)
+{
+    switch (layout) {
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+        stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        access = VK_ACCESS_TRANSFER_READ_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+        stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        access = VK_ACCESS_TRANSFER_WRITE_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+        stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        access = VK_ACCESS_SHADER_READ_BIT;
+        break;
+    default:
+        stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        break;
+    }
+}
+
+// accessTexture(layout, stages, access, accessMode, vulkanImage) is AccessTexture or AccessTextureByID.
+template<typename AccessTexture>
+void DeviceVK::AccessImage(AccessTexture accessTexture, VkImageLayout layout, bool observeOnly, UnityVulkanImage& vulkanImage)
+{
+    // Recording into Unity's command buffer, Unity transitions the image itself and keeps tracking its layout.
+    // Otherwise a requested layout is applied by FlushResourceBarriers, Unity only reports the current one.
+    bool unityBarrier = m_RecordingCommandBuffer != VK_NULL_HANDLE && layout != VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkAccessFlags access = VK_ACCESS_TRANSFER_WRITE_BIT;
+    if (layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+        GetLayoutScope(layout, stages, access);
+    }
+    bool success = accessTexture(
+        layout != VK_IMAGE_LAYOUT_UNDEFINED ? layout : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        stages,
+        access,
+        unityBarrier || (!observeOnly && layout == VK_IMAGE_LAYOUT_UNDEFINED) ? kUnityVulkanResourceAccess_PipelineBarrier : kUnityVulkanResourceAccess_ObserveOnly,
+        &vulkanImage
+    );
+    if (!success && layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+        // The image is neither tracked nor transitioned here. It is handed to FFX in the layout Unity reports,
+        // and the FFX backend transitions it on its own.
+        vulkanImage = {};
+        success = accessTexture(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            observeOnly ? kUnityVulkanResourceAccess_ObserveOnly : kUnityVulkanResourceAccess_PipelineBarrier, &vulkanImage);
+        layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        unityBarrier = false;
+    }
+    if (!success) {
+        return;
+    }
+    TrackAsyncImage(vulkanImage);
+    if (unityBarrier) {
+        vulkanImage.layout = layout;
+    } else {
+        TrackImageLayout(vulkanImage, layout);
+    }
+}
+
 void* DeviceVK::GetNativeResource(void* resource, void* desc, uint32_t state, bool observeOnly)
 {
     UnityVulkanImage vulkanImage = {};
-    if (resource) {
-        if (m_pUnityGraphicsVulkan != nullptr) {
-            VkImageSubresource subResource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
-            bool success = m_pUnityGraphicsVulkan->AccessTexture(
-                resource,
-                &subResource,
-                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                VK_ACCESS_TRANSFER_WRITE_BIT,
-                observeOnly ? kUnityVulkanResourceAccess_ObserveOnly : kUnityVulkanResourceAccess_PipelineBarrier,
-                &vulkanImage
-            );
-            //if (!success) {
-            //    FSR_ERROR("AccessTexture failed");
-            //}
-        }
+    if (resource && m_pUnityGraphicsVulkan != nullptr) {
+        VkImageSubresource subResource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+        AccessImage([this, resource, &subResource](VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access,
+            UnityVulkanResourceAccessMode accessMode, UnityVulkanImage* image) {
+            return m_pUnityGraphicsVulkan->AccessTexture(resource, &subResource, layout, stages, access, accessMode, image);
+        }, static_cast<VkImageLayout>(state), observeOnly, vulkanImage);
     }
     if (desc) {
         *static_cast<UnityVulkanImage*>(desc) = vulkanImage;
@@ -77,18 +394,10 @@ void* DeviceVK::GetNativeResourceByID(UnityTextureID textureID, void* desc, uint
     UnityVulkanImage vulkanImage = {};
     if (m_pUnityGraphicsVulkan != nullptr) {
         VkImageSubresource subResource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
-        bool success = m_pUnityGraphicsVulkan->AccessTextureByID(
-            textureID,
-            &subResource,
-            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_ACCESS_TRANSFER_WRITE_BIT,
-            observeOnly ? kUnityVulkanResourceAccess_ObserveOnly : kUnityVulkanResourceAccess_PipelineBarrier,
-            &vulkanImage
-        );
-        //if (!success) {
-        //    FSR_ERROR("AccessTextureByID failed");
-        //}
+        AccessImage([this, textureID, &subResource](VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access,
+            UnityVulkanResourceAccessMode accessMode, UnityVulkanImage* image) {
+            return m_pUnityGraphicsVulkan->AccessTextureByID(textureID, &subResource, layout, stages, access, accessMode, image);
+        }, static_cast<VkImageLayout>(state), observeOnly, vulkanImage);
     }
     if (desc) {
         *static_cast<UnityVulkanImage*>(desc) = vulkanImage;
@@ -101,79 +410,345 @@ void* DeviceVK::GetNativeDevice()
     return m_VkDevice;
 }
 
-void* DeviceVK::GetNativeCommandList()
+void DeviceVK::TrackImageLayout(UnityVulkanImage& vulkanImage, VkImageLayout layout)
 {
-    VkCommandPool vkCommandPool = VK_NULL_HANDLE;
-    VkCommandBuffer vkCommandBuffer = VK_NULL_HANDLE;
-    if (m_VkDevice != VK_NULL_HANDLE) {
-        //if (m_VkSemaphore != VK_NULL_HANDLE) {
-        //    uint64_t semaphoreValue = 0;
-        //    vkGetSemaphoreCounterValue(m_VkDevice, m_VkSemaphore, &semaphoreValue);
-        //    for (auto& commandBuffer : m_CommandBufferList) {
-        //        if (semaphoreValue >= commandBuffer.semaphoreValue) {
-        //            vkCommandPool = commandBuffer.vkCommandPool;
-        //            vkCommandBuffer = commandBuffer.vkCommandBuffer;
-        //            commandBuffer.semaphoreValue = (std::numeric_limits<uint64_t>::max)();
-        //            break;
-        //        }
-        //    }
-        //}
-
-        for (auto& commandBuffer : m_CommandBufferList) {
-            VkResult res = vkGetFenceStatus(m_VkDevice, commandBuffer.vkFence);
-            if (res == VK_SUCCESS) {
-                vkCommandPool = commandBuffer.vkCommandPool;
-                vkCommandBuffer = commandBuffer.vkCommandBuffer;
-                commandBuffer.semaphoreValue = (std::numeric_limits<uint64_t>::max)();
-                break;
+    if (layout == VK_IMAGE_LAYOUT_UNDEFINED || vulkanImage.image == VK_NULL_HANDLE) {
+        return;
+    }
+    // The latest transition of an image decides which layout it is in, the first one keeps the layout Unity
+    // reported.
+    ImageTransition* latest = nullptr;
+    for (ImageTransition& transition : m_ImageTransitions) {
+        if (transition.image == vulkanImage.image) {
+            latest = &transition;
+        }
+    }
+    if (latest == nullptr) {
+        m_ImageTransitions.push_back(ImageTransition{vulkanImage.image, vulkanImage.layout, layout, vulkanImage.aspect, false});
+    } else if (!latest->flushed) {
+        latest->layout = layout;
+    } else if (latest->layout != layout) {
+        m_ImageTransitions.push_back(ImageTransition{vulkanImage.image, latest->layout, layout, vulkanImage.aspect, false});
+    }
+    vulkanImage.layout = layout;
+}
+
+CommandBufferRingCounters DeviceVK::GetCommandBufferCounters()
+{
+    const CommandBufferRingCounters& graphics = m_CommandBufferRing.GetCounters();
+    const CommandBufferRingCounters& compute = m_ComputeCommandBufferRing.GetCounters();
+    CommandBufferRingCounters counters = graphics;
+    if (m_VkComputeQueue != VK_NULL_HANDLE) {
+        counters.capacity += compute.capacity;
+        counters.creations += compute.creations;
+        counters.stalls += compute.stalls;
+        counters.peakDepth = (std::max)(graphics.peakDepth, compute.peakDepth);
+    }
+    return counters;
+}
+
+void DeviceVK::FlushResourceBarriers(void* commandList)
+{
+    m_LayoutBarriers.clear();
+    VkPipelineStageFlags dstStages = 0;
+    for (ImageTransition& transition : m_ImageTransitions) {
+        if (transition.flushed) {
+            continue;
+        }
+        transition.flushed = true;
+        if (transition.oldLayout == transition.layout) {
+            continue;
+        }
+        // Whatever Unity did with the image before is unknown, only the use FFX makes of it is.
+        VkPipelineStageFlags stages = 0;
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        GetLayoutScope(transition.layout, stages, barrier.dstAccessMask);
+        dstStages |= stages;
+        barrier.oldLayout = transition.oldLayout;
+        barrier.newLayout = transition.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = transition.image;
+        barrier.subresourceRange = {transition.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+        m_LayoutBarriers.push_back(barrier);
+    }
+    if (!m_LayoutBarriers.empty()) {
+        vkCmdPipelineBarrier(static_cast<VkCommandBuffer>(commandList), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, dstStages,
+            0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(m_LayoutBarriers.size()), m_LayoutBarriers.data());
+    }
+}
+
+void DeviceVK::RestoreImageLayouts(VkCommandBuffer vkCommandBuffer)
+{
+    // Unity keeps tracking the layouts it reported, so every image FlushResourceBarriers moved goes back before
+    // the command buffer ends. Images of Unity's own command buffer are transitioned by Unity and never get here.
+    m_LayoutBarriers.clear();
+    VkPipelineStageFlags srcStages = 0;
+    for (size_t i = 0; i < m_ImageTransitions.size(); ++i) {
+        const ImageTransition& first = m_ImageTransitions[i];
+        bool seen = false;
+        for (size_t j = 0; j < i && !seen; ++j) {
+            seen = m_ImageTransitions[j].image == first.image;
+        }
+        if (seen) {
+            continue;
+        }
+        VkImageLayout layout = first.oldLayout;
+        for (size_t j = i; j < m_ImageTransitions.size(); ++j) {
+            if (m_ImageTransitions[j].image == first.image && m_ImageTransitions[j].flushed) {
+                layout = m_ImageTransitions[j].layout;
             }
         }
+        // An image Unity reported as undefined or preinitialized holds nothing Unity relies on, and neither is a
+        // valid layout to go back to.
+        if (layout == first.oldLayout || first.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED || first.oldLayout == VK_IMAGE_LAYOUT_PREINITIALIZED) {
+            continue;
+        }
+        // Only the writes FFX may have made in the layout it left the image in have to be made available.
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags access = 0;
+        GetLayoutScope(layout, stages, access);
+        srcStages |= stages;
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = access & (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        barrier.oldLayout = layout;
+        barrier.newLayout = first.oldLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = first.image;
+        barrier.subresourceRange = {first.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+        m_LayoutBarriers.push_back(barrier);
+    }
+    if (!m_LayoutBarriers.empty()) {
+        vkCmdPipelineBarrier(vkCommandBuffer, srcStages, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(m_LayoutBarriers.size()), m_LayoutBarriers.data());
+    }
+    m_ImageTransitions.clear();
+}
+
+void DeviceVK::TrackAsyncImage(const UnityVulkanImage& vulkanImage)
+{
+    if (m_AsyncCommandBuffer == VK_NULL_HANDLE || vulkanImage.image == VK_NULL_HANDLE) {
+        return;
+    }
+    for (const AsyncImage& asyncImage : m_AsyncImages) {
+        if (asyncImage.image == vulkanImage.image) {
+            return;
+        }
     }
-    if (vkCommandBuffer == VK_NULL_HANDLE) {
-        if (m_VkDevice != VK_NULL_HANDLE) {
-            if (m_pUnityGraphicsVulkan != nullptr) {
-                VkCommandPoolCreateInfo poolInfo = {};
-                poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-                poolInfo.pNext = nullptr;
-                poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-                poolInfo.queueFamilyIndex = m_pUnityGraphicsVulkan->Instance().queueFamilyIndex;
+    m_AsyncImages.push_back(AsyncImage{vulkanImage.image, vulkanImage.layout, vulkanImage.aspect});
+}
 
-                VkResult res = vkCreateCommandPool(m_VkDevice, &poolInfo, nullptr, &vkCommandPool);
-                if (res != VK_SUCCESS) {
-                    FSR_ERROR("Failed to create queue command pool!");
-                }
+bool DeviceVK::SetAsyncCompute(bool enabled)
+{
+    if (m_VkComputeQueue == VK_NULL_HANDLE) {
+        return false;
+    }
+    m_AsyncCompute.store(enabled, std::memory_order_relaxed);
+    return true;
+}
 
-                VkCommandBufferAllocateInfo allocInfo = {};
-                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-                allocInfo.pNext = nullptr;
-                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-                allocInfo.commandPool = vkCommandPool;
-                allocInfo.commandBufferCount = 1;
+bool DeviceVK::SetRecordIntoHostCommandList(bool enabled)
+{
+    m_RecordIntoUnity.store(enabled, std::memory_order_relaxed);
+    // Events of instances initialized while the mode was off are configured now. While async compute is on, the
+    // events keep its configuration, it takes precedence.
+    if (enabled && m_pUnityGraphicsVulkan != nullptr && !(m_VkComputeQueue != VK_NULL_HANDLE && m_AsyncCompute.load(std::memory_order_relaxed))) {
+        std::lock_guard<std::mutex> lock(m_PluginEventMutex);
+        for (int eventID : m_PluginEvents) {
+            if (m_RecordIntoUnityEvents.count(eventID) == 0) {
+                ConfigureRecordIntoUnity(eventID);
+            }
+        }
+    }
+    return true;
+}
 
-                res = vkAllocateCommandBuffers(m_VkDevice, &allocInfo, &vkCommandBuffer);
-                if (res != VK_SUCCESS) {
-                    FSR_ERROR("Failed to allocate a command buffer");
-                }
+void DeviceVK::ConfigurePluginEvent(int eventID)
+{
+    if (m_pUnityGraphicsVulkan == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_PluginEventMutex);
+    m_PluginEvents.insert(eventID);
+    // The graphics queue half of an async compute hand-off must be ordered after Unity's work, so Unity submits
+    // what it has recorded before the event.
+    if (m_VkComputeQueue != VK_NULL_HANDLE && m_AsyncCompute.load(std::memory_order_relaxed)) {
+        UnityVulkanPluginEventConfig eventConfig = {};
+        eventConfig.renderPassPrecondition = kUnityVulkanRenderPass_EnsureOutside;
+        eventConfig.graphicsQueueAccess = kUnityVulkanGraphicsQueueAccess_Allow;
+        eventConfig.flags = kUnityVulkanEventConfigFlag_FlushCommandBuffers;
+        m_pUnityGraphicsVulkan->ConfigureEvent(eventID, &eventConfig);
+        m_RecordIntoUnityEvents.erase(eventID);
+        return;
+    }
+    if (m_RecordIntoUnity.load(std::memory_order_relaxed)) {
+        ConfigureRecordIntoUnity(eventID);
+    }
+}
+
+// Unity has to end its render pass before the event and re-bind its state afterwards when FFX records into its
+// command buffer. Called with m_PluginEventMutex held.
+void DeviceVK::ConfigureRecordIntoUnity(int eventID)
+{
+    UnityVulkanPluginEventConfig eventConfig = {};
+    eventConfig.renderPassPrecondition = kUnityVulkanRenderPass_EnsureOutside;
+    eventConfig.graphicsQueueAccess = kUnityVulkanGraphicsQueueAccess_DontCare;
+    eventConfig.flags = kUnityVulkanEventConfigFlag_ModifiesCommandBuffersState;
+    m_pUnityGraphicsVulkan->ConfigureEvent(eventID, &eventConfig);
+    m_RecordIntoUnityEvents.insert(eventID);
+}
+
+void DeviceVK::SetCurrentPluginEvent(int eventID)
+{
+    m_RecordIntoCurrentEvent = false;
+    if (eventID != 0 && m_RecordIntoUnity.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(m_PluginEventMutex);
+        m_RecordIntoCurrentEvent = m_RecordIntoUnityEvents.count(eventID) != 0;
+    }
+}
+
+bool DeviceVK::GetRecordingState(UnityVulkanRecordingState& recordingState)
+{
+    if (m_pUnityGraphicsVulkan == nullptr) {
+        return false;
+    }
+    if (!m_pUnityGraphicsVulkan->CommandRecordingState(&recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+        return false;
+    }
+    RetireRecordedSubmissions(recordingState.safeFrameNumber);
+    return true;
+}
+
+void DeviceVK::RetireRecordedSubmissions(uint64_t safeFrameNumber)
+{
+    while (!m_RecordedSubmissions.empty() && m_RecordedSubmissions.front().frameNumber <= safeFrameNumber) {
+        m_RecordedSubmissions.pop_front();
+    }
+}
+
+bool DeviceVK::CreateCommandBuffer(uint32_t queueFamilyIndex, bool asyncCompute, CommandBuffer& commandBuffer)
+{
+    FSR_TRACE_SCOPE("Device::CreateCommandBuffer");
+    commandBuffer = {};
+    commandBuffer.semaphoreValue = (std::numeric_limits<uint64_t>::max)();
+    commandBuffer.queueFamilyIndex = queueFamilyIndex;
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.pNext = nullptr;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+    VkResult res = vkCreateCommandPool(m_VkDevice, &poolInfo, nullptr, &commandBuffer.vkCommandPool);
+    if (res != VK_SUCCESS) {
+        FSR_ERROR("Failed to create queue command pool!");
+        return false;
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandBuffer.vkCommandPool;
+    allocInfo.commandBufferCount = 1;
+
+    res = vkAllocateCommandBuffers(m_VkDevice, &allocInfo, &commandBuffer.vkCommandBuffer);
+    if (res != VK_SUCCESS) {
+        FSR_ERROR("Failed to allocate a command buffer");
+    }
+
+    if (asyncCompute) {
+        allocInfo.commandBufferCount = 2;
+        res = vkAllocateCommandBuffers(m_VkDevice, &allocInfo, commandBuffer.vkComputeTransfers);
+        if (res != VK_SUCCESS) {
+            FSR_ERROR("Failed to allocate a command buffer");
+        }
+
+        poolInfo.queueFamilyIndex = m_pUnityGraphicsVulkan->Instance().queueFamilyIndex;
+        res = vkCreateCommandPool(m_VkDevice, &poolInfo, nullptr, &commandBuffer.vkTransferCommandPool);
+        if (res != VK_SUCCESS) {
+            FSR_ERROR("Failed to create queue command pool!");
+        }
+        allocInfo.commandPool = commandBuffer.vkTransferCommandPool;
+        res = vkAllocateCommandBuffers(m_VkDevice, &allocInfo, commandBuffer.vkGraphicsTransfers);
+        if (res != VK_SUCCESS) {
+            FSR_ERROR("Failed to allocate a command buffer");
+        }
+    }
+
+    if (m_VkSemaphore == VK_NULL_HANDLE) {
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        res = vkCreateFence(m_VkDevice, &fenceInfo, nullptr, &commandBuffer.vkFence);
+        if (res != VK_SUCCESS) {
+            FSR_ERROR("Failed to create a fence");
+        }
+    }
+    return commandBuffer.vkCommandBuffer != VK_NULL_HANDLE;
+}
 
-                VkFenceCreateInfo fenceInfo = {};
-                fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-                fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+void* DeviceVK::GetNativeCommandList()
+{
+    FSR_TRACE_SCOPE("Device::GetNativeCommandList");
+    // Whatever is recorded next may use the images of the previous hand-off, and signals a later value.
+    AcquireAsyncCompute();
+    bool asyncCompute = m_VkComputeQueue != VK_NULL_HANDLE && m_AsyncCompute.load(std::memory_order_relaxed);
+    if (!asyncCompute && (m_RecordIntoCurrentEvent || !m_RecordedSubmissions.empty())) {
+        UnityVulkanRecordingState recordingState = {};
+        if (GetRecordingState(recordingState) && m_RecordIntoCurrentEvent && recordingState.commandBuffer != VK_NULL_HANDLE) {
+            RetireDeferredReleases();
+            m_pUnityGraphicsVulkan->EnsureOutsideRenderPass();
+            m_RecordingCommandBuffer = recordingState.commandBuffer;
+            m_RecordingFrameNumber = recordingState.currentFrameNumber;
+            return m_RecordingCommandBuffer;
+        }
+    }
 
-                VkFence fence = VK_NULL_HANDLE;
-                res = vkCreateFence(m_VkDevice, &fenceInfo, nullptr, &fence);
-                if (res != VK_SUCCESS) {
-                    FSR_ERROR("Failed to create a fence");
+    RetireDeferredReleases();
+    CommandBuffer* acquired = nullptr;
+    if (m_VkDevice != VK_NULL_HANDLE && m_pUnityGraphicsVulkan != nullptr) {
+        uint32_t queueFamilyIndex = asyncCompute ? m_ComputeQueueFamilyIndex : m_pUnityGraphicsVulkan->Instance().queueFamilyIndex;
+        CommandBufferRing<CommandBuffer>& ring = asyncCompute ? m_ComputeCommandBufferRing : m_CommandBufferRing;
+        bool created = false;
+        acquired = ring.Acquire(
+            [this](const CommandBuffer& commandBuffer) {
+                if (m_VkSemaphore != VK_NULL_HANDLE) {
+                    return GetSemaphoreCounterValue() >= commandBuffer.semaphoreValue;
+                }
+                return vkGetFenceStatus(m_VkDevice, commandBuffer.vkFence) == VK_SUCCESS;
+            },
+            [this, queueFamilyIndex, asyncCompute, &created](CommandBuffer& commandBuffer) {
+                created = CreateCommandBuffer(queueFamilyIndex, asyncCompute, commandBuffer);
+                return created;
+            },
+            [this](const CommandBuffer& commandBuffer) {
+                if (m_VkSemaphore != VK_NULL_HANDLE) {
+                    WaitSemaphore(commandBuffer.semaphoreValue);
+                } else if (vkWaitForFences(m_VkDevice, 1, &commandBuffer.vkFence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+                    FSR_ERROR("Failed to wait for fences.");
                 }
+            });
 
-                m_CommandBufferList.push_back(CommandBuffer{ vkCommandPool, vkCommandBuffer, (std::numeric_limits<uint64_t>::max)(), fence });
+        if (acquired != nullptr && !created) {
+            vkResetCommandPool(m_VkDevice, acquired->vkCommandPool, 0);
+            if (acquired->vkTransferCommandPool != VK_NULL_HANDLE) {
+                vkResetCommandPool(m_VkDevice, acquired->vkTransferCommandPool, 0);
             }
         }
-    } else {
-        vkResetCommandPool(m_VkDevice, vkCommandPool, 0);
-        //vkResetCommandBuffer(vkCommandBuffer, 0);
     }
 
-    if (vkCommandBuffer != VK_NULL_HANDLE) {
+    VkCommandBuffer vkCommandBuffer = VK_NULL_HANDLE;
+    if (acquired != nullptr) {
+        acquired->semaphoreValue = (std::numeric_limits<uint64_t>::max)();
+        vkCommandBuffer = acquired->vkCommandBuffer;
+
         VkCommandBufferBeginInfo beginInfo = {};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         beginInfo.pNext = nullptr;
@@ -184,6 +759,11 @@ void* DeviceVK::GetNativeCommandList()
         if (res != VK_SUCCESS) {
             FSR_ERROR("Failed to begin a command buffer");
         }
+
+        if (asyncCompute) {
+            m_AsyncCommandBuffer = vkCommandBuffer;
+            m_AsyncImages.clear();
+        }
     }
 
     return vkCommandBuffer;
@@ -191,23 +771,44 @@ void* DeviceVK::GetNativeCommandList()
 
 uint64_t DeviceVK::ExecuteCommandList(void* commandList)
 {
+    FSR_TRACE_SCOPE("Device::ExecuteCommandList");
+    if (commandList != nullptr && commandList == m_RecordingCommandBuffer) {
+        // Unity ends and submits its own command buffer, and already knows the layouts it left the images in.
+        m_RecordingCommandBuffer = VK_NULL_HANDLE;
+        m_ImageTransitions.clear();
+        ++m_SemaphoreValue;
+        m_RecordedSubmissions.push_back(RecordedSubmission{m_SemaphoreValue, m_RecordingFrameNumber});
+        RetireDeferredReleases();
+        return m_SemaphoreValue;
+    }
+
+    RestoreImageLayouts(static_cast<VkCommandBuffer>(commandList));
     vkEndCommandBuffer(static_cast<VkCommandBuffer>(commandList));
 
     ++m_SemaphoreValue;
+    m_LastPrivateValue = m_SemaphoreValue;
 
     VkFence fence = VK_NULL_HANDLE;
-    for (auto& commandBuffer : m_CommandBufferList) {
-        if (commandList == commandBuffer.vkCommandBuffer) {
-            commandBuffer.semaphoreValue = m_SemaphoreValue;
-
-            VkResult res = vkResetFences(m_VkDevice, 1, &commandBuffer.vkFence);
+    auto isCommandList = [commandList](const CommandBuffer& commandBuffer) { return commandBuffer.vkCommandBuffer == commandList; };
+    CommandBuffer* submitted = m_CommandBufferRing.Find(isCommandList);
+    if (submitted == nullptr) {
+        submitted = m_ComputeCommandBufferRing.Find(isCommandList);
+    }
+    if (submitted != nullptr) {
+        submitted->semaphoreValue = m_SemaphoreValue;
+        if (submitted->vkFence != VK_NULL_HANDLE) {
+            VkResult res = vkResetFences(m_VkDevice, 1, &submitted->vkFence);
             if (res != VK_SUCCESS) {
                 FSR_ERROR("Failed to reset fence");
             }
-
-            fence = commandBuffer.vkFence;
-            break;
         }
+        fence = submitted->vkFence;
+    }
+
+    if (submitted != nullptr && submitted->vkTransferCommandPool != VK_NULL_HANDLE) {
+        SubmitAsyncCompute(*submitted);
+        RetireDeferredReleases();
+        return m_SemaphoreValue;
     }
 
     VkSubmitInfo info = {};
@@ -218,84 +819,310 @@ uint64_t DeviceVK::ExecuteCommandList(void* commandList)
     info.pWaitDstStageMask = nullptr;
     info.pCommandBuffers = reinterpret_cast<VkCommandBuffer*>(&commandList);
     info.commandBufferCount = 1;
-    //info.signalSemaphoreCount = 1;
-    //info.pSignalSemaphores = &m_VkSemaphore;
 
-    //VkTimelineSemaphoreSubmitInfo semaphoreSubmitInfo = {};
-    //semaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
-    //semaphoreSubmitInfo.pNext = nullptr;
-    //semaphoreSubmitInfo.waitSemaphoreValueCount = 0;
-    //semaphoreSubmitInfo.pWaitSemaphoreValues = nullptr;
-    //semaphoreSubmitInfo.signalSemaphoreValueCount = 1;
-    //semaphoreSubmitInfo.pSignalSemaphoreValues = &m_SemaphoreValue;
+    VkTimelineSemaphoreSubmitInfo semaphoreSubmitInfo = {};
+    if (m_VkSemaphore != VK_NULL_HANDLE) {
+        semaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        semaphoreSubmitInfo.pNext = nullptr;
+        semaphoreSubmitInfo.waitSemaphoreValueCount = 0;
+        semaphoreSubmitInfo.pWaitSemaphoreValues = nullptr;
+        semaphoreSubmitInfo.signalSemaphoreValueCount = 1;
+        semaphoreSubmitInfo.pSignalSemaphoreValues = &m_SemaphoreValue;
 
-    //info.pNext = &semaphoreSubmitInfo;
+        info.pNext = &semaphoreSubmitInfo;
+        info.signalSemaphoreCount = 1;
+        info.pSignalSemaphores = &m_VkSemaphore;
+    }
 
-    //VkResult res = vkQueueSubmit(m_VkQueue, 1, &info, VK_NULL_HANDLE);
     VkResult res = vkQueueSubmit(m_VkQueue, 1, &info, fence);
     if (res != VK_SUCCESS) {
         FSR_ERROR("Failed to submit queue");
     }
 
+    RetireDeferredReleases();
     return m_SemaphoreValue;
 }
 
+void DeviceVK::RecordOwnershipTransfer(VkCommandBuffer vkCommandBuffer, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, bool release)
+{
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkResult res = vkBeginCommandBuffer(vkCommandBuffer, &beginInfo);
+    if (res != VK_SUCCESS) {
+        FSR_ERROR("Failed to begin a command buffer");
+    }
+
+    // Images stay in the layout Unity reported, only ownership moves. The release half only has a source scope.
+    // The acquire half runs after a semaphore wait on all commands; its source scope has to include the waiting
+    // stages to chain to that wait, so it uses all commands as well.
+    m_OwnershipBarriers.clear();
+    for (const AsyncImage& asyncImage : m_AsyncImages) {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = release ? VK_ACCESS_MEMORY_WRITE_BIT : 0;
+        barrier.dstAccessMask = release ? 0 : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        barrier.oldLayout = asyncImage.layout;
+        barrier.newLayout = asyncImage.layout;
+        barrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+        barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+        barrier.image = asyncImage.image;
+        barrier.subresourceRange = {asyncImage.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+        m_OwnershipBarriers.push_back(barrier);
+    }
+    if (!m_OwnershipBarriers.empty()) {
+        vkCmdPipelineBarrier(vkCommandBuffer,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(m_OwnershipBarriers.size()), m_OwnershipBarriers.data());
+    }
+    vkEndCommandBuffer(vkCommandBuffer);
+}
+
+void DeviceVK::SubmitAsyncCompute(CommandBuffer& commandBuffer)
+{
+    // graphics: release -> compute: acquire, dispatch, release -> graphics: acquire. The graphics acquire waits for
+    // the compute queue, so it is held back until the output is needed: graphics work Unity submits before it
+    // runs alongside the dispatch. The acquire signals the submission value, so it covers both queues. Both waits
+    // cover all commands, matching the source scope of the acquire barriers.
+    const uint32_t graphicsQueueFamilyIndex = m_pUnityGraphicsVulkan->Instance().queueFamilyIndex;
+    const VkPipelineStageFlags waitStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    RecordOwnershipTransfer(commandBuffer.vkGraphicsTransfers[0], graphicsQueueFamilyIndex, m_ComputeQueueFamilyIndex, true);
+    RecordOwnershipTransfer(commandBuffer.vkComputeTransfers[0], graphicsQueueFamilyIndex, m_ComputeQueueFamilyIndex, false);
+    RecordOwnershipTransfer(commandBuffer.vkComputeTransfers[1], m_ComputeQueueFamilyIndex, graphicsQueueFamilyIndex, true);
+    RecordOwnershipTransfer(commandBuffer.vkGraphicsTransfers[1], m_ComputeQueueFamilyIndex, graphicsQueueFamilyIndex, false);
+    m_AsyncCommandBuffer = VK_NULL_HANDLE;
+    m_AsyncImages.clear();
+
+    const uint64_t releasedValue = ++m_HandoffValue;
+    const uint64_t computedValue = ++m_HandoffValue;
+    const VkCommandBuffer computeCommandBuffers[] = {commandBuffer.vkComputeTransfers[0], commandBuffer.vkCommandBuffer, commandBuffer.vkComputeTransfers[1]};
+
+    VkTimelineSemaphoreSubmitInfo semaphoreSubmitInfos[2] = {};
+    VkSubmitInfo infos[2] = {};
+    for (uint32_t i = 0; i < 2; ++i) {
+        semaphoreSubmitInfos[i].sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        infos[i].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        infos[i].pNext = &semaphoreSubmitInfos[i];
+    }
+
+    infos[0].commandBufferCount = 1;
+    infos[0].pCommandBuffers = &commandBuffer.vkGraphicsTransfers[0];
+    infos[0].signalSemaphoreCount = 1;
+    infos[0].pSignalSemaphores = &m_VkHandoffSemaphore;
+    semaphoreSubmitInfos[0].signalSemaphoreValueCount = 1;
+    semaphoreSubmitInfos[0].pSignalSemaphoreValues = &releasedValue;
+
+    infos[1].waitSemaphoreCount = 1;
+    infos[1].pWaitSemaphores = &m_VkHandoffSemaphore;
+    infos[1].pWaitDstStageMask = &waitStages;
+    infos[1].commandBufferCount = 3;
+    infos[1].pCommandBuffers = computeCommandBuffers;
+    infos[1].signalSemaphoreCount = 1;
+    infos[1].pSignalSemaphores = &m_VkHandoffSemaphore;
+    semaphoreSubmitInfos[1].waitSemaphoreValueCount = 1;
+    semaphoreSubmitInfos[1].pWaitSemaphoreValues = &releasedValue;
+    semaphoreSubmitInfos[1].signalSemaphoreValueCount = 1;
+    semaphoreSubmitInfos[1].pSignalSemaphoreValues = &computedValue;
+
+    VkResult res = vkQueueSubmit(m_VkQueue, 1, &infos[0], VK_NULL_HANDLE);
+    if (res == VK_SUCCESS) {
+        res = vkQueueSubmit(m_VkComputeQueue, 1, &infos[1], VK_NULL_HANDLE);
+    }
+    if (res != VK_SUCCESS) {
+        FSR_ERROR("Failed to submit queue");
+        return;
+    }
+    m_PendingAcquire = PendingAcquire{commandBuffer.vkGraphicsTransfers[1], computedValue, m_SemaphoreValue};
+}
+
+void DeviceVK::AcquireAsyncCompute()
+{
+    if (m_PendingAcquire.vkCommandBuffer == VK_NULL_HANDLE) {
+        return;
+    }
+    const VkPipelineStageFlags waitStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkTimelineSemaphoreSubmitInfo semaphoreSubmitInfo = {};
+    semaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    semaphoreSubmitInfo.waitSemaphoreValueCount = 1;
+    semaphoreSubmitInfo.pWaitSemaphoreValues = &m_PendingAcquire.computedValue;
+    semaphoreSubmitInfo.signalSemaphoreValueCount = 1;
+    semaphoreSubmitInfo.pSignalSemaphoreValues = &m_PendingAcquire.semaphoreValue;
+
+    VkSubmitInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    info.pNext = &semaphoreSubmitInfo;
+    info.waitSemaphoreCount = 1;
+    info.pWaitSemaphores = &m_VkHandoffSemaphore;
+    info.pWaitDstStageMask = &waitStages;
+    info.commandBufferCount = 1;
+    info.pCommandBuffers = &m_PendingAcquire.vkCommandBuffer;
+    info.signalSemaphoreCount = 1;
+    info.pSignalSemaphores = &m_VkSemaphore;
+
+    if (vkQueueSubmit(m_VkQueue, 1, &info, VK_NULL_HANDLE) != VK_SUCCESS) {
+        FSR_ERROR("Failed to submit queue");
+    }
+    m_PendingAcquire = {};
+}
+
 void DeviceVK::Wait()
 {
+    FSR_TRACE_SCOPE("Device::Wait");
     if (m_VkDevice != VK_NULL_HANDLE) {
-        //if (m_VkSemaphore != VK_NULL_HANDLE) {
-        //    for (auto& commandBuffer : m_CommandBufferList) {
-        //        VkSemaphoreWaitInfo waitInfo = {};
-        //        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
-        //        waitInfo.pNext = nullptr;
-        //        waitInfo.flags = 0;
-        //        waitInfo.semaphoreCount = 1;
-        //        waitInfo.pSemaphores = &m_VkSemaphore;
-        //        waitInfo.pValues = &commandBuffer.semaphoreValue;
-        //        VkResult res = vkWaitSemaphores(m_VkDevice, &waitInfo, UINT64_MAX);
-        //        if (res != VK_SUCCESS) {
-        //            FSR_ERROR("Failed to wait on the queue semaphore.");
-        //        }
-        //    }
-        //}
-
-        std::vector<VkFence> fences = {};
-        for (auto& commandBuffer : m_CommandBufferList) {
-            fences.push_back(commandBuffer.vkFence);
-        }
-        VkResult res = vkWaitForFences(m_VkDevice, fences.size(), fences.data(), VK_TRUE, UINT64_MAX);
-        if (res != VK_SUCCESS) {
-            FSR_ERROR("Failed to wait for fences.");
+        AcquireAsyncCompute();
+        if (!m_RecordedSubmissions.empty()) {
+            // Unity's own submissions carry no fence of ours, wait for the whole queue. Work recorded into the
+            // frame Unity has not submitted yet cannot be waited for from here.
+            vkQueueWaitIdle(m_VkQueue);
+            UnityVulkanRecordingState recordingState = {};
+            if (GetRecordingState(recordingState)) {
+                RetireRecordedSubmissions(recordingState.currentFrameNumber - 1);
+            } else {
+                m_RecordedSubmissions.clear();
+            }
+            return;
+        }
+        if (m_VkSemaphore != VK_NULL_HANDLE) {
+            WaitSemaphore(m_LastPrivateValue);
+            return;
+        }
+
+        m_WaitFences.clear();
+        ForEachCommandBuffer([this](const CommandBuffer& commandBuffer) { m_WaitFences.push_back(commandBuffer.vkFence); });
+        if (!m_WaitFences.empty()) {
+            VkResult res = vkWaitForFences(m_VkDevice, static_cast<uint32_t>(m_WaitFences.size()), m_WaitFences.data(), VK_TRUE, UINT64_MAX);
+            if (res != VK_SUCCESS) {
+                FSR_ERROR("Failed to wait for fences.");
+            }
         }
     }
 }
 
 void DeviceVK::Wait(uint64_t fenceValue)
 {
+    FSR_TRACE_SCOPE("Device::Wait");
     if (m_VkDevice != VK_NULL_HANDLE) {
-        //if (m_VkSemaphore != VK_NULL_HANDLE) {
-        //    VkSemaphoreWaitInfo waitInfo = {};
-        //    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
-        //    waitInfo.pNext = nullptr;
-        //    waitInfo.flags = 0;
-        //    waitInfo.semaphoreCount = 1;
-        //    waitInfo.pSemaphores = &m_VkSemaphore;
-        //    waitInfo.pValues = &fenceValue;
-        //    VkResult res = vkWaitSemaphores(m_VkDevice, &waitInfo, UINT64_MAX);
-        //    if (res != VK_SUCCESS) {
-        //        FSR_ERROR("Failed to wait on the queue semaphore.");
-        //    }
-        //}
-
-        std::vector<VkFence> fences = {};
-        for (auto& commandBuffer : m_CommandBufferList) {
+        AcquireAsyncCompute();
+        if (!m_RecordedSubmissions.empty() && m_RecordedSubmissions.front().semaphoreValue <= fenceValue) {
+            Wait();
+            return;
+        }
+        if (m_VkSemaphore != VK_NULL_HANDLE) {
+            // Values of recorded submissions are never signaled, the next private submission covers them.
+            WaitSemaphore((std::min)(fenceValue, m_LastPrivateValue));
+            return;
+        }
+
+        m_WaitFences.clear();
+        ForEachCommandBuffer([this, fenceValue](const CommandBuffer& commandBuffer) {
             if (commandBuffer.semaphoreValue <= fenceValue) {
-                fences.push_back(commandBuffer.vkFence);
+                m_WaitFences.push_back(commandBuffer.vkFence);
+            }
+        });
+        if (!m_WaitFences.empty()) {
+            VkResult res = vkWaitForFences(m_VkDevice, static_cast<uint32_t>(m_WaitFences.size()), m_WaitFences.data(), VK_TRUE, UINT64_MAX);
+            if (res != VK_SUCCESS) {
+                FSR_ERROR("Failed to wait for fences.");
             }
         }
-        VkResult res = vkWaitForFences(m_VkDevice, fences.size(), fences.data(), VK_TRUE, UINT64_MAX);
-        if (res != VK_SUCCESS) {
-            FSR_ERROR("Failed to wait for fences.");
+    }
+}
+
+uint64_t DeviceVK::GetCompletedFenceValue()
+{
+    // Submissions complete in order, so everything below the oldest unsignaled submission is done.
+    uint64_t completedValue = m_SemaphoreValue;
+    if (m_VkSemaphore != VK_NULL_HANDLE) {
+        uint64_t semaphoreValue = GetSemaphoreCounterValue();
+        if (semaphoreValue < m_LastPrivateValue) {
+            completedValue = semaphoreValue;
         }
+    } else if (m_VkDevice != VK_NULL_HANDLE) {
+        ForEachCommandBuffer([this, &completedValue](const CommandBuffer& commandBuffer) {
+            if (commandBuffer.semaphoreValue <= completedValue && vkGetFenceStatus(m_VkDevice, commandBuffer.vkFence) != VK_SUCCESS) {
+                completedValue = commandBuffer.semaphoreValue - 1;
+            }
+        });
+    }
+    if (!m_RecordedSubmissions.empty()) {
+        UnityVulkanRecordingState recordingState = {};
+        GetRecordingState(recordingState);
+        if (!m_RecordedSubmissions.empty()) {
+            completedValue = (std::min)(completedValue, m_RecordedSubmissions.front().semaphoreValue - 1);
+        }
+    }
+    return completedValue;
+}
+
+bool DeviceVK::InternalInitGpuTimers()
+{
+    if (m_VkQueryPool != VK_NULL_HANDLE) {
+        return true;
+    }
+    if (m_VkDevice == VK_NULL_HANDLE || m_pUnityGraphicsVulkan == nullptr) {
+        return false;
+    }
+    const UnityVulkanInstance vulkanInstance = m_pUnityGraphicsVulkan->Instance();
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(vulkanInstance.physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(vulkanInstance.physicalDevice, &familyCount, families.data());
+    // Both queues plugin work may run on have to write timestamps.
+    uint32_t validBits = vulkanInstance.queueFamilyIndex < familyCount ? families[vulkanInstance.queueFamilyIndex].timestampValidBits : 0;
+    if (m_ComputeQueueFamilyIndex < familyCount) {
+        validBits = (std::min)(validBits, families[m_ComputeQueueFamilyIndex].timestampValidBits);
+    }
+    if (validBits == 0) {
+        FSR_LOG("The Vulkan queues do not support timestamps");
+        return false;
+    }
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(vulkanInstance.physicalDevice, &properties);
+    m_TimestampPeriod = properties.limits.timestampPeriod;
+    m_TimestampMask = validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+
+    VkQueryPoolCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.flags = 0;
+    createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    createInfo.queryCount = GpuTimerCapacity * 2;
+    createInfo.pipelineStatistics = 0;
+    VkResult res = vkCreateQueryPool(m_VkDevice, &createInfo, nullptr, &m_VkQueryPool);
+    if (res != VK_SUCCESS) {
+        FSR_ERROR("Failed to create the timestamp query pool");
+        m_VkQueryPool = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+void DeviceVK::InternalBeginGpuTimer(void* commandList, uint32_t slot)
+{
+    // Recorded outside any render pass, GetNativeCommandList has ended Unity's.
+    VkCommandBuffer vkCommandBuffer = static_cast<VkCommandBuffer>(commandList);
+    vkCmdResetQueryPool(vkCommandBuffer, m_VkQueryPool, slot * 2, 2);
+    vkCmdWriteTimestamp(vkCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_VkQueryPool, slot * 2);
+}
+
+void DeviceVK::InternalEndGpuTimer(void* commandList, uint32_t slot)
+{
+    vkCmdWriteTimestamp(static_cast<VkCommandBuffer>(commandList), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_VkQueryPool, slot * 2 + 1);
+}
+
+GpuTimerStatus DeviceVK::InternalReadGpuTimer(uint32_t slot, uint64_t& nanoseconds)
+{
+    uint64_t timestamps[2] = {};
+    VkResult res = vkGetQueryPoolResults(m_VkDevice, m_VkQueryPool, slot * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (res == VK_NOT_READY) {
+        return GPU_TIMER_PENDING;
+    }
+    if (res != VK_SUCCESS) {
+        return GPU_TIMER_LOST;
     }
+    uint64_t ticks = ((timestamps[1] & m_TimestampMask) - (timestamps[0] & m_TimestampMask)) & m_TimestampMask;
+    nanoseconds = static_cast<uint64_t>(ticks * m_TimestampPeriod);
+    return GPU_TIMER_READY;
 }
\ No newline at end of file
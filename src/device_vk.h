@@ -1,5 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
 #include <vector>
 
 #include "IUnityGraphics.h"
@@ -14,6 +18,7 @@ private:
     friend class Device;
 
 public:
+    virtual ~DeviceVK() override { Destroy(); }
     virtual UnityGfxRenderer GetDeviceType() override { return kUnityGfxRendererVulkan; }
     virtual void* GetGraphicsInterfaces() { return m_pUnityGraphicsVulkan; }
     virtual void* GetNativeResource(void* resource, void* desc = nullptr, uint32_t state = 0, bool observeOnly = true) override;
@@ -23,18 +28,68 @@ public:
     virtual uint64_t ExecuteCommandList(void* commandList) override;
     virtual void Wait() override;
     virtual void Wait(uint64_t fenceValue) override;
+    virtual bool SetRecordIntoHostCommandList(bool enabled) override;
+    virtual void ConfigurePluginEvent(int eventID) override;
+    virtual void SetCurrentPluginEvent(int eventID) override;
+    virtual bool SetAsyncCompute(bool enabled) override;
+    virtual void AcquireAsyncCompute() override;
+    virtual void FlushResourceBarriers(void* commandList) override;
+    virtual CommandBufferRingCounters GetCommandBufferCounters() override;
+
+    // Asks Unity to create its device with a compute-only queue, must run before the device exists.
+    static void InterceptInitialization(IUnityInterfaces* unityInterfaces);
 
 private:
+    virtual uint64_t GetCompletedFenceValue() override;
     virtual bool InternalInit() override;
     virtual void InternalDestroy() override;
+    bool InitTimelineSemaphore();
+    bool CreateTimelineSemaphore(VkSemaphore& semaphore);
+    uint64_t GetSemaphoreCounterValue();
+    void WaitSemaphore(uint64_t semaphoreValue);
+    bool GetRecordingState(UnityVulkanRecordingState& recordingState);
+    void RetireRecordedSubmissions(uint64_t safeFrameNumber);
+    void ConfigureRecordIntoUnity(int eventID);
+    template<typename AccessTexture>
+    void AccessImage(AccessTexture accessTexture, VkImageLayout layout, bool observeOnly, UnityVulkanImage& vulkanImage);
+    void TrackAsyncImage(const UnityVulkanImage& vulkanImage);
+    void TrackImageLayout(UnityVulkanImage& vulkanImage, VkImageLayout layout);
+    void RestoreImageLayouts(VkCommandBuffer vkCommandBuffer);
+    virtual bool InternalInitGpuTimers() override;
+    virtual void InternalBeginGpuTimer(void* commandList, uint32_t slot) override;
+    virtual void InternalEndGpuTimer(void* commandList, uint32_t slot) override;
+    virtual GpuTimerStatus InternalReadGpuTimer(uint32_t slot, uint64_t& nanoseconds) override;
 
 private:
     IUnityGraphicsVulkanV2* m_pUnityGraphicsVulkan = nullptr;
 
     VkDevice m_VkDevice = VK_NULL_HANDLE;
     VkQueue m_VkQueue = VK_NULL_HANDLE;
-    //VkSemaphore m_VkSemaphore = VK_NULL_HANDLE;
+    // Timeline semaphore signaled with the submission value, VK_NULL_HANDLE if VK_KHR_timeline_semaphore is not
+    // available, in which case every command buffer is tracked with its own fence.
+    VkSemaphore m_VkSemaphore = VK_NULL_HANDLE;
+    PFN_vkGetSemaphoreCounterValue m_pfnGetSemaphoreCounterValue = nullptr;
+    PFN_vkWaitSemaphores m_pfnWaitSemaphores = nullptr;
     uint64_t m_SemaphoreValue = 0;
+    uint64_t m_LastPrivateValue = 0;
+
+    // Work recorded into Unity's command buffer is submitted by Unity, it completes with Unity's frame.
+    struct RecordedSubmission
+    {
+        uint64_t semaphoreValue;
+        unsigned long long frameNumber;
+    };
+    std::atomic<bool> m_RecordIntoUnity = {false};
+    // Events configured through ConfigurePluginEvent, and those of them Unity knows to record into its command
+    // buffer. Only the latter do, an event Unity was not told about would leave its state and render pass broken.
+    std::mutex m_PluginEventMutex;
+    std::unordered_set<int> m_PluginEvents;
+    std::unordered_set<int> m_RecordIntoUnityEvents;
+    // Whether the event running on the render thread records into Unity's command buffer.
+    bool m_RecordIntoCurrentEvent = false;
+    VkCommandBuffer m_RecordingCommandBuffer = VK_NULL_HANDLE;
+    unsigned long long m_RecordingFrameNumber = 0;
+    std::deque<RecordedSubmission> m_RecordedSubmissions = {};
 
     struct CommandBuffer
     {
@@ -42,6 +97,67 @@ private:
         VkCommandBuffer vkCommandBuffer;
         uint64_t semaphoreValue;
         VkFence vkFence;
+        uint32_t queueFamilyIndex;
+        // Async compute only, queue family ownership transfers before [0] and after [1] the dispatch. The graphics
+        // queue ones come from vkTransferCommandPool, the compute queue ones from vkCommandPool.
+        VkCommandPool vkTransferCommandPool;
+        VkCommandBuffer vkGraphicsTransfers[2];
+        VkCommandBuffer vkComputeTransfers[2];
+    };
+    bool CreateCommandBuffer(uint32_t queueFamilyIndex, bool asyncCompute, CommandBuffer& commandBuffer);
+    void SubmitAsyncCompute(CommandBuffer& commandBuffer);
+    void RecordOwnershipTransfer(VkCommandBuffer vkCommandBuffer, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, bool release);
+    template<typename Function>
+    void ForEachCommandBuffer(Function function)
+    {
+        m_CommandBufferRing.ForEach(function);
+        m_ComputeCommandBufferRing.ForEach(function);
+    }
+    // One ring per queue, submissions only complete in order within a queue.
+    CommandBufferRing<CommandBuffer> m_CommandBufferRing{CommandBufferRingCapacity};
+    CommandBufferRing<CommandBuffer> m_ComputeCommandBufferRing{CommandBufferRingCapacity};
+    std::vector<VkFence> m_WaitFences = {};
+
+    // Layouts requested through GetNativeResource for the command buffer being recorded. They are applied with
+    // one barrier by FlushResourceBarriers and restored with one more before the command buffer is submitted.
+    struct ImageTransition
+    {
+        VkImage image;
+        VkImageLayout oldLayout;
+        VkImageLayout layout;
+        VkImageAspectFlags aspect;
+        bool flushed;
     };
-    std::vector<CommandBuffer> m_CommandBufferList = {};
+    std::vector<ImageTransition> m_ImageTransitions = {};
+    std::vector<VkImageMemoryBarrier> m_LayoutBarriers = {};
+
+    // Async compute: the dispatch runs on a compute-only queue, handing its images over with m_VkHandoffSemaphore.
+    struct AsyncImage
+    {
+        VkImage image;
+        VkImageLayout layout;
+        VkImageAspectFlags aspect;
+    };
+    std::atomic<bool> m_AsyncCompute = {false};
+    VkQueue m_VkComputeQueue = VK_NULL_HANDLE;
+    uint32_t m_ComputeQueueFamilyIndex = UINT32_MAX;
+    VkSemaphore m_VkHandoffSemaphore = VK_NULL_HANDLE;
+    uint64_t m_HandoffValue = 0;
+    VkCommandBuffer m_AsyncCommandBuffer = VK_NULL_HANDLE;
+    std::vector<AsyncImage> m_AsyncImages = {};
+    // Graphics queue acquire of the latest hand-off, submitted by AcquireAsyncCompute or before the next graphics
+    // queue submission or wait. It signals m_VkSemaphore with the submission value of the dispatch.
+    struct PendingAcquire
+    {
+        VkCommandBuffer vkCommandBuffer;
+        uint64_t computedValue;
+        uint64_t semaphoreValue;
+    };
+    PendingAcquire m_PendingAcquire = {};
+    std::vector<VkImageMemoryBarrier> m_OwnershipBarriers = {};
+
+    // Two timestamp queries per GPU timer slot. Only the low timestamp bits the queues write are compared.
+    VkQueryPool m_VkQueryPool = VK_NULL_HANDLE;
+    double m_TimestampPeriod = 0.0;
+    uint64_t m_TimestampMask = 0;
 };
\ No newline at end of file
@@ -1,66 +1,369 @@
 #include "dllloader.h"
 
+#include <cstdio>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "fsrunityplugin.h"
+#include "trace.h"
+
+using String = DllLoader::String;
+using Module = DllLoader::Module;
 
+#if defined(_WIN32)
+static const DllLoader::Char s_Separator = L'\\';
+#else
+static const DllLoader::Char s_Separator = '/';
+#endif
+static const DllLoader::Char* s_ManifestName = DLL_LOADER_TEXT("fsr_library_manifest.txt");
 
-DllLoader& DllLoader::Instance(const wchar_t* path)
+static bool FileExists(const String& path)
 {
-    static std::unordered_map<std::wstring, std::unique_ptr<DllLoader>> dllMap;
-    static std::mutex criticalSection;
-    std::lock_guard<std::mutex> lock(criticalSection);
-    if (dllMap.find(path) == dllMap.end()) {
-        dllMap[path].reset(new DllLoader);
-        bool res = dllMap[path]->LoadDll(path);
-        if (!res) {
-            FSR_ERROR("Failed to load dll");
+#if defined(_WIN32)
+    DWORD attributes = GetFileAttributesW(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+#endif
+}
+
+static bool NameEquals(const DllLoader::Char* a, const DllLoader::Char* b)
+{
+#if defined(_WIN32)
+    return _wcsicmp(a, b) == 0;
+#else
+    return strcmp(a, b) == 0;
+#endif
+}
+
+static Module OpenModule(const String& path)
+{
+#if defined(_WIN32)
+    Module module = LoadLibraryExW(path.c_str(), nullptr, LOAD_WITH_ALTERED_SEARCH_PATH);
+    if (!module) {
+        FSR_ERROR("LoadLibraryExW failed");
+    }
+#else
+    Module module = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!module) {
+        FSR_ERROR(dlerror());
+    }
+#endif
+    return module;
+}
+
+static FILE* OpenFile(const String& path, bool write)
+{
+#if defined(_WIN32)
+    return _wfopen(path.c_str(), write ? L"wb" : L"rb");
+#else
+    return fopen(path.c_str(), write ? "wb" : "rb");
+#endif
+}
+
+static String AbsolutePath(const String& path)
+{
+#if defined(_WIN32)
+    std::vector<wchar_t> buffer(MAX_PATH);
+    DWORD length = GetFullPathNameW(path.c_str(), static_cast<DWORD>(buffer.size()), buffer.data(), nullptr);
+    if (length > buffer.size()) {
+        buffer.resize(length);
+        length = GetFullPathNameW(path.c_str(), static_cast<DWORD>(buffer.size()), buffer.data(), nullptr);
+    }
+    return length > 0 ? String(buffer.data()) : path;
+#else
+    char* resolved = realpath(path.c_str(), nullptr);
+    if (resolved == nullptr) {
+        return path;
+    }
+    String result = resolved;
+    free(resolved);
+    return result;
+#endif
+}
+
+static String DirectoryOf(const String& path)
+{
+    size_t pos = path.find_last_of(DLL_LOADER_TEXT("\\/"));
+    return pos != String::npos ? path.substr(0, pos) : String(DLL_LOADER_TEXT("."));
+}
+
+static String GetPluginDirectory()
+{
+#if defined(_WIN32)
+    HMODULE module = NULL;
+    std::vector<wchar_t> path(MAX_PATH);
+    if (GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+            reinterpret_cast<LPCWSTR>(&DirectoryOf), &module)) {
+        while (GetModuleFileNameW(module, path.data(), static_cast<DWORD>(path.size())) == path.size()) {
+            path.resize(path.size() * 2);
         }
+        return DirectoryOf(path.data());
     }
-    return *dllMap[path];
+    return String();
+#else
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(&DirectoryOf), &info) && info.dli_fname != nullptr) {
+        return DirectoryOf(info.dli_fname);
+    }
+    return String();
+#endif
 }
 
-FARPROC DllLoader::GetProcAddress(LPCSTR procName)
+// Fixed locations the FFX libraries are shipped in, checked before falling back to a full directory walk.
+static std::vector<String> GetSearchPaths()
 {
-    return ::GetProcAddress(m_DLL, procName);
+    std::vector<String> paths;
+    String pluginDir = GetPluginDirectory();
+    if (!pluginDir.empty()) {
+        paths.push_back(pluginDir);
+    }
+    paths.push_back(DLL_LOADER_TEXT("."));
+#if defined(_WIN32)
+    std::vector<wchar_t> exePath(MAX_PATH);
+    while (GetModuleFileNameW(NULL, exePath.data(), static_cast<DWORD>(exePath.size())) == exePath.size()) {
+        exePath.resize(exePath.size() * 2);
+    }
+    String exe = exePath.data();
+    String exeDir = DirectoryOf(exe);
+    String dataDir = exe.substr(0, exe.find_last_of(L'.')) + L"_Data";
+    paths.push_back(exeDir);
+    paths.push_back(dataDir + L"\\Plugins\\x86_64");
+    paths.push_back(dataDir + L"\\Plugins");
+    paths.push_back(L".\\Assets\\Plugins\\x86_64");
+#endif
+    return paths;
 }
 
-inline HMODULE SearchAndLoadDll(const std::wstring& dir, const std::wstring& dllName)
+static Module SearchAndLoadDll(const String& dir, const String& dllName, String& foundPath)
 {
-    HMODULE hModule = NULL;
+    Module module = NULL;
+#if defined(_WIN32)
     WIN32_FIND_DATAW findData;
     HANDLE hFind = FindFirstFileW((dir + L"\\*").c_str(), &findData);
     if (hFind != INVALID_HANDLE_VALUE) {
         do {
             if (wcscmp(findData.cFileName, L".") == 0 || wcscmp(findData.cFileName, L"..") == 0)
                 continue;
-            std::wstring path = dir + L"\\" + findData.cFileName;
+            String path = dir + s_Separator + findData.cFileName;
             if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-                hModule = SearchAndLoadDll(path, dllName);
-            } else if (_wcsicmp(findData.cFileName, dllName.c_str()) == 0) {
-                hModule = LoadLibraryExW(path.c_str(), nullptr, LOAD_WITH_ALTERED_SEARCH_PATH);
-                if (!hModule) {
-                    //DWORD error = GetLastError();
-                    FSR_ERROR("LoadLibraryExW failed");
-                }
+                module = SearchAndLoadDll(path, dllName, foundPath);
+            } else if (NameEquals(findData.cFileName, dllName.c_str())) {
+                module = OpenModule(path);
+                foundPath = path;
             }
-            if (hModule) {
+            if (module) {
                 break;
             }
         } while (FindNextFileW(hFind, &findData));
         FindClose(hFind);
     }
-    return hModule;
+#else
+    DIR* handle = opendir(dir.c_str());
+    if (handle != nullptr) {
+        while (dirent* entry = readdir(handle)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            String path = dir + s_Separator + entry->d_name;
+            struct stat info;
+            if (lstat(path.c_str(), &info) != 0) {
+                continue;
+            }
+            if (S_ISDIR(info.st_mode)) {
+                module = SearchAndLoadDll(path, dllName, foundPath);
+            } else if (NameEquals(entry->d_name, dllName.c_str())) {
+                module = OpenModule(path);
+                foundPath = path;
+            }
+            if (module) {
+                break;
+            }
+        }
+        closedir(handle);
+    }
+#endif
+    return module;
+}
+
+// Manifest of where the directory walk last found each library, one "name\tpath\n" record per line stored in
+// the native character width so paths round-trip unchanged. It lives next to the plugin; if that directory is
+// not writable the manifest is simply not persisted.
+
+static String GetManifestPath()
+{
+    String pluginDir = GetPluginDirectory();
+    return (pluginDir.empty() ? String(DLL_LOADER_TEXT(".")) : pluginDir) + s_Separator + s_ManifestName;
+}
+
+static std::unordered_map<String, String>& GetManifest()
+{
+    static std::unordered_map<String, String> manifest;
+    static bool loaded = false;
+    if (!loaded) {
+        loaded = true;
+        if (FILE* file = OpenFile(GetManifestPath(), false)) {
+            String contents;
+            DllLoader::Char buffer[512];
+            size_t count = 0;
+            while ((count = fread(buffer, sizeof(DllLoader::Char), 512, file)) > 0) {
+                contents.append(buffer, count);
+            }
+            fclose(file);
+            size_t begin = 0;
+            while (begin < contents.size()) {
+                size_t end = contents.find(DLL_LOADER_TEXT('\n'), begin);
+                if (end == String::npos) {
+                    end = contents.size();
+                }
+                size_t tab = contents.find(DLL_LOADER_TEXT('\t'), begin);
+                if (tab != String::npos && tab < end) {
+                    manifest[contents.substr(begin, tab - begin)] = contents.substr(tab + 1, end - tab - 1);
+                }
+                begin = end + 1;
+            }
+        }
+    }
+    return manifest;
+}
+
+static void SaveManifest(const std::unordered_map<String, String>& manifest)
+{
+    FILE* file = OpenFile(GetManifestPath(), true);
+    if (file == nullptr) {
+        return;
+    }
+    for (const auto& entry : manifest) {
+        String record = entry.first + DLL_LOADER_TEXT('\t') + entry.second + DLL_LOADER_TEXT('\n');
+        fwrite(record.data(), sizeof(DllLoader::Char), record.size(), file);
+    }
+    fclose(file);
 }
 
-bool DllLoader::LoadDll(const wchar_t* path)
+// A manifest entry is only trusted if the directory walk it stands in for could have produced it: a file of
+// that name below the working directory.
+static bool IsValidManifestEntry(const String& path, const String& dllName)
 {
-    if (path != nullptr && wcscmp(m_Path.c_str(), path) != 0) {
+    String root = AbsolutePath(DLL_LOADER_TEXT(".")) + s_Separator;
+    size_t nameBegin = path.find_last_of(DLL_LOADER_TEXT("\\/"));
+    if (path.size() <= root.size() || nameBegin == String::npos || nameBegin + 1 >= path.size()) {
+        return false;
+    }
+    return NameEquals(path.substr(0, root.size()).c_str(), root.c_str()) && NameEquals(path.c_str() + nameBegin + 1, dllName.c_str()) &&
+        FileExists(path);
+}
+
+// The fixed search paths come first, so the library shipped next to the plugin always wins. The manifest only
+// replaces the directory walk that would otherwise follow.
+static Module FindAndLoadDll(const String& dllName)
+{
+    for (const String& dir : GetSearchPaths()) {
+        String path = dir + s_Separator + dllName;
+        if (FileExists(path)) {
+            if (Module module = OpenModule(path)) {
+                return module;
+            }
+        }
+    }
+
+    std::unordered_map<String, String>& manifest = GetManifest();
+    bool manifestChanged = false;
+    auto cached = manifest.find(dllName);
+    if (cached != manifest.end()) {
+        if (IsValidManifestEntry(cached->second, dllName)) {
+            if (Module module = OpenModule(cached->second)) {
+                return module;
+            }
+        }
+        FSR_WARNING("Ignoring stale FFX library manifest entry");
+        manifest.erase(cached);
+        manifestChanged = true;
+    }
+
+    FSR_LOG("FFX library not found in the search paths, scanning the working directory");
+    String resolvedPath;
+    Module module = SearchAndLoadDll(DLL_LOADER_TEXT("."), dllName, resolvedPath);
+    if (module) {
+        manifest[dllName] = AbsolutePath(resolvedPath);
+        manifestChanged = true;
+    }
+    if (manifestChanged) {
+        SaveManifest(manifest);
+    }
+    return module;
+}
+
+DllLoader& DllLoader::Instance(const Char* path)
+{
+    static std::unordered_map<String, std::unique_ptr<DllLoader>> dllMap;
+    static std::mutex criticalSection;
+    std::lock_guard<std::mutex> lock(criticalSection);
+    if (dllMap.find(path) == dllMap.end()) {
+        dllMap[path].reset(new DllLoader);
+        bool res = dllMap[path]->LoadDll(path);
+        if (!res) {
+            FSR_ERROR("Failed to load dll");
+        }
+    }
+    return *dllMap[path];
+}
+
+static std::mutex s_PreloadLock;
+static std::shared_future<bool> s_Preload;
+
+void DllLoader::Preload(bool (*load)())
+{
+    std::lock_guard<std::mutex> lock(s_PreloadLock);
+    s_Preload = std::async(std::launch::async, load).share();
+}
+
+bool DllLoader::WaitForPreload()
+{
+    std::shared_future<bool> preload;
+    {
+        std::lock_guard<std::mutex> lock(s_PreloadLock);
+        preload = s_Preload;
+    }
+    return preload.valid() && preload.get();
+}
+
+DllLoader::ProcAddress DllLoader::GetProcAddress(const char* procName)
+{
+#if defined(_WIN32)
+    return ::GetProcAddress(m_DLL, procName);
+#else
+    return dlsym(m_DLL, procName);
+#endif
+}
+
+DllLoader::ProcAddress DllLoader::ResolveProcAddress(const char* procName)
+{
+    ProcAddress proc = m_DLL != NULL ? GetProcAddress(procName) : nullptr;
+    if (proc == nullptr) {
+        std::string message = std::string("Missing FFX entry point: ") + procName;
+        FSR_ERROR(message.c_str());
+    }
+    return proc;
+}
+
+bool DllLoader::LoadDll(const Char* path)
+{
+    FSR_TRACE_SCOPE("DllLoader::LoadDll");
+    if (path != nullptr && m_Path != path) {
         Release();
         m_Path = path;
-        m_DLL = SearchAndLoadDll(L".\\", m_Path);
+        m_DLL = FindAndLoadDll(m_Path);
         return m_DLL != NULL;
     }
     return false;
@@ -68,6 +371,7 @@ bool DllLoader::LoadDll(const wchar_t* path)
 
 uint32_t DllLoader::Release()
 {
+#if defined(_WIN32)
     BOOL result = -1;
     if (m_DLL) {
         result = FreeLibrary(m_DLL);
@@ -79,4 +383,16 @@ uint32_t DllLoader::Release()
         m_DLL = NULL;
     }
     return result;
+#else
+    int result = -1;
+    if (m_DLL) {
+        result = dlclose(m_DLL);
+        if (result != 0) {
+            FSR_ERROR(dlerror());
+            return static_cast<uint32_t>(result);
+        }
+        m_DLL = NULL;
+    }
+    return static_cast<uint32_t>(result);
+#endif
 }
\ No newline at end of file
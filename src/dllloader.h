@@ -1,18 +1,59 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
+#if defined(_WIN32)
 #include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#if defined(_WIN32)
+#define DLL_LOADER_WIDEN(s) L##s
+#define DLL_LOADER_TEXT(s) DLL_LOADER_WIDEN(s)
+#else
+#define DLL_LOADER_TEXT(s) s
+#endif
 
 
 class DllLoader
 {
 public:
-    static DllLoader& Instance(const wchar_t* path);
+#if defined(_WIN32)
+    using Char = wchar_t;
+    using Module = HMODULE;
+    using ProcAddress = FARPROC;
+#else
+    using Char = char;
+    using Module = void*;
+    using ProcAddress = void*;
+#endif
+    using String = std::basic_string<Char>;
+
+public:
+    static DllLoader& Instance(const Char* path);
+
+    // Runs load on a worker thread so the library search does not stall the caller. WaitForPreload blocks
+    // until the most recent preload has finished and returns its result.
+    static void Preload(bool (*load)());
+    static bool WaitForPreload();
 
 public:
     ~DllLoader() { Release(); }
-    FARPROC GetProcAddress(LPCSTR procName);
+    bool IsLoaded() const { return m_DLL != NULL; }
+    ProcAddress GetProcAddress(const char* procName);
+
+    // Resolves procName into proc, logging an error naming the symbol when it is missing.
+    template<typename Pfn>
+    bool Resolve(const char* procName, Pfn& proc)
+    {
+        proc = reinterpret_cast<Pfn>(ResolveProcAddress(procName));
+        return proc != nullptr;
+    }
 
 protected:
     DllLoader() {}
@@ -24,10 +65,60 @@ private:
     DllLoader& operator=(const DllLoader&&) = delete;
 
 private:
-    bool LoadDll(const wchar_t* path);
+    ProcAddress ResolveProcAddress(const char* procName);
+    bool LoadDll(const Char* path);
     uint32_t Release();
 
 private:
-    std::wstring m_Path = {};
-    HMODULE m_DLL = NULL;
+    String m_Path = {};
+    Module m_DLL = NULL;
+};
+
+// Entry points resolved from the FFX libraries. Every load publishes a freshly allocated table that is never
+// written again and keeps the tables of earlier loads alive, since callers on other threads may still hold
+// them. A failed load is remembered, so calls made afterwards fail right away instead of waiting for the
+// preload again.
+template<typename Functions>
+class DllFunctionTable
+{
+public:
+    // Waits for a preload that is still resolving the table. Returns nullptr if the last load failed.
+    const Functions* Get()
+    {
+        const Functions* functions = m_Current.load(std::memory_order_acquire);
+        if (functions == nullptr && !m_Failed.load(std::memory_order_acquire)) {
+            DllLoader::WaitForPreload();
+            functions = m_Current.load(std::memory_order_acquire);
+        }
+        return functions;
+    }
+
+    bool IsPublished() const { return m_Current.load(std::memory_order_acquire) != nullptr; }
+
+    // Called before a new load resolves, so callers wait for it instead of using entry points of another device.
+    void Invalidate()
+    {
+        m_Current.store(nullptr, std::memory_order_release);
+        m_Failed.store(false, std::memory_order_release);
+    }
+
+    bool Publish(const Functions& functions)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Tables.emplace_back(new Functions(functions));
+        m_Current.store(m_Tables.back().get(), std::memory_order_release);
+        return true;
+    }
+
+    bool Fail()
+    {
+        m_Failed.store(true, std::memory_order_release);
+        return false;
+    }
+
+private:
+    std::atomic<const Functions*> m_Current = {nullptr};
+    std::atomic<bool> m_Failed = {false};
+    std::mutex m_Mutex;
+    std::vector<std::unique_ptr<const Functions>> m_Tables;
 };
\ No newline at end of file
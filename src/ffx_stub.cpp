@@ -0,0 +1,419 @@
+#include "ffx_stub.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#if defined(FSR_2)
+#include "ffx_fsr2.h"
+#elif defined(FSR_3)
+#include "FidelityFX/host/ffx_fsr3.h"
+#elif defined(FSR_API)
+#include "ffx_api.h"
+#include "ffx_upscale.h"
+#else
+#error unknown FSR version
+#endif
+
+
+namespace
+{
+    struct StubStats
+    {
+        std::atomic<uint64_t> createContext;
+        std::atomic<uint64_t> destroyContext;
+        std::atomic<uint64_t> configure;
+        std::atomic<uint64_t> query;
+        std::atomic<uint64_t> dispatchUpscale;
+        std::atomic<uint64_t> dispatchReactiveMask;
+        std::atomic<uint64_t> liveContexts;
+    };
+    StubStats g_Stats = {};
+    std::atomic<uint32_t> g_CreateLatency = {0};
+
+    void SimulateCreateLatency()
+    {
+        uint32_t latency = g_CreateLatency.load(std::memory_order_relaxed);
+        if (latency != 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(latency));
+        }
+    }
+
+    // Same sequence as the FidelityFX providers, so jitter-dependent code behaves as it would on hardware.
+    int32_t GetJitterPhaseCount(int32_t renderWidth, int32_t displayWidth)
+    {
+        if (renderWidth <= 0 || displayWidth <= 0) {
+            return 0;
+        }
+        const float basePhaseCount = 8.0f;
+        return static_cast<int32_t>(basePhaseCount * std::pow(static_cast<float>(displayWidth) / renderWidth, 2.0f));
+    }
+
+    float Halton(int32_t index, int32_t base)
+    {
+        float f = 1.0f;
+        float result = 0.0f;
+        for (int32_t currentIndex = index; currentIndex > 0;) {
+            f /= static_cast<float>(base);
+            result = result + f * static_cast<float>(currentIndex % base);
+            currentIndex = currentIndex / base;
+        }
+        return result;
+    }
+
+    bool GetJitterOffset(float* outX, float* outY, int32_t index, int32_t phaseCount)
+    {
+        if (outX == nullptr || outY == nullptr || phaseCount <= 0) {
+            return false;
+        }
+        *outX = Halton((index % phaseCount) + 1, 2) - 0.5f;
+        *outY = Halton((index % phaseCount) + 1, 3) - 0.5f;
+        return true;
+    }
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void ffxStubGetStats(FfxStubStats* stats)
+    {
+        if (stats != nullptr) {
+            stats->createContext = g_Stats.createContext.load();
+            stats->destroyContext = g_Stats.destroyContext.load();
+            stats->configure = g_Stats.configure.load();
+            stats->query = g_Stats.query.load();
+            stats->dispatchUpscale = g_Stats.dispatchUpscale.load();
+            stats->dispatchReactiveMask = g_Stats.dispatchReactiveMask.load();
+            stats->liveContexts = g_Stats.liveContexts.load();
+        }
+    }
+
+    void ffxStubResetStats()
+    {
+        g_Stats.createContext = 0;
+        g_Stats.destroyContext = 0;
+        g_Stats.configure = 0;
+        g_Stats.query = 0;
+        g_Stats.dispatchUpscale = 0;
+        g_Stats.dispatchReactiveMask = 0;
+    }
+
+    void ffxStubSetCreateLatency(uint32_t microseconds)
+    {
+        g_CreateLatency.store(microseconds, std::memory_order_relaxed);
+    }
+
+#if defined(FSR_2)
+    FfxErrorCode ffxFsr2ContextCreate(FfxFsr2Context* context, const FfxFsr2ContextDescription* contextDescription)
+    {
+        if (context == nullptr || contextDescription == nullptr) {
+            return FFX_ERROR_INVALID_POINTER;
+        }
+        SimulateCreateLatency();
+        ++g_Stats.createContext;
+        ++g_Stats.liveContexts;
+        memset(context, 0, sizeof(FfxFsr2Context));
+        return FFX_OK;
+    }
+
+    FfxErrorCode ffxFsr2ContextDestroy(FfxFsr2Context* context)
+    {
+        if (context == nullptr) {
+            return FFX_ERROR_INVALID_POINTER;
+        }
+        ++g_Stats.destroyContext;
+        --g_Stats.liveContexts;
+        return FFX_OK;
+    }
+
+    FfxErrorCode ffxFsr2ContextDispatch(FfxFsr2Context* context, const FfxFsr2DispatchDescription* dispatchDescription)
+    {
+        if (context == nullptr || dispatchDescription == nullptr) {
+            return FFX_ERROR_INVALID_POINTER;
+        }
+        ++g_Stats.dispatchUpscale;
+        return FFX_OK;
+    }
+
+    FfxErrorCode ffxFsr2ContextGenerateReactiveMask(FfxFsr2Context* context, const FfxFsr2GenerateReactiveDescription* params)
+    {
+        if (context == nullptr || params == nullptr) {
+            return FFX_ERROR_INVALID_POINTER;
+        }
+        ++g_Stats.dispatchReactiveMask;
+        return FFX_OK;
+    }
+
+    FfxErrorCode ffxFsr2GetJitterOffset(float* outX, float* outY, int32_t index, int32_t phaseCount)
+    {
+        ++g_Stats.query;
+        return GetJitterOffset(outX, outY, index, phaseCount) ? FFX_OK : FFX_ERROR_INVALID_ARGUMENT;
+    }
+
+    int32_t ffxFsr2GetJitterPhaseCount(int32_t renderWidth, int32_t displayWidth)
+    {
+        ++g_Stats.query;
+        return GetJitterPhaseCount(renderWidth, displayWidth);
+    }
+#elif defined(FSR_3)
+    FfxErrorCode ffxFsr3ContextCreate(FfxFsr3Context* context, FfxFsr3ContextDescription* contextDescription)
+    {
+        if (context == nullptr || contextDescription == nullptr) {
+            return FFX_ERROR_INVALID_POINTER;
+        }
+        SimulateCreateLatency();
+        ++g_Stats.createContext;
+        ++g_Stats.liveContexts;
+        memset(context, 0, sizeof(FfxFsr3Context));
+        return FFX_OK;
+    }
+
+    FfxErrorCode ffxFsr3ContextDestroy(FfxFsr3Context* context)
+    {
+        if (context == nullptr) {
+            return FFX_ERROR_INVALID_POINTER;
+        }
+        ++g_Stats.destroyContext;
+        --g_Stats.liveContexts;
+        return FFX_OK;
+    }
+
+    FfxErrorCode ffxFsr3ContextDispatchUpscale(FfxFsr3Context* context, const FfxFsr3DispatchUpscaleDescription* dispatchParams)
+    {
+        if (context == nullptr || dispatchParams == nullptr) {
+            return FFX_ERROR_INVALID_POINTER;
+        }
+        ++g_Stats.dispatchUpscale;
+        return FFX_OK;
+    }
+
+    FfxErrorCode ffxFsr3ContextGenerateReactiveMask(FfxFsr3Context* context, const FfxFsr3GenerateReactiveDescription* params)
+    {
+        if (context == nullptr || params == nullptr) {
+            return FFX_ERROR_INVALID_POINTER;
+        }
+        ++g_Stats.dispatchReactiveMask;
+        return FFX_OK;
+    }
+
+    FfxErrorCode ffxFsr3GetJitterOffset(float* outX, float* outY, int32_t index, int32_t phaseCount)
+    {
+        ++g_Stats.query;
+        return GetJitterOffset(outX, outY, index, phaseCount) ? FFX_OK : FFX_ERROR_INVALID_ARGUMENT;
+    }
+
+    int32_t ffxFsr3GetJitterPhaseCount(int32_t renderWidth, int32_t displayWidth)
+    {
+        ++g_Stats.query;
+        return GetJitterPhaseCount(renderWidth, displayWidth);
+    }
+#elif defined(FSR_API)
+    struct StubContext
+    {
+        uint64_t versionId;
+        ffxCreateContextDescUpscale desc;
+        ffxAllocationCallbacks memCb;
+    };
+
+    struct StubVersion
+    {
+        uint64_t id;
+        const char* name;
+    };
+
+    float GetUpscaleRatio(uint32_t qualityMode)
+    {
+        switch (qualityMode) {
+        case FFX_UPSCALE_QUALITY_MODE_NATIVEAA:
+            return 1.0f;
+        case FFX_UPSCALE_QUALITY_MODE_QUALITY:
+            return 1.5f;
+        case FFX_UPSCALE_QUALITY_MODE_BALANCED:
+            return 1.7f;
+        case FFX_UPSCALE_QUALITY_MODE_PERFORMANCE:
+            return 2.0f;
+        case FFX_UPSCALE_QUALITY_MODE_ULTRA_PERFORMANCE:
+            return 3.0f;
+        default:
+            return 0.0f;
+        }
+    }
+
+    static const StubVersion s_Versions[] = {
+        {0x0000000000030104ull, "3.1.4 (stub)"},
+        {0x0000000000020303ull, "2.3.3 (stub)"},
+    };
+
+    ffxReturnCode_t ffxCreateContext(ffxContext* context, ffxCreateContextDescHeader* desc, const ffxAllocationCallbacks* memCb)
+    {
+        if (context == nullptr || desc == nullptr) {
+            return FFX_API_RETURN_ERROR_PARAMETER;
+        }
+
+        const ffxCreateContextDescUpscale* createDesc = nullptr;
+        uint64_t versionId = s_Versions[0].id;
+        for (ffxApiHeader* it = desc; it != nullptr; it = it->pNext) {
+            if (it->type == FFX_API_CREATE_CONTEXT_DESC_TYPE_UPSCALE) {
+                createDesc = reinterpret_cast<const ffxCreateContextDescUpscale*>(it);
+            } else if (it->type == FFX_API_CREATE_CONTEXT_DESC_TYPE_OVERRIDE_VERSION) {
+                versionId = reinterpret_cast<const ffxOverrideVersion*>(it)->versionId;
+            }
+        }
+        if (createDesc == nullptr) {
+            return FFX_API_RETURN_ERROR_UNKNOWN_DESCTYPE;
+        }
+        SimulateCreateLatency();
+
+        void* memory = (memCb != nullptr && memCb->alloc != nullptr) ? memCb->alloc(memCb->pUserData, sizeof(StubContext)) : ::operator new(sizeof(StubContext), std::nothrow);
+        if (memory == nullptr) {
+            return FFX_API_RETURN_ERROR_MEMORY;
+        }
+        StubContext* stubContext = new (memory) StubContext{};
+        stubContext->versionId = versionId;
+        stubContext->desc = *createDesc;
+        stubContext->desc.header.pNext = nullptr;
+        if (memCb != nullptr) {
+            stubContext->memCb = *memCb;
+        }
+
+        ++g_Stats.createContext;
+        ++g_Stats.liveContexts;
+        *context = stubContext;
+        return FFX_API_RETURN_OK;
+    }
+
+    ffxReturnCode_t ffxDestroyContext(ffxContext* context, const ffxAllocationCallbacks* memCb)
+    {
+        if (context == nullptr || *context == nullptr) {
+            return FFX_API_RETURN_ERROR_PARAMETER;
+        }
+        StubContext* stubContext = static_cast<StubContext*>(*context);
+        ffxAllocationCallbacks createCb = stubContext->memCb;
+        stubContext->~StubContext();
+        if (createCb.dealloc != nullptr) {
+            createCb.dealloc(createCb.pUserData, stubContext);
+        } else {
+            ::operator delete(stubContext, std::nothrow);
+        }
+        *context = nullptr;
+
+        ++g_Stats.destroyContext;
+        --g_Stats.liveContexts;
+        return FFX_API_RETURN_OK;
+    }
+
+    ffxReturnCode_t ffxConfigure(ffxContext* context, const ffxConfigureDescHeader* desc)
+    {
+        ++g_Stats.configure;
+        return (context != nullptr && desc != nullptr) ? FFX_API_RETURN_OK : FFX_API_RETURN_ERROR_PARAMETER;
+    }
+
+    ffxReturnCode_t ffxQuery(ffxContext* context, ffxQueryDescHeader* desc)
+    {
+        ++g_Stats.query;
+        if (desc == nullptr) {
+            return FFX_API_RETURN_ERROR_PARAMETER;
+        }
+        switch (desc->type) {
+        case FFX_API_QUERY_DESC_TYPE_GET_VERSIONS:
+        {
+            ffxQueryDescGetVersions* versions = reinterpret_cast<ffxQueryDescGetVersions*>(desc);
+            const uint64_t versionCount = sizeof(s_Versions) / sizeof(s_Versions[0]);
+            if (versions->outputCount == nullptr) {
+                return FFX_API_RETURN_ERROR_PARAMETER;
+            }
+            if (versions->versionIds == nullptr && versions->versionNames == nullptr) {
+                *versions->outputCount = versionCount;
+                return FFX_API_RETURN_OK;
+            }
+            uint64_t count = *versions->outputCount < versionCount ? *versions->outputCount : versionCount;
+            for (uint64_t i = 0; i < count; ++i) {
+                if (versions->versionIds != nullptr) {
+                    versions->versionIds[i] = s_Versions[i].id;
+                }
+                if (versions->versionNames != nullptr) {
+                    versions->versionNames[i] = s_Versions[i].name;
+                }
+            }
+            *versions->outputCount = count;
+            return FFX_API_RETURN_OK;
+        }
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTERPHASECOUNT:
+        {
+            ffxQueryDescUpscaleGetJitterPhaseCount* query = reinterpret_cast<ffxQueryDescUpscaleGetJitterPhaseCount*>(desc);
+            if (query->pOutPhaseCount == nullptr) {
+                return FFX_API_RETURN_ERROR_PARAMETER;
+            }
+            *query->pOutPhaseCount = GetJitterPhaseCount(static_cast<int32_t>(query->renderWidth), static_cast<int32_t>(query->displayWidth));
+            return FFX_API_RETURN_OK;
+        }
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETJITTEROFFSET:
+        {
+            ffxQueryDescUpscaleGetJitterOffset* query = reinterpret_cast<ffxQueryDescUpscaleGetJitterOffset*>(desc);
+            return GetJitterOffset(query->pOutX, query->pOutY, query->index, query->phaseCount) ? FFX_API_RETURN_OK : FFX_API_RETURN_ERROR_PARAMETER;
+        }
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETUPSCALERATIOFROMQUALITYMODE:
+        {
+            ffxQueryDescUpscaleGetUpscaleRatioFromQualityMode* query = reinterpret_cast<ffxQueryDescUpscaleGetUpscaleRatioFromQualityMode*>(desc);
+            float ratio = GetUpscaleRatio(query->qualityMode);
+            if (query->pOutUpscaleRatio == nullptr || ratio == 0.0f) {
+                return FFX_API_RETURN_ERROR_PARAMETER;
+            }
+            *query->pOutUpscaleRatio = ratio;
+            return FFX_API_RETURN_OK;
+        }
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GETRENDERRESOLUTIONFROMQUALITYMODE:
+        {
+            ffxQueryDescUpscaleGetRenderResolutionFromQualityMode* query = reinterpret_cast<ffxQueryDescUpscaleGetRenderResolutionFromQualityMode*>(desc);
+            float ratio = GetUpscaleRatio(query->qualityMode);
+            if (query->pOutRenderWidth == nullptr || query->pOutRenderHeight == nullptr || ratio == 0.0f) {
+                return FFX_API_RETURN_ERROR_PARAMETER;
+            }
+            *query->pOutRenderWidth = static_cast<uint32_t>(query->displayWidth / ratio);
+            *query->pOutRenderHeight = static_cast<uint32_t>(query->displayHeight / ratio);
+            return FFX_API_RETURN_OK;
+        }
+        case FFX_API_QUERY_DESC_TYPE_UPSCALE_GPU_MEMORY_USAGE:
+        {
+            ffxQueryDescUpscaleGetGPUMemoryUsage* query = reinterpret_cast<ffxQueryDescUpscaleGetGPUMemoryUsage*>(desc);
+            if (context == nullptr || *context == nullptr || query->gpuMemoryUsageUpscaler == nullptr) {
+                return FFX_API_RETURN_ERROR_PARAMETER;
+            }
+            // Roughly the footprint of the 3.1 upscaler: history at display size, dilated inputs at render size.
+            const StubContext* stubContext = static_cast<const StubContext*>(*context);
+            uint64_t displayPixels = uint64_t(stubContext->desc.maxUpscaleSize.width) * stubContext->desc.maxUpscaleSize.height;
+            uint64_t renderPixels = uint64_t(stubContext->desc.maxRenderSize.width) * stubContext->desc.maxRenderSize.height;
+            query->gpuMemoryUsageUpscaler->totalUsageInBytes = displayPixels * 28 + renderPixels * 24;
+            query->gpuMemoryUsageUpscaler->aliasableUsageInBytes = renderPixels * 8;
+            return FFX_API_RETURN_OK;
+        }
+        default:
+            return FFX_API_RETURN_ERROR_UNKNOWN_DESCTYPE;
+        }
+    }
+
+    ffxReturnCode_t ffxDispatch(ffxContext* context, const ffxDispatchDescHeader* desc)
+    {
+        if (context == nullptr || *context == nullptr || desc == nullptr) {
+            return FFX_API_RETURN_ERROR_PARAMETER;
+        }
+        switch (desc->type) {
+        case FFX_API_DISPATCH_DESC_TYPE_UPSCALE:
+            ++g_Stats.dispatchUpscale;
+            return FFX_API_RETURN_OK;
+        case FFX_API_DISPATCH_DESC_TYPE_UPSCALE_GENERATEREACTIVEMASK:
+            ++g_Stats.dispatchReactiveMask;
+            return FFX_API_RETURN_OK;
+        default:
+            return FFX_API_RETURN_ERROR_UNKNOWN_DESCTYPE;
+        }
+    }
+#endif
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#if defined(FFX_STUB_EXPORTS)
+#define FFX_STUB_API __declspec(dllexport)
+#else
+#define FFX_STUB_API __declspec(dllimport)
+#endif
+#else
+#define FFX_STUB_API __attribute__((visibility("default")))
+#endif
+
+
+// Call counters of the stub FFX provider, which stands in for amd_fidelityfx_* / ffx_fsr2_api_* / ffx_fsr3_*
+// when the plugin is built with FSR_BACKEND=null.
+struct FfxStubStats
+{
+    uint64_t createContext;
+    uint64_t destroyContext;
+    uint64_t configure;
+    uint64_t query;
+    uint64_t dispatchUpscale;
+    uint64_t dispatchReactiveMask;
+    uint64_t liveContexts;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    FFX_STUB_API void ffxStubGetStats(FfxStubStats* stats);
+    FFX_STUB_API void ffxStubResetStats();
+    // Time every context creation takes, standing in for the pipeline compilation of a real provider.
+    FFX_STUB_API void ffxStubSetCreateLatency(uint32_t microseconds);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
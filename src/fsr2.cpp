@@ -1,11 +1,15 @@
 #include "fsr2.h"
 
+#include <atomic>
 #include <memory>
-#include <unordered_map>
 
 #include "fsrunityplugin.h"
 #include "device.h"
+#include "instancetable.h"
+#include "trace.h"
+#if defined(FSR_BACKEND_ALL) || defined(FSR_BACKEND_NULL)
 #include "dllloader.h"
+#endif
 
 #if defined(FSR_BACKEND_DX11) || defined(FSR_BACKEND_ALL)
 #include "dx11/ffx_fsr2_dx11.h"
@@ -20,126 +24,340 @@ FfxErrorCode GetInterface(void* device, void* scratchBuffer, size_t scratchBuffe
 FfxResource GetResource(FfxFsr2Context* context, void* resource, const wchar_t* name = nullptr, FfxResourceStates state = FFX_RESOURCE_STATE_COMPUTE_READ);
 FfxResource GetResourceByID(FfxFsr2Context* context, UnityTextureID textureID, const wchar_t* name = nullptr, FfxResourceStates state = FFX_RESOURCE_STATE_COMPUTE_READ);
 
-FSR2& GetFSRInstance(uint32_t id)
+static InstanceTable<FSR2>& GetInstanceTable()
 {
-    static std::unordered_map<uint32_t, std::unique_ptr<FSR2>> instances_map;
-    auto it = instances_map.find(id);
-    if (it == instances_map.end()) {
-        instances_map[id] = std::make_unique<FSR2>();
+    static InstanceTable<FSR2> instances;
+    return instances;
+}
+
+FSR2* GetFSRInstance(uint32_t id)
+{
+    FSR2* instance = GetInstanceTable().Get(id);
+    if (instance == nullptr) {
+        FSR_ERROR("Instance ID out of range");
+    }
+    return instance;
+}
+
+FSR2* FindFSRInstance(uint32_t id)
+{
+    return GetInstanceTable().Find(id);
+}
+
+static JitterCache s_JitterCache;
+
+const JitterSequence* GetJitterSequence(int32_t renderWidth, int32_t displayWidth)
+{
+    return s_JitterCache.Get(renderWidth, displayWidth, [](int32_t renderWidth, int32_t displayWidth, JitterSequence& sequence) {
+        int32_t jitterPhaseCount = ffxFsr2GetJitterPhaseCount(renderWidth, displayWidth);
+        if (jitterPhaseCount <= 0) {
+            FSR_ERROR("ffxFsr2GetJitterPhaseCount failed");
+            return false;
+        }
+        sequence.resize(jitterPhaseCount);
+        for (int32_t i = 0; i < jitterPhaseCount; ++i) {
+            if (ffxFsr2GetJitterOffset(&sequence[i][0], &sequence[i][1], i, jitterPhaseCount) != FFX_OK) {
+                FSR_ERROR("ffxFsr2GetJitterOffset failed");
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+// Internal resources created on this thread while it runs ffxFsr2ContextCreate, which is where the context
+// creates all of them. CreateTrackedResource adds to it in front of the backend.
+static thread_local GpuMemoryUsage* s_TrackedResourceMemory = nullptr;
+static std::atomic<decltype(FfxFsr2Interface::fpCreateResource)> s_BackendCreateResource = {nullptr};
+
+static uint32_t GetFormatSize(FfxSurfaceFormat format)
+{
+    switch (format) {
+    case FFX_SURFACE_FORMAT_R32G32B32A32_TYPELESS:
+    case FFX_SURFACE_FORMAT_R32G32B32A32_FLOAT:
+        return 16;
+    case FFX_SURFACE_FORMAT_R16G16B16A16_FLOAT:
+    case FFX_SURFACE_FORMAT_R32G32_FLOAT:
+        return 8;
+    case FFX_SURFACE_FORMAT_R16_FLOAT:
+    case FFX_SURFACE_FORMAT_R16_UINT:
+    case FFX_SURFACE_FORMAT_R16_UNORM:
+    case FFX_SURFACE_FORMAT_R16_SNORM:
+    case FFX_SURFACE_FORMAT_R8G8_UNORM:
+        return 2;
+    case FFX_SURFACE_FORMAT_R8_UNORM:
+    case FFX_SURFACE_FORMAT_R8_UINT:
+        return 1;
+    default:
+        return 4;
+    }
+}
+
+static FfxErrorCode CreateTrackedResource(FfxFsr2Interface* backendInterface, const FfxCreateResourceDescription* createResourceDescription, FfxResourceInternal* outResource)
+{
+    FfxErrorCode errorCode = s_BackendCreateResource.load(std::memory_order_relaxed)(backendInterface, createResourceDescription, outResource);
+    GpuMemoryUsage* usage = s_TrackedResourceMemory;
+    if (errorCode == FFX_OK && usage != nullptr) {
+        const FfxResourceDescription& desc = createResourceDescription->resourceDescription;
+        uint64_t bytes = desc.type == FFX_RESOURCE_TYPE_BUFFER ? desc.width :
+            GetTextureMemory(desc.width, desc.height, desc.depth, desc.mipCount, GetFormatSize(desc.format));
+        usage->totalBytes += bytes;
+        if ((desc.flags & FFX_RESOURCE_FLAGS_ALIASABLE) != 0) {
+            usage->aliasableBytes += bytes;
+        }
+    }
+    return errorCode;
+}
+
+static void TrackResourceMemory(FfxFsr2Interface& backendInterface)
+{
+    if (backendInterface.fpCreateResource != nullptr && backendInterface.fpCreateResource != CreateTrackedResource) {
+        s_BackendCreateResource.store(backendInterface.fpCreateResource, std::memory_order_relaxed);
+        backendInterface.fpCreateResource = CreateTrackedResource;
     }
-    return *instances_map[id];
 }
 
 FfxErrorCode FSR2::Init(const InitParam& initParam)
 {
+    FSR_TRACE_SCOPE("FSR2::Init");
+    s_JitterCache.ClearFailures();
     Destroy();
     m_Reset = true;
     FfxFsr2ContextDescription contextDesc{};
     contextDesc.flags = initParam.flags;
-    contextDesc.maxRenderSize.width = initParam.displaySizeWidth;
-    contextDesc.maxRenderSize.height = initParam.displaySizeHeight;
+    m_RenderSizeLimits = GetRenderSizeLimits(initParam.displaySizeWidth, initParam.displaySizeHeight,
+        initParam.maxRenderSizeWidth, initParam.maxRenderSizeHeight, initParam.maxUpscaleRatio);
+    m_Governor.SetLimits(m_RenderSizeLimits);
+    m_GpuTimers.Reset();
+    contextDesc.maxRenderSize.width = m_RenderSizeLimits.maxWidth;
+    contextDesc.maxRenderSize.height = m_RenderSizeLimits.maxHeight;
     contextDesc.displaySize.width = initParam.displaySizeWidth;
     contextDesc.displaySize.height = initParam.displaySizeHeight;
     contextDesc.device = Device::Instance().GetNativeDevice();
-    m_ScratchBuffer.resize(GetScratchMemorySize());
-    GetInterface(Device::Instance().GetNativeDevice(), m_ScratchBuffer.data(), m_ScratchBuffer.size(), &(contextDesc.callbacks));
-
-    const auto errorCode = ffxFsr2ContextCreate(&m_Context, &contextDesc);
-    if (errorCode == FFX_OK) {
-        m_ContextCreated = true;
-    } else {
-        FSR_ERROR("FFXFSR2 Init failed");
+    std::shared_ptr<GpuMemoryCharge> gpuMemory = GpuMemoryBudget::Instance().Charge(EstimateUpscalerMemory(contextDesc.maxRenderSize.width,
+        contextDesc.maxRenderSize.height, contextDesc.displaySize.width, contextDesc.displaySize.height));
+    if (gpuMemory == nullptr) {
+        return FFX_ERROR_OUT_OF_MEMORY;
     }
-    return errorCode;
+    std::atomic_store(&m_GpuMemory, gpuMemory);
+    // The creating thread only uses what it captures, commit() hands the context to the instance.
+    std::shared_ptr<FfxFsr2Context> context(new FfxFsr2Context{});
+    std::shared_ptr<std::vector<char>> scratchBuffer(new std::vector<char>(GetScratchMemorySize()));
+    m_HostMemoryBytes.store(sizeof(*context) + scratchBuffer->size(), std::memory_order_relaxed);
+    GetInterface(Device::Instance().GetNativeDevice(), scratchBuffer->data(), scratchBuffer->size(), &(contextDesc.callbacks));
+    TrackResourceMemory(contextDesc.callbacks);
+
+    std::shared_ptr<FfxErrorCode> error = std::make_shared<FfxErrorCode>(FFX_OK);
+    m_InitTask.Start([contextDesc, context, scratchBuffer, gpuMemory, error]() {
+        FSR_TRACE_SCOPE("ffxFsr2ContextCreate");
+        GpuMemoryUsage resourceMemory = {};
+        s_TrackedResourceMemory = &resourceMemory;
+        *error = ffxFsr2ContextCreate(context.get(), &contextDesc);
+        s_TrackedResourceMemory = nullptr;
+        if (*error != FFX_OK) {
+            FSR_ERROR("FFXFSR2 Init failed");
+            return false;
+        }
+        if (resourceMemory.totalBytes != 0) {
+            gpuMemory->Update(resourceMemory);
+        }
+        return true;
+    }, [this, context, scratchBuffer, error](bool created) {
+        m_InitError = *error;
+        if (created) {
+            m_Context = context;
+            m_ScratchBuffer = scratchBuffer;
+            m_ContextCreated = true;
+        } else {
+            std::atomic_store(&m_GpuMemory, std::shared_ptr<GpuMemoryCharge>());
+            m_HostMemoryBytes.store(0, std::memory_order_relaxed);
+        }
+    }, [context, scratchBuffer, gpuMemory]() {
+        // Superseded before its first dispatch, so nothing on the GPU refers to it.
+        Device::Instance().DeferRelease(0, [context, scratchBuffer, gpuMemory]() mutable {
+            ffxFsr2ContextDestroy(context.get());
+            gpuMemory.reset();
+        });
+    }, FSRUnityPlugin::AsyncInit.load(std::memory_order_relaxed));
+    return m_InitTask.IsPending() ? static_cast<FfxErrorCode>(FSRUnityPlugin::ReturnNotReady) : m_InitError;
 }
 
 void FSR2::Destroy()
 {
+    m_InitTask.Reset();
     if (m_ContextCreated) {
-        Device::Instance().Wait(m_FenceValue);
-        ffxFsr2ContextDestroy(&m_Context);
+        // The GPU may still be using the context, it is destroyed with its scratch memory once the last
+        // submission has completed.
+        std::shared_ptr<FfxFsr2Context> context = std::move(m_Context);
+        std::shared_ptr<std::vector<char>> scratchBuffer = std::move(m_ScratchBuffer);
+        std::shared_ptr<GpuMemoryCharge> gpuMemory = std::atomic_exchange(&m_GpuMemory, std::shared_ptr<GpuMemoryCharge>());
+        Device::Instance().DeferRelease(m_FenceValue, [context, scratchBuffer, gpuMemory]() mutable {
+            ffxFsr2ContextDestroy(context.get());
+            gpuMemory.reset();
+        });
         m_ContextCreated = false;
     }
-}
-
-std::array<float, 2> FSR2::GetJitterOffset(const int32_t index, const int32_t renderWidth, const int32_t displayWidth)
-{
-    std::array<float, 2> jitterOffset{};
-    ffxFsr2GetJitterOffset(&(jitterOffset[0]), &(jitterOffset[1]), index, ffxFsr2GetJitterPhaseCount(renderWidth, displayWidth));
-    return jitterOffset;
+    m_HostMemoryBytes.store(0, std::memory_order_relaxed);
+    std::atomic_store(&m_GpuMemory, std::shared_ptr<GpuMemoryCharge>());
 }
 
 FfxErrorCode FSR2::GenerateReactiveMask(const GenReactiveParam& genReactiveParam)
 {
-    if (m_ContextCreated) {
+    FSR_TRACE_SCOPE("FSR2::GenerateReactiveMask");
+    if (m_InitTask.IsReady()) {
+        m_GpuTimers.Collect();
         FfxCommandList commandList = Device::Instance().GetNativeCommandList();
         FfxFsr2GenerateReactiveDescription genReactiveDesc{};
-        genReactiveDesc.commandList = commandList;
-        genReactiveDesc.colorOpaqueOnly = GetResource(&m_Context, genReactiveParam.colorOpaqueOnly);
-        //genReactiveDesc.colorOpaqueOnly = GetResourceByID(&m_Context, m_TextureIDs[TextureName::COLOR_OPAQUE_ONLY]);
-        genReactiveDesc.colorPreUpscale = GetResource(&m_Context, genReactiveParam.colorPreUpscale);
-        //genReactiveDesc.colorPreUpscale = GetResourceByID(&m_Context, m_TextureIDs[TextureName::COLOR_PRE_UPSCALE]);
-        genReactiveDesc.outReactive = GetResource(&m_Context, genReactiveParam.outReactive, L"FSR2_InputReactiveMap", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
-        //genReactiveDesc.outReactive = GetResourceByID(&m_Context, m_TextureIDs[TextureName::REACTIVE], L"FSR2_InputReactiveMap", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
-        genReactiveDesc.renderSize.width = genReactiveParam.renderSizeWidth;
-        genReactiveDesc.renderSize.height = genReactiveParam.renderSizeHeight;
-        genReactiveDesc.scale = genReactiveParam.scale;
-        genReactiveDesc.cutoffThreshold = genReactiveParam.cutoffThreshold;
-        genReactiveDesc.binaryValue = genReactiveParam.binaryValue;
-        genReactiveDesc.flags = genReactiveParam.flags;
-        const auto err = ffxFsr2ContextGenerateReactiveMask(&m_Context, &genReactiveDesc);
-        if (err != FFX_OK) {
-            FSR_ERROR("FFXFSR2 GenerateReactiveMask failed");
-        }
+        SetupGenerateReactiveMask(genReactiveDesc, genReactiveParam, commandList);
+        uint64_t timer = Device::Instance().BeginGpuTimer(commandList);
+        const auto err = RecordGenerateReactiveMask(genReactiveDesc);
+        Device::Instance().EndGpuTimer(commandList, timer);
         m_FenceValue = Device::Instance().ExecuteCommandList(commandList);
+        m_GpuTimers.Submit(GPU_TIMER_REACTIVE_MASK, timer, m_FenceValue);
         return err;
+    } else if (m_InitTask.IsPending()) {
+        return static_cast<FfxErrorCode>(FSRUnityPlugin::ReturnNotReady);
     } else
         return !FFX_OK;
 }
 
 FfxErrorCode FSR2::Dispatch(const DispatchParam& dispatchParam)
 {
-    if (m_ContextCreated) {
+    FSR_TRACE_SCOPE("FSR2::Dispatch");
+    if (m_InitTask.IsReady()) {
+        m_GpuTimers.Collect();
         FfxCommandList commandList = Device::Instance().GetNativeCommandList();
         FfxFsr2DispatchDescription dispatchDesc{};
-        dispatchDesc.commandList = commandList;
-        dispatchDesc.color = GetResource(&m_Context, dispatchParam.color, L"FSR2_InputColor");
-        //dispatchDesc.color = GetResourceByID(&m_Context, m_TextureIDs[TextureName::COLOR], L"FSR2_InputColor");
-        dispatchDesc.depth = GetResource(&m_Context, dispatchParam.depth, L"FSR2_InputDepth");
-        //dispatchDesc.depth = GetResourceByID(&m_Context, m_TextureIDs[TextureName::DEPTH], L"FSR2_InputDepth");
-        dispatchDesc.motionVectors = GetResource(&m_Context, dispatchParam.motionVectors, L"FSR2_InputMotionVectors");
-        //dispatchDesc.motionVectors = GetResourceByID(&m_Context, m_TextureIDs[TextureName::MOTION_VECTORS], L"FSR2_InputMotionVectors");
-        dispatchDesc.reactive = GetResource(&m_Context, dispatchParam.reactive, L"FSR2_InputReactiveMap");
-        //dispatchDesc.reactive = GetResourceByID(&m_Context, m_TextureIDs[TextureName::REACTIVE], L"FSR2_InputReactiveMap");
-        dispatchDesc.transparencyAndComposition = GetResource(&m_Context, dispatchParam.transparencyAndComposition, L"FSR2_TransparencyAndCompositionMap");
-        //dispatchDesc.transparencyAndComposition = GetResourceByID(&m_Context, m_TextureIDs[TextureName::TRANSPARENT_AND_COMPOSITION], L"FSR2_TransparencyAndCompositionMap");
-        dispatchDesc.output = GetResource(&m_Context, dispatchParam.output, L"FSR2_OutputUpscaledColor", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
-        //dispatchDesc.output = GetResourceByID(&m_Context, m_TextureIDs[TextureName::OUTPUT], L"FSR2_OutputUpscaledColor", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
-        dispatchDesc.jitterOffset.x = dispatchParam.jitterOffsetX;
-        dispatchDesc.jitterOffset.y = dispatchParam.jitterOffsetY;
-        dispatchDesc.motionVectorScale.x = dispatchParam.motionVectorScaleX;
-        dispatchDesc.motionVectorScale.y = dispatchParam.motionVectorScaleY;
-        dispatchDesc.renderSize.width = dispatchParam.renderSizeWidth;
-        dispatchDesc.renderSize.height = dispatchParam.renderSizeHeight;
-        dispatchDesc.enableSharpening = dispatchParam.enableSharpening;
-        dispatchDesc.sharpness = dispatchParam.sharpness;
-        dispatchDesc.frameTimeDelta = dispatchParam.frameTimeDelta;
-        dispatchDesc.preExposure = dispatchParam.preExposure;
-        dispatchDesc.reset = m_Reset;
-        dispatchDesc.cameraNear = dispatchParam.cameraNear;
-        dispatchDesc.cameraFar = dispatchParam.cameraFar;
-        dispatchDesc.cameraFovAngleVertical = dispatchParam.cameraFovAngleVertical;
+        SetupDispatch(dispatchDesc, dispatchParam, commandList);
         m_Reset = false;
-        const auto err = ffxFsr2ContextDispatch(&m_Context, &dispatchDesc);
-        if (err != FFX_OK) {
-            FSR_ERROR("FFXFSR2 Dispatch failed");
-        }
+        uint64_t timer = Device::Instance().BeginGpuTimer(commandList);
+        const auto err = RecordDispatch(dispatchDesc);
+        Device::Instance().EndGpuTimer(commandList, timer);
         m_FenceValue = Device::Instance().ExecuteCommandList(commandList);
+        m_GpuTimers.Submit(GPU_TIMER_UPSCALE, timer, m_FenceValue);
         return err;
+    } else if (m_InitTask.IsPending()) {
+        return static_cast<FfxErrorCode>(FSRUnityPlugin::ReturnNotReady);
     } else
         return !FFX_OK;
 }
 
+FfxErrorCode FSR2::GenerateReactiveMaskAndDispatch(const ReactiveDispatchParam& reactiveDispatchParam)
+{
+    FSR_TRACE_SCOPE("FSR2::GenerateReactiveMaskAndDispatch");
+    return FSRSubmission<FSR2>::GenerateReactiveMaskAndDispatch(*this, reactiveDispatchParam);
+}
+
+FfxErrorCode FSR2::RecordGenerateReactiveMask(const FfxFsr2GenerateReactiveDescription& genReactiveDesc)
+{
+    FfxErrorCode err = ffxFsr2ContextGenerateReactiveMask(m_Context.get(), &genReactiveDesc);
+    if (err != FFX_OK) {
+        FSR_ERROR("FFXFSR2 GenerateReactiveMask failed");
+    }
+    return err;
+}
+
+FfxErrorCode FSR2::RecordDispatch(const FfxFsr2DispatchDescription& dispatchDesc)
+{
+    FfxErrorCode err = ffxFsr2ContextDispatch(m_Context.get(), &dispatchDesc);
+    if (err != FFX_OK) {
+        FSR_ERROR("FFXFSR2 Dispatch failed");
+    }
+    return err;
+}
+
+void FSR2::SetupGenerateReactiveMask(FfxFsr2GenerateReactiveDescription& genReactiveDesc, const GenReactiveParam& genReactiveParam, void* commandList)
+{
+    genReactiveDesc.commandList = commandList;
+    genReactiveDesc.colorOpaqueOnly = GetResource(m_Context.get(), genReactiveParam.colorOpaqueOnly);
+    //genReactiveDesc.colorOpaqueOnly = GetResourceByID(m_Context.get(), m_TextureIDs[TextureName::COLOR_OPAQUE_ONLY]);
+    genReactiveDesc.colorPreUpscale = GetResource(m_Context.get(), genReactiveParam.colorPreUpscale);
+    //genReactiveDesc.colorPreUpscale = GetResourceByID(m_Context.get(), m_TextureIDs[TextureName::COLOR_PRE_UPSCALE]);
+    genReactiveDesc.outReactive = GetResource(m_Context.get(), genReactiveParam.outReactive, L"FSR2_InputReactiveMap", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
+    //genReactiveDesc.outReactive = GetResourceByID(m_Context.get(), m_TextureIDs[TextureName::REACTIVE], L"FSR2_InputReactiveMap", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
+    genReactiveDesc.renderSize.width = genReactiveParam.renderSizeWidth;
+    genReactiveDesc.renderSize.height = genReactiveParam.renderSizeHeight;
+    genReactiveDesc.scale = genReactiveParam.scale;
+    genReactiveDesc.cutoffThreshold = genReactiveParam.cutoffThreshold;
+    genReactiveDesc.binaryValue = genReactiveParam.binaryValue;
+    genReactiveDesc.flags = genReactiveParam.flags;
+}
+
+void FSR2::SetupDispatch(FfxFsr2DispatchDescription& dispatchDesc, const DispatchParam& dispatchParam, void* commandList, const FfxResource* reactive)
+{
+    dispatchDesc.commandList = commandList;
+    dispatchDesc.color = GetResource(m_Context.get(), dispatchParam.color, L"FSR2_InputColor");
+    //dispatchDesc.color = GetResourceByID(m_Context.get(), m_TextureIDs[TextureName::COLOR], L"FSR2_InputColor");
+    dispatchDesc.depth = GetResource(m_Context.get(), dispatchParam.depth, L"FSR2_InputDepth");
+    //dispatchDesc.depth = GetResourceByID(m_Context.get(), m_TextureIDs[TextureName::DEPTH], L"FSR2_InputDepth");
+    dispatchDesc.motionVectors = GetResource(m_Context.get(), dispatchParam.motionVectors, L"FSR2_InputMotionVectors");
+    //dispatchDesc.motionVectors = GetResourceByID(m_Context.get(), m_TextureIDs[TextureName::MOTION_VECTORS], L"FSR2_InputMotionVectors");
+    dispatchDesc.reactive = reactive != nullptr ? *reactive : GetResource(m_Context.get(), dispatchParam.reactive, L"FSR2_InputReactiveMap");
+    //dispatchDesc.reactive = GetResourceByID(m_Context.get(), m_TextureIDs[TextureName::REACTIVE], L"FSR2_InputReactiveMap");
+    dispatchDesc.transparencyAndComposition = GetResource(m_Context.get(), dispatchParam.transparencyAndComposition, L"FSR2_TransparencyAndCompositionMap");
+    //dispatchDesc.transparencyAndComposition = GetResourceByID(m_Context.get(), m_TextureIDs[TextureName::TRANSPARENT_AND_COMPOSITION], L"FSR2_TransparencyAndCompositionMap");
+    dispatchDesc.output = GetResource(m_Context.get(), dispatchParam.output, L"FSR2_OutputUpscaledColor", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
+    //dispatchDesc.output = GetResourceByID(m_Context.get(), m_TextureIDs[TextureName::OUTPUT], L"FSR2_OutputUpscaledColor", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
+    dispatchDesc.jitterOffset.x = dispatchParam.jitterOffsetX;
+    dispatchDesc.jitterOffset.y = dispatchParam.jitterOffsetY;
+    dispatchDesc.motionVectorScale.x = dispatchParam.motionVectorScaleX;
+    dispatchDesc.motionVectorScale.y = dispatchParam.motionVectorScaleY;
+    dispatchDesc.renderSize.width = dispatchParam.renderSizeWidth;
+    dispatchDesc.renderSize.height = dispatchParam.renderSizeHeight;
+    ClampRenderSize(m_RenderSizeLimits, dispatchDesc.renderSize.width, dispatchDesc.renderSize.height);
+    m_Governor.Update(dispatchParam.frameTimeDelta, m_GpuTimers.GetLastUpscaleTime());
+    dispatchDesc.enableSharpening = dispatchParam.enableSharpening;
+    dispatchDesc.sharpness = dispatchParam.sharpness;
+    dispatchDesc.frameTimeDelta = dispatchParam.frameTimeDelta;
+    dispatchDesc.preExposure = dispatchParam.preExposure;
+    dispatchDesc.reset = m_Reset;
+    dispatchDesc.cameraNear = dispatchParam.cameraNear;
+    dispatchDesc.cameraFar = dispatchParam.cameraFar;
+    dispatchDesc.cameraFovAngleVertical = dispatchParam.cameraFovAngleVertical;
+}
+
+FfxErrorCode DispatchFSRBatch(uint32_t count, const uint32_t* instanceIDs, const DispatchParam* dispatchParams)
+{
+    FSR_TRACE_SCOPE("DispatchFSRBatch");
+    return FSRSubmission<FSR2>::DispatchBatch(count, instanceIDs, dispatchParams, &FindFSRInstance);
+}
+
+HostArenaCounters FSR2::GetHostMemoryUsage() const
+{
+    uint64_t bytes = m_HostMemoryBytes.load(std::memory_order_relaxed);
+    uint64_t allocations = bytes != 0 ? 2 : 0;
+    return HostArenaCounters{bytes, bytes, bytes, allocations, allocations};
+}
+
+GpuMemoryUsage FSR2::GetGpuMemoryUsage() const
+{
+    std::shared_ptr<GpuMemoryCharge> gpuMemory = std::atomic_load(&m_GpuMemory);
+    return gpuMemory != nullptr ? gpuMemory->GetUsage() : GpuMemoryUsage{};
+}
+
+GovernorResult FSR2::GetGovernedRenderSize() const
+{
+    GovernorResult result = {};
+    m_Governor.GetRenderSize(result.renderSizeWidth, result.renderSizeHeight);
+    const JitterSequence* sequence = GetJitterSequence(static_cast<int32_t>(result.renderSizeWidth), static_cast<int32_t>(m_RenderSizeLimits.displayWidth));
+    result.jitterPhaseCount = sequence != nullptr ? static_cast<int32_t>(sequence->size()) : 0;
+    return result;
+}
+
+bool FSR2::GetRenderResolution(uint32_t qualityMode, uint32_t displayWidth, uint32_t displayHeight, RenderResolution& resolution) const
+{
+    static RenderResolutionCache cache;
+    return cache.Get(qualityMode, displayWidth, displayHeight, 0, resolution, [&](RenderResolution& resolved) {
+        return GetQualityModeRenderResolution(qualityMode, displayWidth, displayHeight, resolved);
+    });
+}
+
+bool FSR2::GetUpscaleRatio(uint32_t qualityMode, float& ratio) const
+{
+    ratio = GetQualityModeUpscaleRatio(qualityMode);
+    return ratio != 0.0f;
+}
+
 void FSR2::SetTextureID(const TextureName textureName, const UnityTextureID textureID)
 {
     if (textureName > TextureName::INVALID && textureName < TextureName::MAX) {
@@ -158,6 +376,10 @@ size_t GetScratchMemorySize()
 #if defined(FSR_BACKEND_DX12) || defined(FSR_BACKEND_ALL)
     case kUnityGfxRendererD3D12:
         return ffxFsr2GetScratchMemorySizeDX12();
+#endif
+#if defined(FSR_BACKEND_NULL)
+    case kUnityGfxRendererNull:
+        return 0;
 #endif
     default:
         FSR_ERROR("Unsupported fsr2 backend");
@@ -176,6 +398,10 @@ FfxErrorCode GetInterface(void* device, void* scratchBuffer, size_t scratchBuffe
 #if defined(FSR_BACKEND_DX12) || defined(FSR_BACKEND_ALL)
     case kUnityGfxRendererD3D12:
         return ffxFsr2GetInterfaceDX12(fsr2Interface, static_cast<ID3D12Device*>(device), scratchBuffer, scratchBuffersize);
+#endif
+#if defined(FSR_BACKEND_NULL)
+    case kUnityGfxRendererNull:
+        return FFX_OK;
 #endif
     default:
         FSR_ERROR("Unsupported fsr2 backend");
@@ -185,6 +411,7 @@ FfxErrorCode GetInterface(void* device, void* scratchBuffer, size_t scratchBuffe
 
 FfxResource GetResource(FfxFsr2Context* context, void* resource, const wchar_t* name, FfxResourceStates state)
 {
+    FSR_TRACE_SCOPE("GetResource");
     UnityGfxRenderer renderer = Device::Instance().GetDeviceType();
     switch (renderer) {
 #if defined(FSR_BACKEND_DX11) || defined(FSR_BACKEND_ALL)
@@ -216,6 +443,15 @@ FfxResource GetResource(FfxFsr2Context* context, void* resource, const wchar_t*
         void* nativeResource = Device::Instance().GetNativeResource(resource, nullptr, getResourceState(state));
         return ffxGetResourceDX12(context, static_cast<ID3D12Resource*>(nativeResource), name, state);
     }
+#endif
+#if defined(FSR_BACKEND_NULL)
+    case kUnityGfxRendererNull:
+    {
+        FfxResource res{};
+        res.resource = Device::Instance().GetNativeResource(resource);
+        res.state = state;
+        return res;
+    }
 #endif
     default:
         FSR_ERROR("Unsupported fsr2 backend");
@@ -225,6 +461,7 @@ FfxResource GetResource(FfxFsr2Context* context, void* resource, const wchar_t*
 
 FfxResource GetResourceByID(FfxFsr2Context* context, UnityTextureID textureID, const wchar_t* name, FfxResourceStates state)
 {
+    FSR_TRACE_SCOPE("GetResourceByID");
     UnityGfxRenderer renderer = Device::Instance().GetDeviceType();
     switch (renderer) {
 #if defined(FSR_BACKEND_DX11) || defined(FSR_BACKEND_ALL)
@@ -256,6 +493,15 @@ FfxResource GetResourceByID(FfxFsr2Context* context, UnityTextureID textureID, c
         void* nativeResource = Device::Instance().GetNativeResourceByID(textureID, nullptr, getResourceState(state));
         return ffxGetResourceDX12(context, static_cast<ID3D12Resource*>(nativeResource), name, state);
     }
+#endif
+#if defined(FSR_BACKEND_NULL)
+    case kUnityGfxRendererNull:
+    {
+        FfxResource res{};
+        res.resource = Device::Instance().GetNativeResourceByID(textureID);
+        res.state = state;
+        return res;
+    }
 #endif
     default:
         FSR_ERROR("Unsupported fsr2 backend");
@@ -296,86 +542,161 @@ inline std::wstring GetDllNameBackend()
 }
 
 typedef size_t(*PfnFfxFsr2GetScratchMemorySizeDX11)();
+typedef size_t(*PfnFfxFsr2GetScratchMemorySizeDX12)();
+typedef FfxErrorCode(*PfnFfxFsr2GetInterfaceDX11)(FfxFsr2Interface* fsr2Interface, ID3D11Device* device, void* scratchBuffer, size_t scratchBufferSize);
+typedef FfxErrorCode(*PfnFfxFsr2GetInterfaceDX12)(FfxFsr2Interface* fsr2Interface, ID3D12Device* device, void* scratchBuffer, size_t scratchBufferSize);
+typedef FfxResource(*PfnFfxGetResourceDX11)(FfxFsr2Context* context, ID3D11Resource* resDx11, const wchar_t* name, FfxResourceStates state);
+typedef FfxResource(*PfnFfxGetResourceDX12)(FfxFsr2Context* context, ID3D12Resource* resDx12, const wchar_t* name, FfxResourceStates state, UINT shaderComponentMapping);
+typedef FfxErrorCode(*PfnFfxFsr2ContextCreate)(FfxFsr2Context* context, const FfxFsr2ContextDescription* contextDescription);
+typedef FfxErrorCode(*PfnFfxFsr2ContextDestroy)(FfxFsr2Context* context);
+typedef FfxErrorCode(*PfnFfxFsr2GetJitterOffset)(float* outX, float* outY, int32_t index, int32_t phaseCount);
+typedef int32_t(*PfnFfxFsr2GetJitterPhaseCount)(int32_t renderWidth, int32_t displayWidth);
+typedef FfxErrorCode(*PfnFfxFsr2ContextGenerateReactiveMask)(FfxFsr2Context* context, const FfxFsr2GenerateReactiveDescription* params);
+typedef FfxErrorCode(*PfnFfxFsr2ContextDispatch)(FfxFsr2Context* context, const FfxFsr2DispatchDescription* dispatchDescription);
+
+struct Fsr2Functions
+{
+    PfnFfxFsr2GetScratchMemorySizeDX11 ffxFsr2GetScratchMemorySizeDX11;
+    PfnFfxFsr2GetScratchMemorySizeDX12 ffxFsr2GetScratchMemorySizeDX12;
+    PfnFfxFsr2GetInterfaceDX11 ffxFsr2GetInterfaceDX11;
+    PfnFfxFsr2GetInterfaceDX12 ffxFsr2GetInterfaceDX12;
+    PfnFfxGetResourceDX11 ffxGetResourceDX11;
+    PfnFfxGetResourceDX12 ffxGetResourceDX12;
+    PfnFfxFsr2ContextCreate ffxFsr2ContextCreate;
+    PfnFfxFsr2ContextDestroy ffxFsr2ContextDestroy;
+    PfnFfxFsr2GetJitterOffset ffxFsr2GetJitterOffset;
+    PfnFfxFsr2GetJitterPhaseCount ffxFsr2GetJitterPhaseCount;
+    PfnFfxFsr2ContextGenerateReactiveMask ffxFsr2ContextGenerateReactiveMask;
+    PfnFfxFsr2ContextDispatch ffxFsr2ContextDispatch;
+};
+
+static DllFunctionTable<Fsr2Functions> s_Fsr2;
+
+inline const Fsr2Functions* GetFsr2Functions()
+{
+    return s_Fsr2.Get();
+}
+
+bool LoadFSRFunctions()
+{
+    FSR_TRACE_SCOPE("LoadFSRFunctions");
+    static UnityGfxRenderer loadedRenderer = kUnityGfxRendererNull;
+    UnityGfxRenderer renderer = Device::Instance().GetDeviceType();
+    if (s_Fsr2.IsPublished() && loadedRenderer == renderer) {
+        return true;
+    }
+    s_Fsr2.Invalidate();
+
+    DllLoader& dll = DllLoader::Instance(GetDllName().c_str());
+    DllLoader& dllBackend = DllLoader::Instance(GetDllNameBackend().c_str());
+    if (!dll.IsLoaded() || !dllBackend.IsLoaded()) {
+        return s_Fsr2.Fail();
+    }
+    Fsr2Functions functions = {};
+    bool resolved = true;
+    resolved &= dll.Resolve("ffxFsr2ContextCreate", functions.ffxFsr2ContextCreate);
+    resolved &= dll.Resolve("ffxFsr2ContextDestroy", functions.ffxFsr2ContextDestroy);
+    resolved &= dll.Resolve("ffxFsr2GetJitterOffset", functions.ffxFsr2GetJitterOffset);
+    resolved &= dll.Resolve("ffxFsr2GetJitterPhaseCount", functions.ffxFsr2GetJitterPhaseCount);
+    resolved &= dll.Resolve("ffxFsr2ContextGenerateReactiveMask", functions.ffxFsr2ContextGenerateReactiveMask);
+    resolved &= dll.Resolve("ffxFsr2ContextDispatch", functions.ffxFsr2ContextDispatch);
+    if (renderer == kUnityGfxRendererD3D11) {
+        resolved &= dllBackend.Resolve("ffxFsr2GetScratchMemorySizeDX11", functions.ffxFsr2GetScratchMemorySizeDX11);
+        resolved &= dllBackend.Resolve("ffxFsr2GetInterfaceDX11", functions.ffxFsr2GetInterfaceDX11);
+        resolved &= dllBackend.Resolve("ffxGetResourceDX11", functions.ffxGetResourceDX11);
+    }
+    if (renderer == kUnityGfxRendererD3D12) {
+        resolved &= dllBackend.Resolve("ffxFsr2GetScratchMemorySizeDX12", functions.ffxFsr2GetScratchMemorySizeDX12);
+        resolved &= dllBackend.Resolve("ffxFsr2GetInterfaceDX12", functions.ffxFsr2GetInterfaceDX12);
+        resolved &= dllBackend.Resolve("ffxGetResourceDX12", functions.ffxGetResourceDX12);
+    }
+    if (!resolved) {
+        return s_Fsr2.Fail();
+    }
+    loadedRenderer = renderer;
+    return s_Fsr2.Publish(functions);
+}
+
 size_t ffxFsr2GetScratchMemorySizeDX11()
 {
-    static PfnFfxFsr2GetScratchMemorySizeDX11 getScratchMemorySizeDX11 = reinterpret_cast<PfnFfxFsr2GetScratchMemorySizeDX11>(DllLoader::Instance(GetDllNameBackend().c_str()).GetProcAddress("ffxFsr2GetScratchMemorySizeDX11"));
-    return getScratchMemorySizeDX11();
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxFsr2GetScratchMemorySizeDX11() : 0;
 }
 
-typedef size_t(*PfnFfxFsr2GetScratchMemorySizeDX12)();
 size_t ffxFsr2GetScratchMemorySizeDX12()
 {
-    static PfnFfxFsr2GetScratchMemorySizeDX12 getScratchMemorySizeDX12 = reinterpret_cast<PfnFfxFsr2GetScratchMemorySizeDX12>(DllLoader::Instance(GetDllNameBackend().c_str()).GetProcAddress("ffxFsr2GetScratchMemorySizeDX12"));
-    return getScratchMemorySizeDX12();
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxFsr2GetScratchMemorySizeDX12() : 0;
 }
 
-typedef FfxErrorCode(*PfnFfxFsr2GetInterfaceDX11)(FfxFsr2Interface* fsr2Interface, ID3D11Device* device, void* scratchBuffer, size_t scratchBufferSize);
 FfxErrorCode ffxFsr2GetInterfaceDX11(FfxFsr2Interface* fsr2Interface, ID3D11Device* device, void* scratchBuffer, size_t scratchBufferSize)
 {
-    static PfnFfxFsr2GetInterfaceDX11 getInterfaceDX11 = reinterpret_cast<PfnFfxFsr2GetInterfaceDX11>(DllLoader::Instance(GetDllNameBackend().c_str()).GetProcAddress("ffxFsr2GetInterfaceDX11"));
-    return getInterfaceDX11(fsr2Interface, device, scratchBuffer, scratchBufferSize);
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxFsr2GetInterfaceDX11(fsr2Interface, device, scratchBuffer, scratchBufferSize) : FFX_ERROR_INCOMPLETE_INTERFACE;
 }
 
-typedef FfxErrorCode(*PfnFfxFsr2GetInterfaceDX12)(FfxFsr2Interface* fsr2Interface, ID3D12Device* device, void* scratchBuffer, size_t scratchBufferSize);
 FfxErrorCode ffxFsr2GetInterfaceDX12(FfxFsr2Interface* fsr2Interface, ID3D12Device* device, void* scratchBuffer, size_t scratchBufferSize)
 {
-    static PfnFfxFsr2GetInterfaceDX12 getInterfaceDX12 = reinterpret_cast<PfnFfxFsr2GetInterfaceDX12>(DllLoader::Instance(GetDllNameBackend().c_str()).GetProcAddress("ffxFsr2GetInterfaceDX12"));
-    return getInterfaceDX12(fsr2Interface, device, scratchBuffer, scratchBufferSize);
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxFsr2GetInterfaceDX12(fsr2Interface, device, scratchBuffer, scratchBufferSize) : FFX_ERROR_INCOMPLETE_INTERFACE;
 }
 
-typedef FfxResource(*PfnFfxGetResourceDX11)(FfxFsr2Context* context, ID3D11Resource* resDx11, const wchar_t* name, FfxResourceStates state);
 FfxResource ffxGetResourceDX11(FfxFsr2Context* context, ID3D11Resource* resDx11, const wchar_t* name, FfxResourceStates state)
 {
-    static PfnFfxGetResourceDX11 getResourceDX11 = reinterpret_cast<PfnFfxGetResourceDX11>(DllLoader::Instance(GetDllNameBackend().c_str()).GetProcAddress("ffxGetResourceDX11"));
-    return getResourceDX11(context, resDx11, name, state);
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxGetResourceDX11(context, resDx11, name, state) : FfxResource{};
 }
 
-typedef FfxResource(*PfnFfxGetResourceDX12)(FfxFsr2Context* context, ID3D12Resource* resDx12, const wchar_t* name, FfxResourceStates state, UINT shaderComponentMapping);
 FfxResource ffxGetResourceDX12(FfxFsr2Context* context, ID3D12Resource* resDx12, const wchar_t* name, FfxResourceStates state, UINT shaderComponentMapping)
 {
-    static PfnFfxGetResourceDX12 getResourceDX12 = reinterpret_cast<PfnFfxGetResourceDX12>(DllLoader::Instance(GetDllNameBackend().c_str()).GetProcAddress("ffxGetResourceDX12"));
-    return getResourceDX12(context, resDx12, name, state, shaderComponentMapping);
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxGetResourceDX12(context, resDx12, name, state, shaderComponentMapping) : FfxResource{};
 }
 
-typedef FfxErrorCode(*PfnFfxFsr2ContextCreate)(FfxFsr2Context* context, const FfxFsr2ContextDescription* contextDescription);
 FfxErrorCode ffxFsr2ContextCreate(FfxFsr2Context* context, const FfxFsr2ContextDescription* contextDescription)
 {
-    static PfnFfxFsr2ContextCreate fsr2ContextCreate = reinterpret_cast<PfnFfxFsr2ContextCreate>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr2ContextCreate"));
-    return fsr2ContextCreate(context, contextDescription);
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxFsr2ContextCreate(context, contextDescription) : FFX_ERROR_INCOMPLETE_INTERFACE;
 }
 
-typedef FfxErrorCode(*PfnFfxFsr2ContextDestroy)(FfxFsr2Context* context);
 FfxErrorCode ffxFsr2ContextDestroy(FfxFsr2Context* context)
 {
-    static PfnFfxFsr2ContextDestroy fsr2ContextDestroy = reinterpret_cast<PfnFfxFsr2ContextDestroy>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr2ContextDestroy"));
-    return fsr2ContextDestroy(context);
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxFsr2ContextDestroy(context) : FFX_ERROR_INCOMPLETE_INTERFACE;
 }
 
-typedef FfxErrorCode(*PfnFfxFsr2GetJitterOffset)(float* outX, float* outY, int32_t index, int32_t phaseCount);
 FfxErrorCode ffxFsr2GetJitterOffset(float* outX, float* outY, int32_t index, int32_t phaseCount)
 {
-    static PfnFfxFsr2GetJitterOffset fsr2GetJitterOffset = reinterpret_cast<PfnFfxFsr2GetJitterOffset>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr2GetJitterOffset"));
-    return fsr2GetJitterOffset(outX, outY, index, phaseCount);
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxFsr2GetJitterOffset(outX, outY, index, phaseCount) : FFX_ERROR_INCOMPLETE_INTERFACE;
 }
 
-typedef int32_t(*PfnFfxFsr2GetJitterPhaseCount)(int32_t renderWidth, int32_t displayWidth);
 int32_t ffxFsr2GetJitterPhaseCount(int32_t renderWidth, int32_t displayWidth)
 {
-    static PfnFfxFsr2GetJitterPhaseCount fsr2GetJitterPhaseCount = reinterpret_cast<PfnFfxFsr2GetJitterPhaseCount>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr2GetJitterPhaseCount"));
-    return fsr2GetJitterPhaseCount(renderWidth, displayWidth);
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxFsr2GetJitterPhaseCount(renderWidth, displayWidth) : 0;
 }
 
-typedef FfxErrorCode(*PfnFfxFsr2ContextGenerateReactiveMask)(FfxFsr2Context* context, const FfxFsr2GenerateReactiveDescription* params);
 FfxErrorCode ffxFsr2ContextGenerateReactiveMask(FfxFsr2Context* context, const FfxFsr2GenerateReactiveDescription* params)
 {
-    static PfnFfxFsr2ContextGenerateReactiveMask fsr2ContextGenerateReactiveMask = reinterpret_cast<PfnFfxFsr2ContextGenerateReactiveMask>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr2ContextGenerateReactiveMask"));
-    return fsr2ContextGenerateReactiveMask(context, params);
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxFsr2ContextGenerateReactiveMask(context, params) : FFX_ERROR_INCOMPLETE_INTERFACE;
 }
 
-typedef FfxErrorCode(*PfnFfxFsr2ContextDispatch)(FfxFsr2Context* context, const FfxFsr2DispatchDescription* dispatchDescription);
 FfxErrorCode ffxFsr2ContextDispatch(FfxFsr2Context* context, const FfxFsr2DispatchDescription* dispatchDescription)
 {
-    static PfnFfxFsr2ContextDispatch fsr2ContextDispatch = reinterpret_cast<PfnFfxFsr2ContextDispatch>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr2ContextDispatch"));
-    return fsr2ContextDispatch(context, dispatchDescription);
+    const Fsr2Functions* functions = GetFsr2Functions();
+    return functions != nullptr ? functions->ffxFsr2ContextDispatch(context, dispatchDescription) : FFX_ERROR_INCOMPLETE_INTERFACE;
+}
+#elif defined(FSR_BACKEND_NULL)
+bool LoadFSRFunctions()
+{
+    // The stub provider is linked directly, locating it runs the same discovery path as FSR_BACKEND_ALL builds.
+    return DllLoader::Instance(DLL_LOADER_TEXT(FFX_STUB_LIBRARY_NAME)).IsLoaded();
+}
+#else
+bool LoadFSRFunctions()
+{
+    return true;
 }
 #endif
\ No newline at end of file
@@ -1,9 +1,19 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <memory>
 #include <vector>
 
 #include "IUnityInterface.h"
+#include "contextinittask.h"
+#include "fsrsubmission.h"
+#include "gpumemorybudget.h"
+#include "gputimerstats.h"
+#include "hostarena.h"
+#include "jittercache.h"
+#include "rendersize.h"
+#include "resolutiongovernor.h"
 #include "ffx_fsr2.h"
 
 
@@ -21,11 +31,18 @@ enum TextureName
     MAX
 };
 
+// FSRInit reads up to displaySizeHeight, the layout callers had before the render size envelope was added.
+// FSRInitEx takes the size of the caller's struct, and the fields past it are 0.
 struct InitParam
 {
     uint32_t flags;
     uint32_t displaySizeWidth;
     uint32_t displaySizeHeight;
+    // Largest render size the instance dispatches at, the context is sized for it. 0 for the display size.
+    uint32_t maxRenderSizeWidth;
+    uint32_t maxRenderSizeHeight;
+    // Largest display to render size ratio dynamic resolution may go to, 0 for no limit.
+    float maxUpscaleRatio;
 };
 
 struct GenReactiveParam
@@ -64,6 +81,30 @@ struct DispatchParam
     float cameraFovAngleVertical;
 };
 
+// Payload of the REACTIVEMASK_DISPATCH event. genReactive.outReactive is written and then read by the upscale,
+// dispatch.reactive is ignored.
+struct ReactiveDispatchParam
+{
+    GenReactiveParam genReactive;
+    DispatchParam dispatch;
+};
+
+// Payload of the DISPATCH_BATCH event, params[i] is the dispatch of instance instanceIDs[i].
+struct DispatchBatchParam
+{
+    uint32_t count;
+    const uint32_t* instanceIDs;
+    const DispatchParam* params;
+};
+
+// Payload of the INITIALIZE_EX event, the FSRInitEx arguments. initParamSize is sizeof the caller's InitParam.
+struct InitExParam
+{
+    uint32_t initParamSize;
+    uint32_t fsrVersion;
+    InitParam initParam;
+};
+
 class FSR2
 {
 public:
@@ -71,19 +112,74 @@ public:
     uint64_t Query(uint32_t fsrVersion) { return fsrVersion == 2; }
     FfxErrorCode Init(const InitParam& initParam);
     void Destroy();
-    std::array<float, 2> GetJitterOffset(const int32_t index, const int32_t renderWidth, const int32_t displayWidth);
     FfxErrorCode GenerateReactiveMask(const GenReactiveParam& genReactiveParam);
     FfxErrorCode Dispatch(const DispatchParam& dispatchParam);
+    // Both passes in one command list and one submission.
+    FfxErrorCode GenerateReactiveMaskAndDispatch(const ReactiveDispatchParam& reactiveDispatchParam);
     void SetTextureID(const TextureName textureName, const UnityTextureID textureID);
+    uint32_t GetInitStatus() const { return m_InitTask.GetStatus(); }
+    HostArenaCounters GetHostMemoryUsage() const;
+    GpuMemoryUsage GetGpuMemoryUsage() const;
+    void SetGovernor(const GovernorParam& governorParam) { m_Governor.Configure(governorParam); }
+    bool IsGovernorEnabled() const { return m_Governor.IsEnabled(); }
+    GovernorResult GetGovernedRenderSize() const;
+    FSRStats GetStats() const { return m_GpuTimers.GetStats(); }
+    // Render size and upscale ratio of a quality mode at a display size.
+    bool GetRenderResolution(uint32_t qualityMode, uint32_t displayWidth, uint32_t displayHeight, RenderResolution& resolution) const;
+    // Upscale ratio of a quality mode, without a render size.
+    bool GetUpscaleRatio(uint32_t qualityMode, float& ratio) const;
+
+    friend class FSRSubmission<FSR2>;
+
+private:
+    // The SDK as FSRSubmission sees it.
+    using ErrorCode = FfxErrorCode;
+    using GenReactiveDescription = FfxFsr2GenerateReactiveDescription;
+    using DispatchDescription = FfxFsr2DispatchDescription;
+    static constexpr FfxErrorCode ErrorOk = FFX_OK;
+    static constexpr FfxErrorCode ErrorFailed = !FFX_OK;
+
+    void SetupGenerateReactiveMask(FfxFsr2GenerateReactiveDescription& genReactiveDesc, const GenReactiveParam& genReactiveParam, void* commandList);
+    // reactive overrides dispatchParam.reactive with a resource that is already translated.
+    void SetupDispatch(FfxFsr2DispatchDescription& dispatchDesc, const DispatchParam& dispatchParam, void* commandList, const FfxResource* reactive = nullptr);
+    // Record a pass into the command list of its description, logging a failure.
+    FfxErrorCode RecordGenerateReactiveMask(const FfxFsr2GenerateReactiveDescription& genReactiveDesc);
+    FfxErrorCode RecordDispatch(const FfxFsr2DispatchDescription& dispatchDesc);
 
 private:
-    FfxFsr2Context m_Context;
+    std::shared_ptr<FfxFsr2Context> m_Context;
     bool m_ContextCreated = false;
-    std::vector<char> m_ScratchBuffer = {};
+    ContextInitTask m_InitTask;
+    FfxErrorCode m_InitError = FFX_OK;
+    std::shared_ptr<std::vector<char>> m_ScratchBuffer;
+    // The context and the scratch buffer are the host memory of an instance, the SDK allocates from the latter.
+    std::atomic<uint64_t> m_HostMemoryBytes = {0};
+    // Internal resources of the context as the backend created them, released with the context.
+    std::shared_ptr<GpuMemoryCharge> m_GpuMemory;
+    RenderSizeLimits m_RenderSizeLimits = {};
+    // Fed by every upscale with its frame time and the GPU time of the latest measured upscale in milliseconds,
+    // which stays 0 while GPU timestamps are off.
+    ResolutionGovernor m_Governor;
+    GpuTimerStats m_GpuTimers;
     bool m_Reset = true;
     uint64_t m_FenceValue = 0;
+    BatchDispatch<DispatchDescription> m_Batch;
 
     std::array<uint32_t, TextureName::MAX> m_TextureIDs = {};
 };
 
-FSR2& GetFSRInstance(uint32_t id);
+// Resolves every FFX entry point used by the plugin for the current device, see DllLoader.
+bool LoadFSRFunctions();
+
+// Creates the instance on first use. Returns nullptr for an ID outside the instance table.
+FSR2* GetFSRInstance(uint32_t id);
+// Returns nullptr unless the instance was used before, for callers that must not create one.
+FSR2* FindFSRInstance(uint32_t id);
+
+// Records the upscales of several instances into one command list with one submission. Instances still being
+// created are skipped, an instance listed more than once is upscaled once. An instance must not read what
+// another one in the same batch writes.
+FfxErrorCode DispatchFSRBatch(uint32_t count, const uint32_t* instanceIDs, const DispatchParam* dispatchParams);
+
+// Jitter sequence for the given widths, shared by all instances. Returns nullptr if it could not be queried.
+const JitterSequence* GetJitterSequence(int32_t renderWidth, int32_t displayWidth);
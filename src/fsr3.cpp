@@ -1,11 +1,15 @@
 #include "fsr3.h"
 
+#include <atomic>
 #include <memory>
-#include <unordered_map>
 
 #include "fsrunityplugin.h"
 #include "device.h"
+#include "instancetable.h"
+#include "trace.h"
+#if defined(FSR_BACKEND_ALL) || defined(FSR_BACKEND_NULL)
 #include "dllloader.h"
+#endif
 
 #if defined(FSR_BACKEND_DX12) || defined(FSR_BACKEND_ALL)
 #include "FidelityFX/host/backends/dx12/ffx_dx12.h"
@@ -17,128 +21,342 @@ FfxErrorCode GetInterface(void* device, void* scratchBuffer, size_t scratchBuffe
 FfxResource GetResource(void* resource, const wchar_t* name = nullptr, FfxResourceStates state = FFX_RESOURCE_STATE_COMPUTE_READ, uint32_t additionalUsages = 0);
 FfxResource GetResourceByID(UnityTextureID textureID, const wchar_t* name = nullptr, FfxResourceStates state = FFX_RESOURCE_STATE_COMPUTE_READ, uint32_t additionalUsages = 0);
 
-FSR3& GetFSRInstance(uint32_t id)
+static InstanceTable<FSR3>& GetInstanceTable()
 {
-    static std::unordered_map<uint32_t, std::unique_ptr<FSR3>> instances_map;
-    auto it = instances_map.find(id);
-    if (it == instances_map.end()) {
-        instances_map[id] = std::make_unique<FSR3>();
+    static InstanceTable<FSR3> instances;
+    return instances;
+}
+
+FSR3* GetFSRInstance(uint32_t id)
+{
+    FSR3* instance = GetInstanceTable().Get(id);
+    if (instance == nullptr) {
+        FSR_ERROR("Instance ID out of range");
+    }
+    return instance;
+}
+
+FSR3* FindFSRInstance(uint32_t id)
+{
+    return GetInstanceTable().Find(id);
+}
+
+static JitterCache s_JitterCache;
+
+const JitterSequence* GetJitterSequence(int32_t renderWidth, int32_t displayWidth)
+{
+    return s_JitterCache.Get(renderWidth, displayWidth, [](int32_t renderWidth, int32_t displayWidth, JitterSequence& sequence) {
+        int32_t jitterPhaseCount = ffxFsr3GetJitterPhaseCount(renderWidth, displayWidth);
+        if (jitterPhaseCount <= 0) {
+            FSR_ERROR("ffxFsr3GetJitterPhaseCount failed");
+            return false;
+        }
+        sequence.resize(jitterPhaseCount);
+        for (int32_t i = 0; i < jitterPhaseCount; ++i) {
+            if (ffxFsr3GetJitterOffset(&sequence[i][0], &sequence[i][1], i, jitterPhaseCount) != FFX_OK) {
+                FSR_ERROR("ffxFsr3GetJitterOffset failed");
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+// Internal resources created on this thread while it runs ffxFsr3ContextCreate, which is where the context
+// creates all of them. CreateTrackedResource adds to it in front of the backend.
+static thread_local GpuMemoryUsage* s_TrackedResourceMemory = nullptr;
+static std::atomic<decltype(FfxInterface::fpCreateResource)> s_BackendCreateResource = {nullptr};
+
+static uint32_t GetFormatSize(FfxSurfaceFormat format)
+{
+    switch (format) {
+    case FFX_SURFACE_FORMAT_R32G32B32A32_TYPELESS:
+    case FFX_SURFACE_FORMAT_R32G32B32A32_FLOAT:
+        return 16;
+    case FFX_SURFACE_FORMAT_R16G16B16A16_FLOAT:
+    case FFX_SURFACE_FORMAT_R32G32_FLOAT:
+        return 8;
+    case FFX_SURFACE_FORMAT_R16_FLOAT:
+    case FFX_SURFACE_FORMAT_R16_UINT:
+    case FFX_SURFACE_FORMAT_R16_UNORM:
+    case FFX_SURFACE_FORMAT_R16_SNORM:
+    case FFX_SURFACE_FORMAT_R8G8_UNORM:
+        return 2;
+    case FFX_SURFACE_FORMAT_R8_UNORM:
+    case FFX_SURFACE_FORMAT_R8_UINT:
+        return 1;
+    default:
+        return 4;
+    }
+}
+
+static FfxErrorCode CreateTrackedResource(FfxInterface* backendInterface, const FfxCreateResourceDescription* createResourceDescription, FfxUInt32 effectContextId, FfxResourceInternal* outResource)
+{
+    FfxErrorCode errorCode = s_BackendCreateResource.load(std::memory_order_relaxed)(backendInterface, createResourceDescription, effectContextId, outResource);
+    GpuMemoryUsage* usage = s_TrackedResourceMemory;
+    if (errorCode == FFX_OK && usage != nullptr) {
+        const FfxResourceDescription& desc = createResourceDescription->resourceDescription;
+        uint64_t bytes = desc.type == FFX_RESOURCE_TYPE_BUFFER ? desc.width :
+            GetTextureMemory(desc.width, desc.height, desc.depth, desc.mipCount, GetFormatSize(desc.format));
+        usage->totalBytes += bytes;
+        if ((desc.flags & FFX_RESOURCE_FLAGS_ALIASABLE) != 0) {
+            usage->aliasableBytes += bytes;
+        }
+    }
+    return errorCode;
+}
+
+static void TrackResourceMemory(FfxInterface& backendInterface)
+{
+    if (backendInterface.fpCreateResource != nullptr && backendInterface.fpCreateResource != CreateTrackedResource) {
+        s_BackendCreateResource.store(backendInterface.fpCreateResource, std::memory_order_relaxed);
+        backendInterface.fpCreateResource = CreateTrackedResource;
     }
-    return *instances_map[id];
 }
 
 FfxErrorCode FSR3::Init(const InitParam& initParam)
 {
+    FSR_TRACE_SCOPE("FSR3::Init");
+    s_JitterCache.ClearFailures();
     Destroy();
     m_Reset = true;
     FfxFsr3ContextDescription contextDesc{};
     contextDesc.flags = initParam.flags;
     contextDesc.flags |= FFX_FSR3_ENABLE_UPSCALING_ONLY;
-    contextDesc.maxRenderSize.width = initParam.displaySizeWidth;
-    contextDesc.maxRenderSize.height = initParam.displaySizeHeight;
+    m_RenderSizeLimits = GetRenderSizeLimits(initParam.displaySizeWidth, initParam.displaySizeHeight,
+        initParam.maxRenderSizeWidth, initParam.maxRenderSizeHeight, initParam.maxUpscaleRatio);
+    m_Governor.SetLimits(m_RenderSizeLimits);
+    m_GpuTimers.Reset();
+    contextDesc.maxRenderSize.width = m_RenderSizeLimits.maxWidth;
+    contextDesc.maxRenderSize.height = m_RenderSizeLimits.maxHeight;
     contextDesc.upscaleOutputSize.width = initParam.displaySizeWidth;
     contextDesc.upscaleOutputSize.height = initParam.displaySizeHeight;
     contextDesc.displaySize.width = initParam.displaySizeWidth;
     contextDesc.displaySize.height = initParam.displaySizeHeight;
-    m_ScratchBuffer.resize(GetScratchMemorySize(FFX_FSR3_CONTEXT_COUNT));
-    GetInterface(Device::Instance().GetNativeDevice(), m_ScratchBuffer.data(), m_ScratchBuffer.size(), &(contextDesc.backendInterfaceUpscaling), FFX_FSR3_CONTEXT_COUNT);
-
-    const auto errorCode = ffxFsr3ContextCreate(&m_Context, &contextDesc);
-    if (errorCode == FFX_OK) {
-        m_ContextCreated = true;
-    } else {
-        FSR_ERROR("FFXFSR3 Init failed");
+    std::shared_ptr<GpuMemoryCharge> gpuMemory = GpuMemoryBudget::Instance().Charge(EstimateUpscalerMemory(contextDesc.maxRenderSize.width,
+        contextDesc.maxRenderSize.height, contextDesc.upscaleOutputSize.width, contextDesc.upscaleOutputSize.height));
+    if (gpuMemory == nullptr) {
+        return FFX_ERROR_OUT_OF_MEMORY;
     }
-    return errorCode;
+    std::atomic_store(&m_GpuMemory, gpuMemory);
+    // The creating thread only uses what it captures, commit() hands the context to the instance.
+    std::shared_ptr<FfxFsr3Context> context(new FfxFsr3Context{});
+    std::shared_ptr<std::vector<char>> scratchBuffer(new std::vector<char>(GetScratchMemorySize(FFX_FSR3_CONTEXT_COUNT)));
+    m_HostMemoryBytes.store(sizeof(*context) + scratchBuffer->size(), std::memory_order_relaxed);
+    GetInterface(Device::Instance().GetNativeDevice(), scratchBuffer->data(), scratchBuffer->size(), &(contextDesc.backendInterfaceUpscaling), FFX_FSR3_CONTEXT_COUNT);
+    TrackResourceMemory(contextDesc.backendInterfaceUpscaling);
+
+    std::shared_ptr<FfxErrorCode> error = std::make_shared<FfxErrorCode>(FFX_OK);
+    m_InitTask.Start([contextDesc, context, scratchBuffer, gpuMemory, error]() {
+        FSR_TRACE_SCOPE("ffxFsr3ContextCreate");
+        GpuMemoryUsage resourceMemory = {};
+        s_TrackedResourceMemory = &resourceMemory;
+        *error = ffxFsr3ContextCreate(context.get(), &contextDesc);
+        s_TrackedResourceMemory = nullptr;
+        if (*error != FFX_OK) {
+            FSR_ERROR("FFXFSR3 Init failed");
+            return false;
+        }
+        if (resourceMemory.totalBytes != 0) {
+            gpuMemory->Update(resourceMemory);
+        }
+        return true;
+    }, [this, context, scratchBuffer, error](bool created) {
+        m_InitError = *error;
+        if (created) {
+            m_Context = context;
+            m_ScratchBuffer = scratchBuffer;
+            m_ContextCreated = true;
+        } else {
+            std::atomic_store(&m_GpuMemory, std::shared_ptr<GpuMemoryCharge>());
+            m_HostMemoryBytes.store(0, std::memory_order_relaxed);
+        }
+    }, [context, scratchBuffer, gpuMemory]() {
+        // Superseded before its first dispatch, so nothing on the GPU refers to it.
+        Device::Instance().DeferRelease(0, [context, scratchBuffer, gpuMemory]() mutable {
+            ffxFsr3ContextDestroy(context.get());
+            gpuMemory.reset();
+        });
+    }, FSRUnityPlugin::AsyncInit.load(std::memory_order_relaxed));
+    return m_InitTask.IsPending() ? static_cast<FfxErrorCode>(FSRUnityPlugin::ReturnNotReady) : m_InitError;
 }
 
 void FSR3::Destroy()
 {
+    m_InitTask.Reset();
     if (m_ContextCreated) {
-        Device::Instance().Wait(m_FenceValue);
-        ffxFsr3ContextDestroy(&m_Context);
+        // The GPU may still be using the context, it is destroyed with its scratch memory once the last
+        // submission has completed.
+        std::shared_ptr<FfxFsr3Context> context = std::move(m_Context);
+        std::shared_ptr<std::vector<char>> scratchBuffer = std::move(m_ScratchBuffer);
+        std::shared_ptr<GpuMemoryCharge> gpuMemory = std::atomic_exchange(&m_GpuMemory, std::shared_ptr<GpuMemoryCharge>());
+        Device::Instance().DeferRelease(m_FenceValue, [context, scratchBuffer, gpuMemory]() mutable {
+            ffxFsr3ContextDestroy(context.get());
+            gpuMemory.reset();
+        });
         m_ContextCreated = false;
     }
-}
-
-std::array<float, 2> FSR3::GetJitterOffset(const int32_t index, const int32_t renderWidth, const int32_t displayWidth)
-{
-    std::array<float, 2> jitterOffset{};
-    ffxFsr3GetJitterOffset(&(jitterOffset[0]), &(jitterOffset[1]), index, ffxFsr3GetJitterPhaseCount(renderWidth, displayWidth));
-    return jitterOffset;
+    m_HostMemoryBytes.store(0, std::memory_order_relaxed);
+    std::atomic_store(&m_GpuMemory, std::shared_ptr<GpuMemoryCharge>());
 }
 
 FfxErrorCode FSR3::GenerateReactiveMask(const GenReactiveParam& genReactiveParam)
 {
-    if (m_ContextCreated) {
+    FSR_TRACE_SCOPE("FSR3::GenerateReactiveMask");
+    if (m_InitTask.IsReady()) {
+        m_GpuTimers.Collect();
         FfxCommandList commandList = Device::Instance().GetNativeCommandList();
         FfxFsr3GenerateReactiveDescription genReactiveDesc{};
-        genReactiveDesc.commandList = commandList;
-        genReactiveDesc.colorOpaqueOnly = GetResource(genReactiveParam.colorOpaqueOnly);
-        //genReactiveDesc.colorOpaqueOnly = GetResourceByID(m_TextureIDs[TextureName::COLOR_OPAQUE_ONLY]);
-        genReactiveDesc.colorPreUpscale = GetResource(genReactiveParam.colorPreUpscale);
-        //genReactiveDesc.colorPreUpscale = GetResourceByID(m_TextureIDs[TextureName::COLOR_PRE_UPSCALE]);
-        genReactiveDesc.outReactive = GetResource(genReactiveParam.outReactive, L"FSR3_InputReactiveMap", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
-        //genReactiveDesc.outReactive = GetResourceByID(m_TextureIDs[TextureName::REACTIVE], L"FSR3_InputReactiveMap", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
-        genReactiveDesc.renderSize.width = genReactiveParam.renderSizeWidth;
-        genReactiveDesc.renderSize.height = genReactiveParam.renderSizeHeight;
-        genReactiveDesc.scale = genReactiveParam.scale;
-        genReactiveDesc.cutoffThreshold = genReactiveParam.cutoffThreshold;
-        genReactiveDesc.binaryValue = genReactiveParam.binaryValue;
-        genReactiveDesc.flags = genReactiveParam.flags;
-        const auto errorCode = ffxFsr3ContextGenerateReactiveMask(&m_Context, &genReactiveDesc);
-        if (errorCode != FFX_OK) {
-            FSR_ERROR("FFXFSR3 GenerateReactiveMask failed");
-        }
+        SetupGenerateReactiveMask(genReactiveDesc, genReactiveParam, commandList);
+        uint64_t timer = Device::Instance().BeginGpuTimer(commandList);
+        const auto errorCode = RecordGenerateReactiveMask(genReactiveDesc);
+        Device::Instance().EndGpuTimer(commandList, timer);
         m_FenceValue = Device::Instance().ExecuteCommandList(commandList);
+        m_GpuTimers.Submit(GPU_TIMER_REACTIVE_MASK, timer, m_FenceValue);
         return errorCode;
+    } else if (m_InitTask.IsPending()) {
+        return static_cast<FfxErrorCode>(FSRUnityPlugin::ReturnNotReady);
     } else
         return !FFX_OK;
 }
 
 FfxErrorCode FSR3::Dispatch(const DispatchParam& dispatchParam)
 {
-    if (m_ContextCreated) {
+    FSR_TRACE_SCOPE("FSR3::Dispatch");
+    if (m_InitTask.IsReady()) {
+        m_GpuTimers.Collect();
         FfxCommandList commandList = Device::Instance().GetNativeCommandList();
         FfxFsr3DispatchUpscaleDescription dispatchDesc{};
-        dispatchDesc.commandList = commandList;
-        dispatchDesc.color = GetResource(dispatchParam.color, L"FSR3_InputColor");
-        //dispatchDesc.color = GetResourceByID(m_TextureIDs[TextureName::COLOR], L"FSR3_InputColor");
-        dispatchDesc.depth = GetResource(dispatchParam.depth, L"FSR3_InputDepth");
-        //dispatchDesc.depth = GetResourceByID(m_TextureIDs[TextureName::DEPTH], L"FSR3_InputDepth");
-        dispatchDesc.motionVectors = GetResource(dispatchParam.motionVectors, L"FSR3_InputMotionVectors");
-        //dispatchDesc.motionVectors = GetResourceByID(m_TextureIDs[TextureName::MOTION_VECTORS], L"FSR3_InputMotionVectors");
-        dispatchDesc.reactive = GetResource(dispatchParam.reactive, L"FSR3_InputReactiveMap");
-        //dispatchDesc.reactive = GetResourceByID(m_TextureIDs[TextureName::REACTIVE], L"FSR3_InputReactiveMap");
-        dispatchDesc.transparencyAndComposition = GetResource(dispatchParam.transparencyAndComposition, L"FSR3_TransparencyAndCompositionMap");
-        //dispatchDesc.transparencyAndComposition = GetResourceByID(m_TextureIDs[TextureName::TRANSPARENT_AND_COMPOSITION], L"FSR3_TransparencyAndCompositionMap");
-        dispatchDesc.upscaleOutput = GetResource(dispatchParam.output, L"FSR3_OutputUpscaledColor", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
-        //dispatchDesc.upscaleOutput = GetResourceByID(m_TextureIDs[TextureName::OUTPUT], L"FSR3_OutputUpscaledColor", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
-        dispatchDesc.jitterOffset.x = dispatchParam.jitterOffsetX;
-        dispatchDesc.jitterOffset.y = dispatchParam.jitterOffsetY;
-        dispatchDesc.motionVectorScale.x = dispatchParam.motionVectorScaleX;
-        dispatchDesc.motionVectorScale.y = dispatchParam.motionVectorScaleY;
-        dispatchDesc.renderSize.width = dispatchParam.renderSizeWidth;
-        dispatchDesc.renderSize.height = dispatchParam.renderSizeHeight;
-        dispatchDesc.enableSharpening = dispatchParam.enableSharpening;
-        dispatchDesc.sharpness = dispatchParam.sharpness;
-        dispatchDesc.frameTimeDelta = dispatchParam.frameTimeDelta;
-        dispatchDesc.preExposure = dispatchParam.preExposure;
-        dispatchDesc.reset = m_Reset;
-        dispatchDesc.cameraNear = dispatchParam.cameraNear;
-        dispatchDesc.cameraFar = dispatchParam.cameraFar;
-        dispatchDesc.cameraFovAngleVertical = dispatchParam.cameraFovAngleVertical;
+        SetupDispatch(dispatchDesc, dispatchParam, commandList);
         m_Reset = false;
-        const auto errorCode = ffxFsr3ContextDispatchUpscale(&m_Context, &dispatchDesc);
-        if (errorCode != FFX_OK) {
-            FSR_ERROR("FFXFSR3 Dispatch failed");
-        }
+        uint64_t timer = Device::Instance().BeginGpuTimer(commandList);
+        const auto errorCode = RecordDispatch(dispatchDesc);
+        Device::Instance().EndGpuTimer(commandList, timer);
         m_FenceValue = Device::Instance().ExecuteCommandList(commandList);
+        m_GpuTimers.Submit(GPU_TIMER_UPSCALE, timer, m_FenceValue);
         return errorCode;
+    } else if (m_InitTask.IsPending()) {
+        return static_cast<FfxErrorCode>(FSRUnityPlugin::ReturnNotReady);
     } else
         return !FFX_OK;
 }
 
+FfxErrorCode FSR3::GenerateReactiveMaskAndDispatch(const ReactiveDispatchParam& reactiveDispatchParam)
+{
+    FSR_TRACE_SCOPE("FSR3::GenerateReactiveMaskAndDispatch");
+    return FSRSubmission<FSR3>::GenerateReactiveMaskAndDispatch(*this, reactiveDispatchParam);
+}
+
+FfxErrorCode FSR3::RecordGenerateReactiveMask(const FfxFsr3GenerateReactiveDescription& genReactiveDesc)
+{
+    FfxErrorCode errorCode = ffxFsr3ContextGenerateReactiveMask(m_Context.get(), &genReactiveDesc);
+    if (errorCode != FFX_OK) {
+        FSR_ERROR("FFXFSR3 GenerateReactiveMask failed");
+    }
+    return errorCode;
+}
+
+FfxErrorCode FSR3::RecordDispatch(const FfxFsr3DispatchUpscaleDescription& dispatchDesc)
+{
+    FfxErrorCode errorCode = ffxFsr3ContextDispatchUpscale(m_Context.get(), &dispatchDesc);
+    if (errorCode != FFX_OK) {
+        FSR_ERROR("FFXFSR3 Dispatch failed");
+    }
+    return errorCode;
+}
+
+void FSR3::SetupGenerateReactiveMask(FfxFsr3GenerateReactiveDescription& genReactiveDesc, const GenReactiveParam& genReactiveParam, void* commandList)
+{
+    genReactiveDesc.commandList = commandList;
+    genReactiveDesc.colorOpaqueOnly = GetResource(genReactiveParam.colorOpaqueOnly);
+    //genReactiveDesc.colorOpaqueOnly = GetResourceByID(m_TextureIDs[TextureName::COLOR_OPAQUE_ONLY]);
+    genReactiveDesc.colorPreUpscale = GetResource(genReactiveParam.colorPreUpscale);
+    //genReactiveDesc.colorPreUpscale = GetResourceByID(m_TextureIDs[TextureName::COLOR_PRE_UPSCALE]);
+    genReactiveDesc.outReactive = GetResource(genReactiveParam.outReactive, L"FSR3_InputReactiveMap", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
+    //genReactiveDesc.outReactive = GetResourceByID(m_TextureIDs[TextureName::REACTIVE], L"FSR3_InputReactiveMap", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
+    genReactiveDesc.renderSize.width = genReactiveParam.renderSizeWidth;
+    genReactiveDesc.renderSize.height = genReactiveParam.renderSizeHeight;
+    genReactiveDesc.scale = genReactiveParam.scale;
+    genReactiveDesc.cutoffThreshold = genReactiveParam.cutoffThreshold;
+    genReactiveDesc.binaryValue = genReactiveParam.binaryValue;
+    genReactiveDesc.flags = genReactiveParam.flags;
+}
+
+void FSR3::SetupDispatch(FfxFsr3DispatchUpscaleDescription& dispatchDesc, const DispatchParam& dispatchParam, void* commandList, const FfxResource* reactive)
+{
+    dispatchDesc.commandList = commandList;
+    dispatchDesc.color = GetResource(dispatchParam.color, L"FSR3_InputColor");
+    //dispatchDesc.color = GetResourceByID(m_TextureIDs[TextureName::COLOR], L"FSR3_InputColor");
+    dispatchDesc.depth = GetResource(dispatchParam.depth, L"FSR3_InputDepth");
+    //dispatchDesc.depth = GetResourceByID(m_TextureIDs[TextureName::DEPTH], L"FSR3_InputDepth");
+    dispatchDesc.motionVectors = GetResource(dispatchParam.motionVectors, L"FSR3_InputMotionVectors");
+    //dispatchDesc.motionVectors = GetResourceByID(m_TextureIDs[TextureName::MOTION_VECTORS], L"FSR3_InputMotionVectors");
+    dispatchDesc.reactive = reactive != nullptr ? *reactive : GetResource(dispatchParam.reactive, L"FSR3_InputReactiveMap");
+    //dispatchDesc.reactive = GetResourceByID(m_TextureIDs[TextureName::REACTIVE], L"FSR3_InputReactiveMap");
+    dispatchDesc.transparencyAndComposition = GetResource(dispatchParam.transparencyAndComposition, L"FSR3_TransparencyAndCompositionMap");
+    //dispatchDesc.transparencyAndComposition = GetResourceByID(m_TextureIDs[TextureName::TRANSPARENT_AND_COMPOSITION], L"FSR3_TransparencyAndCompositionMap");
+    dispatchDesc.upscaleOutput = GetResource(dispatchParam.output, L"FSR3_OutputUpscaledColor", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
+    //dispatchDesc.upscaleOutput = GetResourceByID(m_TextureIDs[TextureName::OUTPUT], L"FSR3_OutputUpscaledColor", FFX_RESOURCE_STATE_UNORDERED_ACCESS);
+    dispatchDesc.jitterOffset.x = dispatchParam.jitterOffsetX;
+    dispatchDesc.jitterOffset.y = dispatchParam.jitterOffsetY;
+    dispatchDesc.motionVectorScale.x = dispatchParam.motionVectorScaleX;
+    dispatchDesc.motionVectorScale.y = dispatchParam.motionVectorScaleY;
+    dispatchDesc.renderSize.width = dispatchParam.renderSizeWidth;
+    dispatchDesc.renderSize.height = dispatchParam.renderSizeHeight;
+    ClampRenderSize(m_RenderSizeLimits, dispatchDesc.renderSize.width, dispatchDesc.renderSize.height);
+    m_Governor.Update(dispatchParam.frameTimeDelta, m_GpuTimers.GetLastUpscaleTime());
+    dispatchDesc.enableSharpening = dispatchParam.enableSharpening;
+    dispatchDesc.sharpness = dispatchParam.sharpness;
+    dispatchDesc.frameTimeDelta = dispatchParam.frameTimeDelta;
+    dispatchDesc.preExposure = dispatchParam.preExposure;
+    dispatchDesc.reset = m_Reset;
+    dispatchDesc.cameraNear = dispatchParam.cameraNear;
+    dispatchDesc.cameraFar = dispatchParam.cameraFar;
+    dispatchDesc.cameraFovAngleVertical = dispatchParam.cameraFovAngleVertical;
+}
+
+FfxErrorCode DispatchFSRBatch(uint32_t count, const uint32_t* instanceIDs, const DispatchParam* dispatchParams)
+{
+    FSR_TRACE_SCOPE("DispatchFSRBatch");
+    return FSRSubmission<FSR3>::DispatchBatch(count, instanceIDs, dispatchParams, &FindFSRInstance);
+}
+
+HostArenaCounters FSR3::GetHostMemoryUsage() const
+{
+    uint64_t bytes = m_HostMemoryBytes.load(std::memory_order_relaxed);
+    uint64_t allocations = bytes != 0 ? 2 : 0;
+    return HostArenaCounters{bytes, bytes, bytes, allocations, allocations};
+}
+
+GpuMemoryUsage FSR3::GetGpuMemoryUsage() const
+{
+    std::shared_ptr<GpuMemoryCharge> gpuMemory = std::atomic_load(&m_GpuMemory);
+    return gpuMemory != nullptr ? gpuMemory->GetUsage() : GpuMemoryUsage{};
+}
+
+GovernorResult FSR3::GetGovernedRenderSize() const
+{
+    GovernorResult result = {};
+    m_Governor.GetRenderSize(result.renderSizeWidth, result.renderSizeHeight);
+    const JitterSequence* sequence = GetJitterSequence(static_cast<int32_t>(result.renderSizeWidth), static_cast<int32_t>(m_RenderSizeLimits.displayWidth));
+    result.jitterPhaseCount = sequence != nullptr ? static_cast<int32_t>(sequence->size()) : 0;
+    return result;
+}
+
+bool FSR3::GetRenderResolution(uint32_t qualityMode, uint32_t displayWidth, uint32_t displayHeight, RenderResolution& resolution) const
+{
+    static RenderResolutionCache cache;
+    return cache.Get(qualityMode, displayWidth, displayHeight, 0, resolution, [&](RenderResolution& resolved) {
+        return GetQualityModeRenderResolution(qualityMode, displayWidth, displayHeight, resolved);
+    });
+}
+
+bool FSR3::GetUpscaleRatio(uint32_t qualityMode, float& ratio) const
+{
+    ratio = GetQualityModeUpscaleRatio(qualityMode);
+    return ratio != 0.0f;
+}
+
 void FSR3::SetTextureID(const TextureName textureName, const UnityTextureID textureID)
 {
     if (textureName > TextureName::INVALID && textureName < TextureName::MAX) {
@@ -153,6 +371,10 @@ size_t GetScratchMemorySize(size_t maxContexts)
 #if defined(FSR_BACKEND_DX12) || defined(FSR_BACKEND_ALL)
     case kUnityGfxRendererD3D12:
         return ffxGetScratchMemorySizeDX12(maxContexts);
+#endif
+#if defined(FSR_BACKEND_NULL)
+    case kUnityGfxRendererNull:
+        return 0;
 #endif
     default:
         FSR_ERROR("Unsupported fsr3 backend");
@@ -167,6 +389,10 @@ FfxErrorCode GetInterface(void* device, void* scratchBuffer, size_t scratchBuffe
 #if defined(FSR_BACKEND_DX12) || defined(FSR_BACKEND_ALL)
     case kUnityGfxRendererD3D12:
         return ffxGetInterfaceDX12(ffxInterface, static_cast<ID3D12Device*>(device), scratchBuffer, scratchBuffersize, maxContexts);
+#endif
+#if defined(FSR_BACKEND_NULL)
+    case kUnityGfxRendererNull:
+        return FFX_OK;
 #endif
     default:
         FSR_ERROR("Unsupported fsr3 backend");
@@ -176,6 +402,7 @@ FfxErrorCode GetInterface(void* device, void* scratchBuffer, size_t scratchBuffe
 
 FfxResource GetResource(void* resource, const wchar_t* name, FfxResourceStates state, uint32_t additionalUsages)
 {
+    FSR_TRACE_SCOPE("GetResource");
     UnityGfxRenderer renderer = Device::Instance().GetDeviceType();
     switch (renderer) {
 #if defined(FSR_BACKEND_DX12) || defined(FSR_BACKEND_ALL)
@@ -202,6 +429,15 @@ FfxResource GetResource(void* resource, const wchar_t* name, FfxResourceStates s
         res.description.usage = (FfxResourceUsage)(res.description.usage | additionalUsages);
         return res;
     }
+#endif
+#if defined(FSR_BACKEND_NULL)
+    case kUnityGfxRendererNull:
+    {
+        FfxResource res{};
+        res.resource = Device::Instance().GetNativeResource(resource);
+        res.state = state;
+        return res;
+    }
 #endif
     default:
         FSR_ERROR("Unsupported fsr3 backend");
@@ -211,6 +447,7 @@ FfxResource GetResource(void* resource, const wchar_t* name, FfxResourceStates s
 
 FfxResource GetResourceByID(UnityTextureID textureID, const wchar_t* name, FfxResourceStates state, uint32_t additionalUsages)
 {
+    FSR_TRACE_SCOPE("GetResourceByID");
     UnityGfxRenderer renderer = Device::Instance().GetDeviceType();
     switch (renderer) {
 #if defined(FSR_BACKEND_DX12) || defined(FSR_BACKEND_ALL)
@@ -237,6 +474,15 @@ FfxResource GetResourceByID(UnityTextureID textureID, const wchar_t* name, FfxRe
         res.description.usage = (FfxResourceUsage)(res.description.usage | additionalUsages);
         return res;
     }
+#endif
+#if defined(FSR_BACKEND_NULL)
+    case kUnityGfxRendererNull:
+    {
+        FfxResource res{};
+        res.resource = Device::Instance().GetNativeResourceByID(textureID);
+        res.state = state;
+        return res;
+    }
 #endif
     default:
         FSR_ERROR("Unsupported fsr3 backend");
@@ -271,72 +517,141 @@ inline std::wstring GetDllNameBackend()
 }
 
 typedef size_t(*PfnFfxGetScratchMemorySizeDX12)(size_t maxContexts);
+typedef FfxErrorCode(*PfnFfxGetInterfaceDX12)(FfxInterface* backendInterface, FfxDevice device, void* scratchBuffer, size_t scratchBufferSize, uint32_t maxContexts);
+typedef FfxResource(*PfnFfxGetResourceDX12)(const ID3D12Resource* dx12Resource, FfxResourceDescription ffxResDescription, wchar_t* ffxResName, FfxResourceStates state);
+typedef FfxResourceDescription(*PfnGetFfxResourceDescriptionDX12)(ID3D12Resource* pResource);
+typedef FfxErrorCode(*PfnFfxFsr3ContextCreate)(FfxFsr3Context* context, FfxFsr3ContextDescription* contextDescription);
+typedef FfxErrorCode(*PfnFfxFsr3ContextDestroy)(FfxFsr3Context* context);
+typedef FfxErrorCode(*PfnFfxFsr3GetJitterOffset)(float* outX, float* outY, int32_t index, int32_t phaseCount);
+typedef int32_t(*PfnFfxFsr3GetJitterPhaseCount)(int32_t renderWidth, int32_t displayWidth);
+typedef FfxErrorCode(*PfnFfxFsr3ContextGenerateReactiveMask)(FfxFsr3Context* context, const FfxFsr3GenerateReactiveDescription* params);
+typedef FfxErrorCode(*PfnFfxFsr3ContextDispatchUpscale)(FfxFsr3Context* context, const FfxFsr3DispatchUpscaleDescription* dispatchParams);
+
+struct Fsr3Functions
+{
+    PfnFfxGetScratchMemorySizeDX12 ffxGetScratchMemorySizeDX12;
+    PfnFfxGetInterfaceDX12 ffxGetInterfaceDX12;
+    PfnFfxGetResourceDX12 ffxGetResourceDX12;
+    PfnGetFfxResourceDescriptionDX12 GetFfxResourceDescriptionDX12;
+    PfnFfxFsr3ContextCreate ffxFsr3ContextCreate;
+    PfnFfxFsr3ContextDestroy ffxFsr3ContextDestroy;
+    PfnFfxFsr3GetJitterOffset ffxFsr3GetJitterOffset;
+    PfnFfxFsr3GetJitterPhaseCount ffxFsr3GetJitterPhaseCount;
+    PfnFfxFsr3ContextGenerateReactiveMask ffxFsr3ContextGenerateReactiveMask;
+    PfnFfxFsr3ContextDispatchUpscale ffxFsr3ContextDispatchUpscale;
+};
+
+static DllFunctionTable<Fsr3Functions> s_Fsr3;
+
+inline const Fsr3Functions* GetFsr3Functions()
+{
+    return s_Fsr3.Get();
+}
+
+bool LoadFSRFunctions()
+{
+    FSR_TRACE_SCOPE("LoadFSRFunctions");
+    static UnityGfxRenderer loadedRenderer = kUnityGfxRendererNull;
+    UnityGfxRenderer renderer = Device::Instance().GetDeviceType();
+    if (s_Fsr3.IsPublished() && loadedRenderer == renderer) {
+        return true;
+    }
+    s_Fsr3.Invalidate();
+
+    DllLoader& dll = DllLoader::Instance(GetDllName().c_str());
+    DllLoader& dllBackend = DllLoader::Instance(GetDllNameBackend().c_str());
+    if (!dll.IsLoaded() || !dllBackend.IsLoaded()) {
+        return s_Fsr3.Fail();
+    }
+    Fsr3Functions functions = {};
+    bool resolved = true;
+    resolved &= dll.Resolve("ffxFsr3ContextCreate", functions.ffxFsr3ContextCreate);
+    resolved &= dll.Resolve("ffxFsr3ContextDestroy", functions.ffxFsr3ContextDestroy);
+    resolved &= dll.Resolve("ffxFsr3GetJitterOffset", functions.ffxFsr3GetJitterOffset);
+    resolved &= dll.Resolve("ffxFsr3GetJitterPhaseCount", functions.ffxFsr3GetJitterPhaseCount);
+    resolved &= dll.Resolve("ffxFsr3ContextGenerateReactiveMask", functions.ffxFsr3ContextGenerateReactiveMask);
+    resolved &= dll.Resolve("ffxFsr3ContextDispatchUpscale", functions.ffxFsr3ContextDispatchUpscale);
+    if (renderer == kUnityGfxRendererD3D12) {
+        resolved &= dllBackend.Resolve("ffxGetScratchMemorySizeDX12", functions.ffxGetScratchMemorySizeDX12);
+        resolved &= dllBackend.Resolve("ffxGetInterfaceDX12", functions.ffxGetInterfaceDX12);
+        resolved &= dllBackend.Resolve("ffxGetResourceDX12", functions.ffxGetResourceDX12);
+        resolved &= dllBackend.Resolve("GetFfxResourceDescriptionDX12", functions.GetFfxResourceDescriptionDX12);
+    }
+    if (!resolved) {
+        return s_Fsr3.Fail();
+    }
+    loadedRenderer = renderer;
+    return s_Fsr3.Publish(functions);
+}
+
 size_t ffxGetScratchMemorySizeDX12(size_t maxContexts)
 {
-    static PfnFfxGetScratchMemorySizeDX12 getScratchMemorySizeDX12 = reinterpret_cast<PfnFfxGetScratchMemorySizeDX12>(DllLoader::Instance(GetDllNameBackend().c_str()).GetProcAddress("ffxGetScratchMemorySizeDX12"));
-    return getScratchMemorySizeDX12(maxContexts);
+    const Fsr3Functions* functions = GetFsr3Functions();
+    return functions != nullptr ? functions->ffxGetScratchMemorySizeDX12(maxContexts) : 0;
 }
 
-typedef FfxErrorCode(*PfnFfxGetInterfaceDX12)(FfxInterface* backendInterface, FfxDevice device, void* scratchBuffer, size_t scratchBufferSize, uint32_t maxContexts);
 FfxErrorCode ffxGetInterfaceDX12(FfxInterface* backendInterface, FfxDevice device, void* scratchBuffer, size_t scratchBufferSize, uint32_t maxContexts)
 {
-    static PfnFfxGetInterfaceDX12 getInterfaceDX12 = reinterpret_cast<PfnFfxGetInterfaceDX12>(DllLoader::Instance(GetDllNameBackend().c_str()).GetProcAddress("ffxGetInterfaceDX12"));
-    return getInterfaceDX12(backendInterface, device, scratchBuffer, scratchBufferSize, maxContexts);
+    const Fsr3Functions* functions = GetFsr3Functions();
+    return functions != nullptr ? functions->ffxGetInterfaceDX12(backendInterface, device, scratchBuffer, scratchBufferSize, maxContexts) : FFX_ERROR_INCOMPLETE_INTERFACE;
 }
 
-typedef FfxResource(*PfnFfxGetResourceDX12)(const ID3D12Resource* dx12Resource, FfxResourceDescription ffxResDescription, wchar_t* ffxResName, FfxResourceStates state);
 FfxResource ffxGetResourceDX12(const ID3D12Resource* dx12Resource, FfxResourceDescription ffxResDescription, wchar_t* ffxResName, FfxResourceStates state)
 {
-    static PfnFfxGetResourceDX12 getResourceDX12 = reinterpret_cast<PfnFfxGetResourceDX12>(DllLoader::Instance(GetDllNameBackend().c_str()).GetProcAddress("ffxGetResourceDX12"));
-    return getResourceDX12(dx12Resource, ffxResDescription, ffxResName, state);
+    const Fsr3Functions* functions = GetFsr3Functions();
+    return functions != nullptr ? functions->ffxGetResourceDX12(dx12Resource, ffxResDescription, ffxResName, state) : FfxResource{};
 }
 
-typedef FfxResourceDescription(*PfnGetFfxResourceDescriptionDX12)(ID3D12Resource* pResource);
 FfxResourceDescription GetFfxResourceDescriptionDX12(ID3D12Resource* pResource)
 {
-    static PfnGetFfxResourceDescriptionDX12 getFfxResourceDescriptionDX12 = reinterpret_cast<PfnGetFfxResourceDescriptionDX12>(DllLoader::Instance(GetDllNameBackend().c_str()).GetProcAddress("GetFfxResourceDescriptionDX12"));
-    return getFfxResourceDescriptionDX12(pResource);
+    const Fsr3Functions* functions = GetFsr3Functions();
+    return functions != nullptr ? functions->GetFfxResourceDescriptionDX12(pResource) : FfxResourceDescription{};
 }
 
-typedef FfxErrorCode(*PfnFfxFsr3ContextCreate)(FfxFsr3Context* context, FfxFsr3ContextDescription* contextDescription);
 FfxErrorCode ffxFsr3ContextCreate(FfxFsr3Context* context, FfxFsr3ContextDescription* contextDescription)
 {
-    static PfnFfxFsr3ContextCreate fsr3ContextCreate = reinterpret_cast<PfnFfxFsr3ContextCreate>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr3ContextCreate"));
-    return fsr3ContextCreate(context, contextDescription);
+    const Fsr3Functions* functions = GetFsr3Functions();
+    return functions != nullptr ? functions->ffxFsr3ContextCreate(context, contextDescription) : FFX_ERROR_INCOMPLETE_INTERFACE;
 }
 
-typedef FfxErrorCode(*PfnFfxFsr3ContextDestroy)(FfxFsr3Context* context);
 FfxErrorCode ffxFsr3ContextDestroy(FfxFsr3Context* context)
 {
-    static PfnFfxFsr3ContextDestroy fsr3ContextDestroy = reinterpret_cast<PfnFfxFsr3ContextDestroy>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr3ContextDestroy"));
-    return fsr3ContextDestroy(context);
+    const Fsr3Functions* functions = GetFsr3Functions();
+    return functions != nullptr ? functions->ffxFsr3ContextDestroy(context) : FFX_ERROR_INCOMPLETE_INTERFACE;
 }
 
-typedef FfxErrorCode(*PfnFfxFsr3GetJitterOffset)(float* outX, float* outY, int32_t index, int32_t phaseCount);
 FfxErrorCode ffxFsr3GetJitterOffset(float* outX, float* outY, int32_t index, int32_t phaseCount)
 {
-    static PfnFfxFsr3GetJitterOffset fsr3GetJitterOffset = reinterpret_cast<PfnFfxFsr3GetJitterOffset>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr3GetJitterOffset"));
-    return fsr3GetJitterOffset(outX, outY, index, phaseCount);
+    const Fsr3Functions* functions = GetFsr3Functions();
+    return functions != nullptr ? functions->ffxFsr3GetJitterOffset(outX, outY, index, phaseCount) : FFX_ERROR_INCOMPLETE_INTERFACE;
 }
 
-typedef int32_t(*PfnFfxFsr3GetJitterPhaseCount)(int32_t renderWidth, int32_t displayWidth);
 int32_t ffxFsr3GetJitterPhaseCount(int32_t renderWidth, int32_t displayWidth)
 {
-    static PfnFfxFsr3GetJitterPhaseCount fsr3GetJitterPhaseCount = reinterpret_cast<PfnFfxFsr3GetJitterPhaseCount>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr3GetJitterPhaseCount"));
-    return fsr3GetJitterPhaseCount(renderWidth, displayWidth);
+    const Fsr3Functions* functions = GetFsr3Functions();
+    return functions != nullptr ? functions->ffxFsr3GetJitterPhaseCount(renderWidth, displayWidth) : 0;
 }
 
-typedef FfxErrorCode(*PfnFfxFsr3ContextGenerateReactiveMask)(FfxFsr3Context* context, const FfxFsr3GenerateReactiveDescription* params);
 FfxErrorCode ffxFsr3ContextGenerateReactiveMask(FfxFsr3Context* context, const FfxFsr3GenerateReactiveDescription* params)
 {
-    static PfnFfxFsr3ContextGenerateReactiveMask fsr3ContextGenerateReactiveMask = reinterpret_cast<PfnFfxFsr3ContextGenerateReactiveMask>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr3ContextGenerateReactiveMask"));
-    return fsr3ContextGenerateReactiveMask(context, params);
+    const Fsr3Functions* functions = GetFsr3Functions();
+    return functions != nullptr ? functions->ffxFsr3ContextGenerateReactiveMask(context, params) : FFX_ERROR_INCOMPLETE_INTERFACE;
 }
 
-typedef FfxErrorCode(*PfnFfxFsr3ContextDispatchUpscale)(FfxFsr3Context* context, const FfxFsr3DispatchUpscaleDescription* dispatchParams);
 FfxErrorCode ffxFsr3ContextDispatchUpscale(FfxFsr3Context* context, const FfxFsr3DispatchUpscaleDescription* dispatchParams)
 {
-    static PfnFfxFsr3ContextDispatchUpscale fsr3ContextDispatchUpscale = reinterpret_cast<PfnFfxFsr3ContextDispatchUpscale>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxFsr3ContextDispatchUpscale"));
-    return fsr3ContextDispatchUpscale(context, dispatchParams);
+    const Fsr3Functions* functions = GetFsr3Functions();
+    return functions != nullptr ? functions->ffxFsr3ContextDispatchUpscale(context, dispatchParams) : FFX_ERROR_INCOMPLETE_INTERFACE;
+}
+#elif defined(FSR_BACKEND_NULL)
+bool LoadFSRFunctions()
+{
+    // The stub provider is linked directly, locating it runs the same discovery path as FSR_BACKEND_ALL builds.
+    return DllLoader::Instance(DLL_LOADER_TEXT(FFX_STUB_LIBRARY_NAME)).IsLoaded();
+}
+#else
+bool LoadFSRFunctions()
+{
+    return true;
 }
 #endif
\ No newline at end of file
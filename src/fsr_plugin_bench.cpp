@@ -0,0 +1,1071 @@
+// CPU-overhead benchmark for the plugin's Unity entry points.
+// Built with FSR_BACKEND=null, so it runs against DeviceNull and the stub FFX provider without a GPU.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IUnityInterface.h"
+#include "IUnityLog.h"
+#include "IUnityGraphics.h"
+#include "IUnityRenderingExtensions.h"
+#include "fsrunityplugin.h"
+#include "commandbufferring.h"
+#include "device_null.h"
+#include "ffx_stub.h"
+
+#if defined(FSR_2)
+#include "fsr2.h"
+#elif defined(FSR_3)
+#include "fsr3.h"
+#elif defined(FSR_API)
+#include "fsrapi.h"
+#else
+#error unknown FSR version
+#endif
+
+
+// Heap allocations are counted by replacing the global allocation functions. On Linux this also captures
+// allocations made inside the plugin shared library; allocations through malloc are not counted. Every
+// replacement funnels into Allocate and Deallocate, which stay out of line so the compiler does not pair an
+// inlined free with operator new.
+static std::atomic<uint64_t> g_AllocationCount = {0};
+
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+BENCH_NOINLINE static void* Allocate(size_t size, size_t alignment)
+{
+    ++g_AllocationCount;
+    size = size ? size : 1;
+    if (alignment <= alignof(std::max_align_t)) {
+        return std::malloc(size);
+    }
+#if defined(_WIN32)
+    return _aligned_malloc(size, alignment);
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+#endif
+}
+
+BENCH_NOINLINE static void Deallocate(void* p, size_t alignment)
+{
+#if defined(_WIN32)
+    if (alignment > alignof(std::max_align_t)) {
+        _aligned_free(p);
+        return;
+    }
+#endif
+    std::free(p);
+}
+
+static void* AllocateOrThrow(size_t size, size_t alignment)
+{
+    void* p = Allocate(size, alignment);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new(size_t size) { return AllocateOrThrow(size, 0); }
+void* operator new[](size_t size) { return AllocateOrThrow(size, 0); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Allocate(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Allocate(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return AllocateOrThrow(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return AllocateOrThrow(size, static_cast<size_t>(alignment)); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return Allocate(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return Allocate(size, static_cast<size_t>(alignment)); }
+
+void operator delete(void* p) noexcept { Deallocate(p, 0); }
+void operator delete[](void* p) noexcept { Deallocate(p, 0); }
+void operator delete(void* p, size_t) noexcept { Deallocate(p, 0); }
+void operator delete[](void* p, size_t) noexcept { Deallocate(p, 0); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { Deallocate(p, 0); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { Deallocate(p, 0); }
+void operator delete(void* p, std::align_val_t alignment) noexcept { Deallocate(p, static_cast<size_t>(alignment)); }
+void operator delete[](void* p, std::align_val_t alignment) noexcept { Deallocate(p, static_cast<size_t>(alignment)); }
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept { Deallocate(p, static_cast<size_t>(alignment)); }
+void operator delete[](void* p, size_t, std::align_val_t alignment) noexcept { Deallocate(p, static_cast<size_t>(alignment)); }
+void operator delete(void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { Deallocate(p, static_cast<size_t>(alignment)); }
+void operator delete[](void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { Deallocate(p, static_cast<size_t>(alignment)); }
+
+extern "C" {
+    void UNITY_INTERFACE_API UnityPluginLoad(IUnityInterfaces* unityInterfaces);
+    void UNITY_INTERFACE_API UnityPluginUnload();
+    bool UNITY_INTERFACE_API FSRQuery(uint32_t fsrVersion);
+    uint32_t UNITY_INTERFACE_API FSRInit(uint32_t instanceID, const InitParam* initParam, uint32_t fsrVersion);
+    uint32_t UNITY_INTERFACE_API FSRInitEx(uint32_t instanceID, const InitParam* initParam, uint32_t initParamSize, uint32_t fsrVersion);
+    void UNITY_INTERFACE_API FSRCallback(int eventID, void* data);
+    void UNITY_INTERFACE_API FSRSetAsyncInit(bool enabled);
+    uint32_t UNITY_INTERFACE_API FSRGetInitStatus(uint32_t instanceID);
+    void UNITY_INTERFACE_API FSRGetCommandBufferCounters(CommandBufferRingCounters* outCounters);
+    void UNITY_INTERFACE_API FSRGetHostMemoryUsage(uint32_t instanceID, HostArenaCounters* outCounters);
+    void UNITY_INTERFACE_API FSRGetMemoryUsage(uint32_t instanceID, GpuMemoryUsage* outUsage);
+    void UNITY_INTERFACE_API FSRGetDeviceMemoryUsage(GpuMemoryBudgetCounters* outCounters);
+    void UNITY_INTERFACE_API FSRSetMemoryBudget(uint64_t bytes, bool refuse);
+    void UNITY_INTERFACE_API FSRSetContextPoolCapacity(uint32_t capacity);
+    void UNITY_INTERFACE_API FSRSetResolutionGovernor(uint32_t instanceID, const GovernorParam* governorParam);
+    bool UNITY_INTERFACE_API FSRGetGovernedRenderSize(uint32_t instanceID, GovernorResult* outResult);
+    bool UNITY_INTERFACE_API FSRGetRenderResolution(uint32_t instanceID, uint32_t qualityMode, uint32_t displayWidth, uint32_t displayHeight, uint32_t* outRenderWidth, uint32_t* outRenderHeight);
+    float UNITY_INTERFACE_API FSRGetUpscaleRatio(uint32_t instanceID, uint32_t qualityMode);
+    bool UNITY_INTERFACE_API FSRSetGpuTimestamps(bool enabled);
+    void UNITY_INTERFACE_API FSRGetStats(uint32_t instanceID, FSRStats* outStats);
+    void UNITY_INTERFACE_API FSRSetTracing(bool enabled);
+    bool UNITY_INTERFACE_API FSRWriteTrace(const char* path);
+    void UNITY_INTERFACE_API FSRGetProjectionMatrixJitterOffset(const int32_t index, const int32_t renderWidth, const int32_t displayWidth, float* outJitterOffset);
+    int32_t UNITY_INTERFACE_API FSRGetJitterSequence(const int32_t renderWidth, const int32_t displayWidth, float* outJitterOffsets, const int32_t capacity);
+    void UNITY_INTERFACE_API FSRTextureUpdateCallback(UnityRenderingExtEventType eventType, void* data);
+    void UNITY_INTERFACE_API FSRNullDeviceSetGpuLatency(uint32_t microseconds);
+    void UNITY_INTERFACE_API FSRNullDeviceGetCounters(DeviceNull::Counters* outCounters);
+}
+
+namespace
+{
+    // Minimal stand-ins for the interfaces Unity hands to UnityPluginLoad.
+    uint64_t g_LogErrors = 0;
+    IUnityGraphicsDeviceEventCallback g_DeviceEventCallback = nullptr;
+
+    void UNITY_INTERFACE_API Log(UnityLogType type, const char* message, const char* fileName, const int fileLine)
+    {
+        if (type == kUnityLogTypeError || type == kUnityLogTypeException) {
+            if (g_LogErrors++ < 8) {
+                std::fprintf(stderr, "plugin error: %s (%s:%d)\n", message, fileName, fileLine);
+            }
+        }
+    }
+
+    UnityGfxRenderer UNITY_INTERFACE_API GetRenderer()
+    {
+        return kUnityGfxRendererNull;
+    }
+
+    void UNITY_INTERFACE_API RegisterDeviceEventCallback(IUnityGraphicsDeviceEventCallback callback)
+    {
+        g_DeviceEventCallback = callback;
+    }
+
+    void UNITY_INTERFACE_API UnregisterDeviceEventCallback(IUnityGraphicsDeviceEventCallback callback)
+    {
+        if (g_DeviceEventCallback == callback) {
+            g_DeviceEventCallback = nullptr;
+        }
+    }
+
+    int UNITY_INTERFACE_API ReserveEventIDRange(int count)
+    {
+        return 0;
+    }
+
+    IUnityLog g_UnityLog = {Log};
+    IUnityGraphics g_UnityGraphics = {GetRenderer, RegisterDeviceEventCallback, UnregisterDeviceEventCallback, ReserveEventIDRange};
+
+    IUnityInterface* UNITY_INTERFACE_API GetInterfaceSplit(unsigned long long guidHigh, unsigned long long guidLow)
+    {
+        const UnityInterfaceGUID logGUID = UNITY_GET_INTERFACE_GUID(IUnityLog);
+        const UnityInterfaceGUID graphicsGUID = UNITY_GET_INTERFACE_GUID(IUnityGraphics);
+        if (guidHigh == logGUID.m_GUIDHigh && guidLow == logGUID.m_GUIDLow) {
+            return &g_UnityLog;
+        }
+        if (guidHigh == graphicsGUID.m_GUIDHigh && guidLow == graphicsGUID.m_GUIDLow) {
+            return &g_UnityGraphics;
+        }
+        return nullptr;
+    }
+
+    IUnityInterface* UNITY_INTERFACE_API GetInterface(UnityInterfaceGUID guid)
+    {
+        return GetInterfaceSplit(guid.m_GUIDHigh, guid.m_GUIDLow);
+    }
+
+    void UNITY_INTERFACE_API RegisterInterface(UnityInterfaceGUID guid, IUnityInterface* ptr) {}
+    void UNITY_INTERFACE_API RegisterInterfaceSplit(unsigned long long guidHigh, unsigned long long guidLow, IUnityInterface* ptr) {}
+
+    IUnityInterfaces g_UnityInterfaces = {GetInterface, RegisterInterface, GetInterfaceSplit, RegisterInterfaceSplit};
+
+    enum EntryPoint
+    {
+        JITTER_OFFSET = 0,
+        TEXTURE_UPDATE,
+        REACTIVE_MASK,
+        DISPATCH,
+        ENTRY_POINT_COUNT
+    };
+
+    const char* s_EntryPointNames[ENTRY_POINT_COUNT] = {
+        "FSRGetProjectionMatrixJitterOffset",
+        "FSRTextureUpdateCallback",
+        "FSRCallback(REACTIVEMASK)",
+        "FSRCallback(DISPATCH)",
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    template<typename F>
+    inline void Measure(std::vector<uint64_t>& samples, F&& f)
+    {
+        Clock::time_point start = Clock::now();
+        f();
+        samples.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+    }
+
+    uint64_t Percentile(const std::vector<uint64_t>& sorted, double p)
+    {
+        if (sorted.empty()) {
+            return 0;
+        }
+        size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[(std::min)(index, sorted.size() - 1)];
+    }
+
+    int EventID(uint32_t instanceID, FSRUnityPlugin::PassEvent passEvent)
+    {
+        return static_cast<int>((instanceID << 16) | static_cast<uint32_t>(passEvent));
+    }
+
+    void Run(uint32_t instanceCount, uint32_t frameCount)
+    {
+        const uint32_t displayWidth = 3840;
+        const uint32_t displayHeight = 2160;
+        const uint32_t renderWidth = 2560;
+        const uint32_t renderHeight = 1440;
+
+        // Dummy native resources, the null device passes them through untouched.
+        static int s_Textures[TextureName::MAX] = {};
+
+        InitParam initParam = {};
+        initParam.displaySizeWidth = displayWidth;
+        initParam.displaySizeHeight = displayHeight;
+        for (uint32_t id = 0; id < instanceCount; ++id) {
+            FSRInit(id, &initParam, 0);
+        }
+
+        GenReactiveParam genReactiveParam = {};
+        genReactiveParam.colorOpaqueOnly = &s_Textures[TextureName::COLOR_OPAQUE_ONLY];
+        genReactiveParam.colorPreUpscale = &s_Textures[TextureName::COLOR_PRE_UPSCALE];
+        genReactiveParam.outReactive = &s_Textures[TextureName::REACTIVE];
+        genReactiveParam.renderSizeWidth = renderWidth;
+        genReactiveParam.renderSizeHeight = renderHeight;
+        genReactiveParam.scale = 1.0f;
+        genReactiveParam.cutoffThreshold = 0.2f;
+        genReactiveParam.binaryValue = 0.9f;
+
+        DispatchParam dispatchParam = {};
+        dispatchParam.color = &s_Textures[TextureName::COLOR];
+        dispatchParam.depth = &s_Textures[TextureName::DEPTH];
+        dispatchParam.motionVectors = &s_Textures[TextureName::MOTION_VECTORS];
+        dispatchParam.reactive = &s_Textures[TextureName::REACTIVE];
+        dispatchParam.transparencyAndComposition = &s_Textures[TextureName::TRANSPARENT_AND_COMPOSITION];
+        dispatchParam.output = &s_Textures[TextureName::OUTPUT];
+        dispatchParam.motionVectorScaleX = -static_cast<float>(renderWidth);
+        dispatchParam.motionVectorScaleY = -static_cast<float>(renderHeight);
+        dispatchParam.renderSizeWidth = renderWidth;
+        dispatchParam.renderSizeHeight = renderHeight;
+        dispatchParam.frameTimeDelta = 16.6f;
+        dispatchParam.preExposure = 1.0f;
+        dispatchParam.cameraNear = 0.1f;
+        dispatchParam.cameraFar = 1000.0f;
+        dispatchParam.cameraFovAngleVertical = 1.0f;
+
+        UnityRenderingExtTextureUpdateParamsV2 textureUpdateParams = {};
+
+        std::vector<uint64_t> samples[ENTRY_POINT_COUNT];
+        for (auto& entrySamples : samples) {
+            entrySamples.reserve(static_cast<size_t>(instanceCount) * frameCount);
+        }
+        std::vector<uint64_t> frameSamples;
+        frameSamples.reserve(frameCount);
+
+        float jitterOffset[2] = {};
+        const uint64_t allocationsBefore = g_AllocationCount.load();
+        for (uint32_t frame = 0; frame < frameCount; ++frame) {
+            Clock::time_point frameStart = Clock::now();
+            for (uint32_t id = 0; id < instanceCount; ++id) {
+                Measure(samples[JITTER_OFFSET], [&]() {
+                    FSRGetProjectionMatrixJitterOffset(static_cast<int32_t>(frame), renderWidth, displayWidth, jitterOffset);
+                });
+                textureUpdateParams.userData = (id << 16) | TextureName::COLOR;
+                textureUpdateParams.textureID = static_cast<intptr_t>(frame + 1);
+                Measure(samples[TEXTURE_UPDATE], [&]() {
+                    FSRTextureUpdateCallback(kUnityRenderingExtEventUpdateTextureBeginV2, &textureUpdateParams);
+                });
+                Measure(samples[REACTIVE_MASK], [&]() {
+                    FSRCallback(EventID(id, FSRUnityPlugin::PassEvent::REACTIVEMASK), &genReactiveParam);
+                });
+                dispatchParam.jitterOffsetX = jitterOffset[0];
+                dispatchParam.jitterOffsetY = jitterOffset[1];
+                Measure(samples[DISPATCH], [&]() {
+                    FSRCallback(EventID(id, FSRUnityPlugin::PassEvent::DISPATCH), &dispatchParam);
+                });
+            }
+            // Takes no data, and must not log for its missing data.
+            FSRCallback(FSRUnityPlugin::PassEvent::ASYNC_ACQUIRE, nullptr);
+            frameSamples.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - frameStart).count()));
+        }
+        const uint64_t allocations = g_AllocationCount.load() - allocationsBefore;
+
+        for (uint32_t id = 0; id < instanceCount; ++id) {
+            FSRCallback(EventID(id, FSRUnityPlugin::PassEvent::DESTROY), &dispatchParam);
+        }
+
+        // The bulk sequence must agree with the per-frame offsets.
+        const int32_t phaseCount = FSRGetJitterSequence(renderWidth, displayWidth, nullptr, 0);
+        std::vector<float> jitterSequence(static_cast<size_t>(phaseCount) * 2);
+        FSRGetJitterSequence(renderWidth, displayWidth, jitterSequence.data(), phaseCount);
+        for (int32_t phase = 0; phase < phaseCount; ++phase) {
+            FSRGetProjectionMatrixJitterOffset(phase, renderWidth, displayWidth, jitterOffset);
+            if (jitterOffset[0] != jitterSequence[phase * 2] || jitterOffset[1] != jitterSequence[phase * 2 + 1]) {
+                std::fprintf(stderr, "jitter sequence mismatch at phase %d\n", phase);
+                ++g_LogErrors;
+                break;
+            }
+        }
+
+        std::printf("instances: %u, frames: %u, heap allocations/frame: %.2f, jitter phases: %d\n", instanceCount, frameCount,
+            static_cast<double>(allocations) / frameCount, phaseCount);
+        std::printf("  %-36s %12s %10s %10s\n", "entry point", "mean ns", "p50 ns", "p99 ns");
+        for (int entry = 0; entry < ENTRY_POINT_COUNT; ++entry) {
+            std::vector<uint64_t>& entrySamples = samples[entry];
+            std::sort(entrySamples.begin(), entrySamples.end());
+            uint64_t total = 0;
+            for (uint64_t sample : entrySamples) {
+                total += sample;
+            }
+            double mean = entrySamples.empty() ? 0.0 : static_cast<double>(total) / entrySamples.size();
+            std::printf("  %-36s %12.1f %10llu %10llu\n", s_EntryPointNames[entry], mean,
+                static_cast<unsigned long long>(Percentile(entrySamples, 0.50)),
+                static_cast<unsigned long long>(Percentile(entrySamples, 0.99)));
+        }
+        std::sort(frameSamples.begin(), frameSamples.end());
+        std::printf("  %-36s %12s %10llu %10llu\n", "frame (all instances)", "",
+            static_cast<unsigned long long>(Percentile(frameSamples, 0.50)),
+            static_cast<unsigned long long>(Percentile(frameSamples, 0.99)));
+
+        // The ring is shared by every run, so the counters are cumulative.
+        CommandBufferRingCounters ring = {};
+        FSRGetCommandBufferCounters(&ring);
+        std::printf("  command buffers: %u created of %u, %u stalls, peak depth %u\n", ring.creations, ring.capacity,
+            ring.stalls, ring.peakDepth);
+        if (ring.creations > ring.capacity || ring.peakDepth > ring.capacity) {
+            std::fprintf(stderr, "command buffer ring exceeded its capacity\n");
+            ++g_LogErrors;
+        }
+    }
+
+    // Alternates one instance between two display sizes, the pattern of alt-tab and window resizes.
+    void RunResize(uint32_t switchCount)
+    {
+        InitParam initParams[2] = {};
+        initParams[0].displaySizeWidth = 3840;
+        initParams[0].displaySizeHeight = 2160;
+        initParams[1].displaySizeWidth = 2560;
+        initParams[1].displaySizeHeight = 1440;
+
+        FfxStubStats before = {};
+        ffxStubGetStats(&before);
+        std::vector<uint64_t> samples;
+        samples.reserve(switchCount);
+        for (uint32_t i = 0; i < switchCount; ++i) {
+            Measure(samples, [&]() {
+                FSRInit(0, &initParams[i % 2], 0);
+            });
+        }
+        HostArenaCounters hostMemory = {};
+        FSRGetHostMemoryUsage(0, &hostMemory);
+        if (hostMemory.liveAllocationCount == 0 || hostMemory.usedBytes > hostMemory.reservedBytes) {
+            std::fprintf(stderr, "host memory of the context is not accounted\n");
+            ++g_LogErrors;
+        }
+        FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DESTROY), &initParams[0]);
+        FfxStubStats after = {};
+        ffxStubGetStats(&after);
+        HostArenaCounters released = {};
+        FSRGetHostMemoryUsage(0, &released);
+        if (released.reservedBytes != 0) {
+            std::fprintf(stderr, "host memory still held after DESTROY\n");
+            ++g_LogErrors;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        std::printf("resize: %u switches, contexts created: %llu, host memory: %llu of %llu bytes in %llu allocations\n",
+            switchCount, static_cast<unsigned long long>(after.createContext - before.createContext),
+            static_cast<unsigned long long>(hostMemory.usedBytes), static_cast<unsigned long long>(hostMemory.reservedBytes),
+            static_cast<unsigned long long>(hostMemory.liveAllocationCount));
+        std::printf("  %-36s %12s %10llu %10llu\n", "FSRInit", "",
+            static_cast<unsigned long long>(Percentile(samples, 0.50)),
+            static_cast<unsigned long long>(Percentile(samples, 0.99)));
+    }
+
+    // REACTIVEMASK_DISPATCH has to run both passes with a single submission.
+    void RunReactiveDispatch(uint32_t frameCount)
+    {
+        static int s_Textures[TextureName::MAX] = {};
+
+        InitParam initParam = {};
+        initParam.displaySizeWidth = 3840;
+        initParam.displaySizeHeight = 2160;
+        FSRInit(0, &initParam, 0);
+
+        ReactiveDispatchParam param = {};
+        param.genReactive.colorOpaqueOnly = &s_Textures[TextureName::COLOR_OPAQUE_ONLY];
+        param.genReactive.colorPreUpscale = &s_Textures[TextureName::COLOR_PRE_UPSCALE];
+        param.genReactive.outReactive = &s_Textures[TextureName::REACTIVE];
+        param.genReactive.renderSizeWidth = 2560;
+        param.genReactive.renderSizeHeight = 1440;
+        param.genReactive.scale = 1.0f;
+        param.dispatch.color = &s_Textures[TextureName::COLOR];
+        param.dispatch.depth = &s_Textures[TextureName::DEPTH];
+        param.dispatch.motionVectors = &s_Textures[TextureName::MOTION_VECTORS];
+        param.dispatch.output = &s_Textures[TextureName::OUTPUT];
+        param.dispatch.renderSizeWidth = 2560;
+        param.dispatch.renderSizeHeight = 1440;
+        param.dispatch.frameTimeDelta = 16.6f;
+        param.dispatch.preExposure = 1.0f;
+
+        FfxStubStats before = {};
+        ffxStubGetStats(&before);
+        DeviceNull::Counters countersBefore = {};
+        FSRNullDeviceGetCounters(&countersBefore);
+        std::vector<uint64_t> samples;
+        samples.reserve(frameCount);
+        for (uint32_t frame = 0; frame < frameCount; ++frame) {
+            Measure(samples, [&]() {
+                FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::REACTIVEMASK_DISPATCH), &param);
+            });
+        }
+        FfxStubStats after = {};
+        ffxStubGetStats(&after);
+        DeviceNull::Counters countersAfter = {};
+        FSRNullDeviceGetCounters(&countersAfter);
+        FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DESTROY), &param);
+
+        uint64_t submissions = countersAfter.executeCommandList - countersBefore.executeCommandList;
+        if (after.dispatchReactiveMask - before.dispatchReactiveMask != frameCount ||
+            after.dispatchUpscale - before.dispatchUpscale != frameCount || submissions != frameCount) {
+            std::fprintf(stderr, "REACTIVEMASK_DISPATCH did not run both passes in one submission per frame\n");
+            ++g_LogErrors;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        std::printf("reactive mask + dispatch: %u frames, %llu submissions\n", frameCount,
+            static_cast<unsigned long long>(submissions));
+        std::printf("  %-36s %12s %10llu %10llu\n", "FSRCallback(REACTIVEMASK_DISPATCH)", "",
+            static_cast<unsigned long long>(Percentile(samples, 0.50)),
+            static_cast<unsigned long long>(Percentile(samples, 0.99)));
+    }
+
+    // DISPATCH_BATCH records every instance of the frame with a single submission.
+    void RunDispatchBatch(uint32_t instanceCount, uint32_t frameCount)
+    {
+        static int s_Textures[TextureName::MAX] = {};
+
+        InitParam initParam = {};
+        initParam.displaySizeWidth = 1920;
+        initParam.displaySizeHeight = 1080;
+        std::vector<uint32_t> instanceIDs(instanceCount);
+        std::vector<DispatchParam> dispatchParams(instanceCount);
+        for (uint32_t id = 0; id < instanceCount; ++id) {
+            FSRInit(id, &initParam, 0);
+            instanceIDs[id] = id;
+            DispatchParam& param = dispatchParams[id];
+            param.color = &s_Textures[TextureName::COLOR];
+            param.depth = &s_Textures[TextureName::DEPTH];
+            param.motionVectors = &s_Textures[TextureName::MOTION_VECTORS];
+            param.output = &s_Textures[TextureName::OUTPUT];
+            param.renderSizeWidth = 1280;
+            param.renderSizeHeight = 720;
+            param.frameTimeDelta = 16.6f;
+            param.preExposure = 1.0f;
+        }
+        DispatchBatchParam batchParam = {instanceCount, instanceIDs.data(), dispatchParams.data()};
+
+        FfxStubStats before = {};
+        ffxStubGetStats(&before);
+        DeviceNull::Counters countersBefore = {};
+        FSRNullDeviceGetCounters(&countersBefore);
+        std::vector<uint64_t> samples;
+        samples.reserve(frameCount);
+        for (uint32_t frame = 0; frame < frameCount; ++frame) {
+            Measure(samples, [&]() {
+                FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DISPATCH_BATCH), &batchParam);
+            });
+        }
+        FfxStubStats after = {};
+        ffxStubGetStats(&after);
+        DeviceNull::Counters countersAfter = {};
+        FSRNullDeviceGetCounters(&countersAfter);
+        for (uint32_t id = 0; id < instanceCount; ++id) {
+            FSRCallback(EventID(id, FSRUnityPlugin::PassEvent::DESTROY), &initParam);
+        }
+
+        uint64_t submissions = countersAfter.executeCommandList - countersBefore.executeCommandList;
+        if (after.dispatchUpscale - before.dispatchUpscale != static_cast<uint64_t>(instanceCount) * frameCount ||
+            submissions != frameCount) {
+            std::fprintf(stderr, "DISPATCH_BATCH did not dispatch every instance with one submission per frame\n");
+            ++g_LogErrors;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        std::printf("dispatch batch: %u instances, %u frames, %llu submissions\n", instanceCount, frameCount,
+            static_cast<unsigned long long>(submissions));
+        std::printf("  %-36s %12s %10llu %10llu\n", "FSRCallback(DISPATCH_BATCH)", "",
+            static_cast<unsigned long long>(Percentile(samples, 0.50)),
+            static_cast<unsigned long long>(Percentile(samples, 0.99)));
+    }
+
+    // A jitter sequence that cannot be generated is asked for every frame. Only the first request may log it,
+    // until an Init lets it be tried again.
+    void RunJitterFailure(uint32_t frameCount)
+    {
+        float jitterOffset[2] = {};
+        uint64_t logErrors = g_LogErrors;
+        for (uint32_t frame = 0; frame < frameCount; ++frame) {
+            FSRGetProjectionMatrixJitterOffset(static_cast<int32_t>(frame), 0, 1920, jitterOffset);
+        }
+        const uint64_t logged = g_LogErrors - logErrors;
+        g_LogErrors = logErrors;
+        if (logged != 1) {
+            std::fprintf(stderr, "a failed jitter sequence was logged %llu times over %u frames\n", static_cast<unsigned long long>(logged), frameCount);
+            ++g_LogErrors;
+        }
+        std::printf("jitter failure: logged %llu times over %u frames\n", static_cast<unsigned long long>(logged), frameCount);
+    }
+
+    // Render resolutions of every quality mode, the second round has to be served from the cache. Then queries
+    // from another thread while the instance's context is re-created for a specific provider and released.
+    void RunRenderResolution()
+    {
+        const uint32_t expectedWidths[QUALITY_MODE_COUNT] = {3840, 2560, 2258, 1920, 1280};
+        uint64_t queries[2] = {};
+        for (uint32_t round = 0; round < 2; ++round) {
+            FfxStubStats before = {};
+            ffxStubGetStats(&before);
+            for (uint32_t mode = 0; mode < QUALITY_MODE_COUNT; ++mode) {
+                uint32_t width = 0;
+                uint32_t height = 0;
+                if (!FSRGetRenderResolution(0, mode, 3840, 2160, &width, &height) || width != expectedWidths[mode] ||
+                    FSRGetUpscaleRatio(0, mode) != GetQualityModeUpscaleRatio(mode)) {
+                    std::fprintf(stderr, "quality mode %u resolves to %ux%u\n", mode, width, height);
+                    ++g_LogErrors;
+                }
+            }
+            FfxStubStats after = {};
+            ffxStubGetStats(&after);
+            queries[round] = after.query - before.query;
+        }
+        if (queries[1] != 0) {
+            std::fprintf(stderr, "cached render resolutions still queried FFX %llu times\n", static_cast<unsigned long long>(queries[1]));
+            ++g_LogErrors;
+        }
+
+        InitParam initParam = {};
+        initParam.displaySizeHeight = 1080;
+        std::atomic<bool> stop = {false};
+        std::atomic<uint32_t> failures = {0};
+        std::thread queryThread([&stop, &failures]() {
+            for (uint32_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+                uint32_t width = 0;
+                uint32_t height = 0;
+                if (!FSRGetRenderResolution(0, QUALITY_MODE_PERFORMANCE, 1920 + (i % 64) * 8, 1080, &width, &height) ||
+                    FSRGetUpscaleRatio(0, QUALITY_MODE_PERFORMANCE) != 2.0f) {
+                    failures.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+        for (uint32_t i = 0; i < 200; ++i) {
+            initParam.displaySizeWidth = 1920 + (i % 8) * 8;
+            FSRInit(0, &initParam, 3);
+        }
+        FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DESTROY), &initParam);
+        stop.store(true, std::memory_order_relaxed);
+        queryThread.join();
+        if (failures.load(std::memory_order_relaxed) != 0) {
+            std::fprintf(stderr, "%u render resolution queries failed while the context was re-created\n", failures.load(std::memory_order_relaxed));
+            ++g_LogErrors;
+        }
+
+        std::printf("render resolution: %u quality modes, %llu FFX queries, then %llu\n", static_cast<uint32_t>(QUALITY_MODE_COUNT),
+            static_cast<unsigned long long>(queries[0]), static_cast<unsigned long long>(queries[1]));
+    }
+
+    // Drives the governor with a simulated GPU whose frame time is a fixed part plus a part proportional to the
+    // render area. Halfway through the scene gets twice as expensive. After each half settles, the frame time has
+    // to sit at the target and the render size has to stop changing.
+    void RunGovernor(uint32_t frameCount)
+    {
+        static int s_Textures[TextureName::MAX] = {};
+
+        InitParam initParam = {};
+        initParam.displaySizeWidth = 3840;
+        initParam.displaySizeHeight = 2160;
+        initParam.maxUpscaleRatio = 3.0f;
+        FSRInitEx(0, &initParam, sizeof(initParam), 0);
+        GovernorParam governorParam = {};
+        governorParam.targetFrameTime = 10.0f;
+        FSRSetResolutionGovernor(0, &governorParam);
+
+        DispatchParam param = {};
+        param.color = &s_Textures[TextureName::COLOR];
+        param.depth = &s_Textures[TextureName::DEPTH];
+        param.motionVectors = &s_Textures[TextureName::MOTION_VECTORS];
+        param.output = &s_Textures[TextureName::OUTPUT];
+        param.preExposure = 1.0f;
+
+        const float fixedTime = 3.0f;
+        const float fullAreaPixels = 3840.0f * 2160.0f;
+        const uint32_t phaseFrames = (std::max)(frameCount / 2, 60u);
+        const uint32_t settleFrames = phaseFrames / 2;
+        uint32_t failures = 0;
+        GovernorResult result = {};
+        for (uint32_t phase = 0; phase < 2; ++phase) {
+            float areaTime = phase == 0 ? 12.0f : 24.0f;
+            uint32_t resizes = 0;
+            float worstError = 0.0f;
+            for (uint32_t frame = 0; frame < phaseFrames; ++frame) {
+                GovernorResult next = {};
+                if (!FSRGetGovernedRenderSize(0, &next) || next.jitterPhaseCount <= 0 ||
+                    next.renderSizeWidth > 3840 || next.renderSizeWidth < 1280 || next.renderSizeHeight > 2160 || next.renderSizeHeight < 720) {
+                    ++failures;
+                }
+                bool settled = frame >= settleFrames;
+                resizes += settled && (next.renderSizeWidth != result.renderSizeWidth || next.renderSizeHeight != result.renderSizeHeight);
+                result = next;
+                param.renderSizeWidth = result.renderSizeWidth;
+                param.renderSizeHeight = result.renderSizeHeight;
+                param.frameTimeDelta = fixedTime + areaTime * (result.renderSizeWidth * result.renderSizeHeight) / fullAreaPixels;
+                if (settled) {
+                    worstError = (std::max)(worstError, std::abs(param.frameTimeDelta - governorParam.targetFrameTime) / governorParam.targetFrameTime);
+                }
+                FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DISPATCH), &param);
+            }
+            // The deadband lets it settle anywhere within 5% of the target, one granularity step is on top.
+            if (worstError > 0.08f || resizes > 2) {
+                std::fprintf(stderr, "governor did not settle: %.1f%% off the target, %u resizes\n", worstError * 100.0f, resizes);
+                ++failures;
+            }
+            std::printf("governor: %.0f ms area cost, settled at %ux%u (%d jitter phases), %.1f%% off the target, %u resizes\n",
+                areaTime, result.renderSizeWidth, result.renderSizeHeight, result.jitterPhaseCount, worstError * 100.0f, resizes);
+        }
+        FSRSetResolutionGovernor(0, nullptr);
+        FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DESTROY), &param);
+        g_LogErrors += failures != 0;
+    }
+
+    // Times the upscales and reactive masks of an instance on the null device, whose submissions each take
+    // gpuLatency. Without timestamps nothing may be measured, with them every sample has to be that latency.
+    void RunGpuTimestamps(uint32_t frameCount, uint32_t gpuLatency)
+    {
+        static int s_Textures[TextureName::MAX] = {};
+
+        InitParam initParam = {};
+        initParam.displaySizeWidth = 1920;
+        initParam.displaySizeHeight = 1080;
+        FSRInit(0, &initParam, 0);
+
+        GenReactiveParam genReactiveParam = {};
+        genReactiveParam.colorOpaqueOnly = &s_Textures[TextureName::COLOR_OPAQUE_ONLY];
+        genReactiveParam.colorPreUpscale = &s_Textures[TextureName::COLOR_PRE_UPSCALE];
+        genReactiveParam.outReactive = &s_Textures[TextureName::REACTIVE];
+        genReactiveParam.renderSizeWidth = 1280;
+        genReactiveParam.renderSizeHeight = 720;
+        genReactiveParam.scale = 1.0f;
+        DispatchParam param = {};
+        param.color = &s_Textures[TextureName::COLOR];
+        param.depth = &s_Textures[TextureName::DEPTH];
+        param.motionVectors = &s_Textures[TextureName::MOTION_VECTORS];
+        param.reactive = &s_Textures[TextureName::REACTIVE];
+        param.output = &s_Textures[TextureName::OUTPUT];
+        param.renderSizeWidth = 1280;
+        param.renderSizeHeight = 720;
+        param.frameTimeDelta = 16.6f;
+        param.preExposure = 1.0f;
+
+        FSRStats stats = {};
+        uint64_t allocations = 0;
+        for (uint32_t enabled = 0; enabled < 2; ++enabled) {
+            if (enabled != 0 && !FSRSetGpuTimestamps(true)) {
+                std::fprintf(stderr, "the null device refused GPU timestamps\n");
+                ++g_LogErrors;
+            }
+            const uint64_t allocationsBefore = g_AllocationCount.load();
+            for (uint32_t frame = 0; frame < frameCount; ++frame) {
+                FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::REACTIVEMASK), &genReactiveParam);
+                FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DISPATCH), &param);
+            }
+            allocations = g_AllocationCount.load() - allocationsBefore;
+            FSRGetStats(0, &stats);
+            if (enabled == 0 && (stats.upscale.sampleCount != 0 || stats.reactiveMask.sampleCount != 0)) {
+                std::fprintf(stderr, "GPU time was measured with timestamps off\n");
+                ++g_LogErrors;
+            }
+        }
+        // Everything submitted has completed after the ring's worth of latency, the next dispatch collects it.
+        std::this_thread::sleep_for(std::chrono::microseconds(uint64_t(gpuLatency) * Device::CommandBufferRingCapacity * 2 + 1000));
+        FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DISPATCH), &param);
+        FSRGetStats(0, &stats);
+        FSRSetGpuTimestamps(false);
+        FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DESTROY), &param);
+
+        const uint32_t expectedSamples = (std::min)(frameCount, GpuTimerStats::WindowSize);
+        const float latency = static_cast<float>(gpuLatency);
+        for (const GpuTimeStats* kindStats : {&stats.upscale, &stats.reactiveMask}) {
+            if (kindStats->sampleCount != expectedSamples || kindStats->lastMicroseconds != latency || kindStats->meanMicroseconds != latency ||
+                kindStats->minMicroseconds != latency || kindStats->maxMicroseconds != latency || kindStats->p95Microseconds != latency) {
+                std::fprintf(stderr, "GPU timestamps measured %u samples of %.1f us (mean %.1f, p95 %.1f) instead of %u of %.1f us\n",
+                    kindStats->sampleCount, kindStats->lastMicroseconds, kindStats->meanMicroseconds, kindStats->p95Microseconds, expectedSamples, latency);
+                ++g_LogErrors;
+            }
+        }
+        // Queued timers live in a fixed ring.
+        if (allocations != 0) {
+            std::fprintf(stderr, "GPU timestamps made %llu heap allocations in %u frames\n", static_cast<unsigned long long>(allocations), frameCount);
+            ++g_LogErrors;
+        }
+        if (stats.lostCount != 0) {
+            std::fprintf(stderr, "%llu GPU timers lost\n", static_cast<unsigned long long>(stats.lostCount));
+            ++g_LogErrors;
+        }
+
+        std::printf("gpu timestamps: %u upscale and %u reactive mask samples of %.0f us (p95 %.0f us), %llu lost\n",
+            stats.upscale.sampleCount, stats.reactiveMask.sampleCount, stats.upscale.meanMicroseconds, stats.upscale.p95Microseconds,
+            static_cast<unsigned long long>(stats.lostCount));
+    }
+
+    size_t CountOccurrences(const std::string& text, const char* pattern)
+    {
+        size_t count = 0;
+        for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+            ++count;
+        }
+        return count;
+    }
+
+    std::string ReadFile(const char* path)
+    {
+        std::string text;
+        FILE* file = std::fopen(path, "rb");
+        if (file != nullptr) {
+            char buffer[4096];
+            for (size_t read = 0; (read = std::fread(buffer, 1, sizeof(buffer), file)) != 0;) {
+                text.append(buffer, read);
+            }
+            std::fclose(file);
+        }
+        return text;
+    }
+
+    // Traces an asynchronous init and a few frames, the trace has to hold one event per callback, the device
+    // calls under it and the context creation on the worker thread. A second write starts empty.
+    void RunTrace(uint32_t frameCount)
+    {
+        static int s_Textures[TextureName::MAX] = {};
+        const char* path = "fsr_plugin_bench_trace.json";
+
+        InitParam initParam = {};
+        initParam.displaySizeWidth = 1920 + 7;
+        initParam.displaySizeHeight = 1080;
+        DispatchParam param = {};
+        param.color = &s_Textures[TextureName::COLOR];
+        param.depth = &s_Textures[TextureName::DEPTH];
+        param.motionVectors = &s_Textures[TextureName::MOTION_VECTORS];
+        param.output = &s_Textures[TextureName::OUTPUT];
+        param.renderSizeWidth = 1280;
+        param.renderSizeHeight = 720;
+        param.preExposure = 1.0f;
+
+        // Drops whatever FSR_TRACE recorded before.
+        FSRWriteTrace(path);
+        FSRSetTracing(true);
+        FSRSetAsyncInit(true);
+        FSRInit(0, &initParam, 0);
+        while (FSRGetInitStatus(0) == FSRUnityPlugin::INIT_STATUS_PENDING) {
+            std::this_thread::yield();
+        }
+        FSRSetAsyncInit(false);
+        for (uint32_t frame = 0; frame < frameCount; ++frame) {
+            FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DISPATCH), &param);
+        }
+        FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DESTROY), &param);
+        FSRSetTracing(false);
+
+        bool written = FSRWriteTrace(path);
+        std::string trace = ReadFile(path);
+        bool rewritten = FSRWriteTrace(path);
+        std::string empty = ReadFile(path);
+        std::remove(path);
+
+        size_t events = CountOccurrences(trace, "\"ph\":\"X\"");
+        size_t callbacks = CountOccurrences(trace, "\"FSRCallback(DISPATCH)\"");
+        size_t commandLists = CountOccurrences(trace, "\"Device::GetNativeCommandList\"");
+        size_t submissions = CountOccurrences(trace, "\"Device::ExecuteCommandList\"");
+        // Context creation is the only event of the worker thread, so it has to carry another thread ID.
+        std::vector<std::string> threadIds;
+        for (size_t pos = trace.find("\"tid\":"); pos != std::string::npos; pos = trace.find("\"tid\":", pos + 1)) {
+            std::string threadId = trace.substr(pos + 6, trace.find('}', pos) - pos - 6);
+            if (std::find(threadIds.begin(), threadIds.end(), threadId) == threadIds.end()) {
+                threadIds.push_back(threadId);
+            }
+        }
+        if (!written || !rewritten || callbacks != frameCount || commandLists < frameCount || submissions < frameCount ||
+            threadIds.size() < 2 || CountOccurrences(empty, "\"ph\":\"X\"") != 0) {
+            std::fprintf(stderr, "trace holds %zu DISPATCH callbacks, %zu command lists and %zu submissions of %u frames on %zu threads\n",
+                callbacks, commandLists, submissions, frameCount, threadIds.size());
+            ++g_LogErrors;
+        }
+        std::printf("trace: %zu events on %zu threads, %zu bytes of JSON\n", events, threadIds.size(), trace.size());
+    }
+
+    // A context created for Performance mode has to take less GPU memory than one created at display size.
+    // FSRInit reads the layout from before the envelope, so it has to size the context for the display size.
+    void RunMaxRenderSize()
+    {
+        InitParam initParam = {};
+        initParam.displaySizeWidth = 3840;
+        initParam.displaySizeHeight = 2160;
+        FSRInit(0, &initParam, 0);
+        GpuMemoryUsage fullSize = {};
+        FSRGetMemoryUsage(0, &fullSize);
+
+        initParam.maxRenderSizeWidth = 1920;
+        initParam.maxRenderSizeHeight = 1080;
+        initParam.maxUpscaleRatio = 3.0f;
+        FSRInitEx(1, &initParam, sizeof(initParam), 0);
+        GpuMemoryUsage performance = {};
+        FSRGetMemoryUsage(1, &performance);
+        FSRInit(2, &initParam, 0);
+        GpuMemoryUsage legacy = {};
+        FSRGetMemoryUsage(2, &legacy);
+        InitExParam initExParam = {};
+        initExParam.initParamSize = sizeof(initParam);
+        initExParam.initParam = initParam;
+        FSRCallback(EventID(3, FSRUnityPlugin::PassEvent::INITIALIZE_EX), &initExParam);
+        GpuMemoryUsage event = {};
+        FSRGetMemoryUsage(3, &event);
+        for (uint32_t id = 0; id < 4; ++id) {
+            FSRCallback(EventID(id, FSRUnityPlugin::PassEvent::DESTROY), &initParam);
+        }
+
+        if (performance.totalBytes == 0 || performance.totalBytes >= fullSize.totalBytes) {
+            std::fprintf(stderr, "the max render size did not shrink the context\n");
+            ++g_LogErrors;
+        }
+        if (legacy.totalBytes != fullSize.totalBytes) {
+            std::fprintf(stderr, "FSRInit read fields past the layout it takes\n");
+            ++g_LogErrors;
+        }
+        if (event.totalBytes != performance.totalBytes) {
+            std::fprintf(stderr, "the INITIALIZE_EX event did not apply the max render size\n");
+            ++g_LogErrors;
+        }
+        std::printf("max render size: %llu MiB at 3840x2160, %llu MiB at 1920x1080\n",
+            static_cast<unsigned long long>(fullSize.totalBytes >> 20), static_cast<unsigned long long>(performance.totalBytes >> 20));
+    }
+
+    // Creates 4K instances under a budget of exactly three of them, the budget has to admit three and refuse the
+    // rest before it is exceeded.
+    void RunMemoryBudget(uint32_t instanceCount)
+    {
+        InitParam initParam = {};
+        initParam.displaySizeWidth = 3840;
+        initParam.displaySizeHeight = 2160;
+
+        for (uint32_t id = 0; id < instanceCount; ++id) {
+            FSRCallback(EventID(id, FSRUnityPlugin::PassEvent::DESTROY), &initParam);
+        }
+#if defined(FSR_API)
+        // Contexts parked by the earlier runs would be evicted to make room and skew the count.
+        FSRSetContextPoolCapacity(0);
+        FSRSetContextPoolCapacity(2);
+#endif
+        FSRInit(0, &initParam, 0);
+        GpuMemoryUsage usage = {};
+        FSRGetMemoryUsage(0, &usage);
+        if (usage.totalBytes == 0) {
+            std::fprintf(stderr, "GPU memory of the context is not reported\n");
+            ++g_LogErrors;
+        }
+
+        GpuMemoryBudgetCounters baseline = {};
+        FSRGetDeviceMemoryUsage(&baseline);
+        const uint64_t budget = baseline.usedBytes + 2 * usage.totalBytes;
+        FSRSetMemoryBudget(budget, true);
+        uint64_t logErrors = g_LogErrors;
+        uint32_t refused = 0;
+        for (uint32_t id = 1; id < instanceCount; ++id) {
+            refused += FSRInit(id, &initParam, 0) != 0;
+        }
+        const uint32_t admitted = instanceCount - refused;
+        GpuMemoryBudgetCounters counters = {};
+        FSRGetDeviceMemoryUsage(&counters);
+        // Every refusal is logged as an error.
+        if (admitted != 3 || counters.refusedCount - baseline.refusedCount != refused || g_LogErrors - logErrors != refused) {
+            std::fprintf(stderr, "the GPU memory budget admitted %u of %u instances, expected 3\n", admitted, instanceCount);
+            ++g_LogErrors;
+        } else {
+            g_LogErrors = logErrors;
+        }
+        if (counters.usedBytes > budget) {
+            std::fprintf(stderr, "GPU memory went over the budget\n");
+            ++g_LogErrors;
+        }
+#if defined(FSR_API)
+        // The budget is full. Switching an instance to another configuration of the same size has to release the
+        // context it replaces instead of refusing the new one.
+        initParam.flags = 1;
+        if (FSRInit(0, &initParam, 0) != 0) {
+            std::fprintf(stderr, "the GPU memory budget refused a context that fits once the one it replaces is released\n");
+            ++g_LogErrors;
+        }
+        initParam.flags = 0;
+#endif
+        FSRSetMemoryBudget(0, false);
+        for (uint32_t id = 0; id < instanceCount; ++id) {
+            FSRCallback(EventID(id, FSRUnityPlugin::PassEvent::DESTROY), &initParam);
+        }
+
+        std::printf("memory budget: %llu MiB per instance (%llu MiB aliasable), %u of %u instances admitted, %llu of %llu MiB in use\n",
+            static_cast<unsigned long long>(usage.totalBytes >> 20), static_cast<unsigned long long>(usage.aliasableBytes >> 20),
+            admitted, instanceCount, static_cast<unsigned long long>(counters.usedBytes >> 20),
+            static_cast<unsigned long long>(budget >> 20));
+    }
+
+    // Creates contexts on the worker thread and checks the status transitions.
+    void RunAsyncInit(uint32_t initCount)
+    {
+        InitParam initParam = {};
+        initParam.displaySizeWidth = 1920;
+        initParam.displaySizeHeight = 1080;
+
+        FSRSetAsyncInit(true);
+        std::vector<uint64_t> samples;
+        samples.reserve(initCount);
+        uint32_t failed = 0;
+        for (uint32_t i = 0; i < initCount; ++i) {
+            // A distinct size per iteration so the context pool cannot serve it.
+            initParam.displaySizeWidth = 1920 + i;
+            Measure(samples, [&]() {
+                FSRInit(0, &initParam, 0);
+            });
+            uint32_t status = FSRGetInitStatus(0);
+            while (status == FSRUnityPlugin::INIT_STATUS_PENDING) {
+                std::this_thread::yield();
+                status = FSRGetInitStatus(0);
+            }
+            failed += status != FSRUnityPlugin::INIT_STATUS_READY;
+        }
+
+        // Resizing and destroying while a slow creation is pending abandon it instead of waiting for it. The
+        // abandoned contexts are released by the time the device shuts down, see the budget check in main.
+        const uint32_t createLatencyUs = 20000;
+        const uint32_t supersedeCount = 4;
+        ffxStubSetCreateLatency(createLatencyUs);
+        std::vector<uint64_t> supersedeSamples;
+        for (uint32_t i = 0; i < supersedeCount; ++i) {
+            initParam.displaySizeWidth = 1280 + i;
+            Measure(supersedeSamples, [&]() {
+                FSRInit(0, &initParam, 0);
+            });
+        }
+        Measure(supersedeSamples, [&]() {
+            FSRCallback(EventID(0, FSRUnityPlugin::PassEvent::DESTROY), &initParam);
+        });
+        ffxStubSetCreateLatency(0);
+        FSRSetAsyncInit(false);
+        if (failed != 0) {
+            std::fprintf(stderr, "%u asynchronous inits failed\n", failed);
+            ++g_LogErrors;
+        }
+        std::sort(supersedeSamples.begin(), supersedeSamples.end());
+        if (supersedeSamples.back() >= createLatencyUs * 1000ull / 2) {
+            std::fprintf(stderr, "FSRInit or FSRDestroy waited %llu ns for a superseded creation\n",
+                static_cast<unsigned long long>(supersedeSamples.back()));
+            ++g_LogErrors;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        std::printf("async init: %u inits\n", initCount);
+        std::printf("  %-36s %12s %10llu %10llu\n", "FSRInit", "",
+            static_cast<unsigned long long>(Percentile(samples, 0.50)),
+            static_cast<unsigned long long>(Percentile(samples, 0.99)));
+        std::printf("  %u resizes and a destroy over a %u us creation, slowest %llu ns\n", supersedeCount, createLatencyUs,
+            static_cast<unsigned long long>(supersedeSamples.back()));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frameCount = 1000;
+    uint32_t gpuLatency = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--frames") == 0) {
+            frameCount = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--gpu-latency-us") == 0) {
+            gpuLatency = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else {
+            std::fprintf(stderr, "usage: %s [--frames N] [--gpu-latency-us N]\n", argv[0]);
+            return 1;
+        }
+    }
+    frameCount = (std::max)(frameCount, 1u);
+
+    UnityPluginLoad(&g_UnityInterfaces);
+    FSRNullDeviceSetGpuLatency(gpuLatency);
+
+#if defined(FSR_2)
+    const uint32_t fsrVersion = 2;
+#else
+    const uint32_t fsrVersion = 3;
+#endif
+    if (!FSRQuery(fsrVersion)) {
+        std::fprintf(stderr, "FSRQuery(%u) found no provider\n", fsrVersion);
+        ++g_LogErrors;
+    }
+
+    const uint32_t instanceCounts[] = {1, 4, 16, 64};
+    for (uint32_t instanceCount : instanceCounts) {
+        Run(instanceCount, frameCount);
+    }
+    RunJitterFailure(frameCount);
+    RunReactiveDispatch(frameCount);
+    RunDispatchBatch(8, frameCount);
+    RunResize((std::min)(frameCount, 100u));
+    RunAsyncInit((std::min)(frameCount, 100u));
+    RunRenderResolution();
+    RunGovernor(frameCount);
+    FSRNullDeviceSetGpuLatency((std::max)(gpuLatency, 50u));
+    RunGpuTimestamps((std::min)(frameCount, 200u), (std::max)(gpuLatency, 50u));
+    FSRNullDeviceSetGpuLatency(gpuLatency);
+    RunMaxRenderSize();
+    RunMemoryBudget(8);
+    RunTrace((std::min)(frameCount, 100u));
+
+    if (g_DeviceEventCallback != nullptr) {
+        g_DeviceEventCallback(kUnityGfxDeviceEventShutdown);
+    }
+    GpuMemoryBudgetCounters gpuMemory = {};
+    FSRGetDeviceMemoryUsage(&gpuMemory);
+    if (gpuMemory.contextCount != 0 || gpuMemory.usedBytes != 0) {
+        std::fprintf(stderr, "%u contexts still charged to the GPU memory budget after shutdown\n", gpuMemory.contextCount);
+        ++g_LogErrors;
+    }
+    UnityPluginUnload();
+
+    if (g_LogErrors != 0) {
+        std::fprintf(stderr, "%llu plugin errors logged\n", static_cast<unsigned long long>(g_LogErrors));
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
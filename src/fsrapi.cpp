@@ -1,11 +1,17 @@
 #include "fsrapi.h"
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 
 #include "fsrunityplugin.h"
 #include "device.h"
+#include "instancetable.h"
+#include "trace.h"
+#if defined(FSR_BACKEND_ALL) || defined(FSR_BACKEND_NULL)
 #include "dllloader.h"
+#endif
 
 #include "ffx_api.hpp"
 #include "fsrapi_util.hpp"
@@ -18,48 +24,373 @@
 FfxApiResource ffxApiGetResource(void* resource, uint32_t state = FFX_API_RESOURCE_STATE_COMPUTE_READ, uint32_t additionalUsages = 0);
 FfxApiResource ffxApiGetResourceByID(UnityTextureID textureID, uint32_t state = FFX_API_RESOURCE_STATE_COMPUTE_READ, uint32_t additionalUsages = 0);
 
-FSRAPI& GetFSRInstance(uint32_t id)
+#if defined(FSR_BACKEND_VK) || defined(FSR_BACKEND_ALL)
+// Resource descriptions of the Vulkan images handed to FFX, keyed by (image, additional usages). Translating a
+// UnityVulkanImage walks the FFX format tables while render targets rarely change, so a description is reused
+// as long as the image Unity reports matches everything it was built from. An image Unity replaced under the
+// same handle only rebuilds its own entry. Only used by dispatches, on the render thread.
+class ImageDescriptionCache
 {
-    static std::unordered_map<uint32_t, std::unique_ptr<FSRAPI>> instances_map;
-    auto it = instances_map.find(id);
-    if (it == instances_map.end()) {
-        instances_map[id] = std::make_unique<FSRAPI>();
+public:
+    static constexpr size_t MaxEntries = 64;
+
+public:
+    FfxApiResourceDescription Get(const UnityVulkanImage& vulkanImage, uint32_t additionalUsages)
+    {
+        const Key key{vulkanImage.image, additionalUsages};
+        auto found = m_Entries.find(key);
+        if (found != m_Entries.end() && found->second.Matches(vulkanImage)) {
+            return found->second.description;
+        }
+
+        VkImageCreateInfo createInfo = {};
+        createInfo.imageType = vulkanImage.type;
+        createInfo.format = vulkanImage.format;
+        createInfo.extent = vulkanImage.extent;
+        createInfo.mipLevels = vulkanImage.mipCount;
+        createInfo.arrayLayers = vulkanImage.layers;
+        createInfo.samples = vulkanImage.samples;
+        createInfo.tiling = vulkanImage.tiling;
+        createInfo.usage = vulkanImage.usage;
+        createInfo.queueFamilyIndexCount = static_cast<IUnityGraphicsVulkanV2*>(Device::Instance().GetGraphicsInterfaces())->Instance().queueFamilyIndex;
+        createInfo.initialLayout = vulkanImage.layout;
+        createInfo.pNext = vulkanImage.image;
+        Entry entry{ffxApiGetImageResourceDescriptionVK(vulkanImage.image, createInfo, additionalUsages), vulkanImage.type, vulkanImage.format, vulkanImage.extent,
+            vulkanImage.samples, vulkanImage.tiling, vulkanImage.usage, vulkanImage.mipCount, vulkanImage.layers};
+
+        if (found != m_Entries.end()) {
+            found->second = entry;
+        } else {
+            // Images of old resolutions are never looked up again, start over rather than tracking their age.
+            if (m_Entries.size() >= MaxEntries) {
+                m_Entries.clear();
+            }
+            m_Entries.emplace(key, entry);
+        }
+        return entry.description;
     }
-    return *instances_map[id];
+
+private:
+    struct Key
+    {
+        VkImage image;
+        uint32_t additionalUsages;
+
+        bool operator==(const Key& other) const { return image == other.image && additionalUsages == other.additionalUsages; }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            return std::hash<const void*>()(reinterpret_cast<const void*>(key.image)) ^ (static_cast<size_t>(key.additionalUsages) << 1);
+        }
+    };
+
+    struct Entry
+    {
+        FfxApiResourceDescription description;
+        VkImageType type;
+        VkFormat format;
+        VkExtent3D extent;
+        VkSampleCountFlagBits samples;
+        VkImageTiling tiling;
+        VkImageUsageFlags usage;
+        int mipCount;
+        int layers;
+
+        bool Matches(const UnityVulkanImage& vulkanImage) const
+        {
+            return type == vulkanImage.type && format == vulkanImage.format && extent.width == vulkanImage.extent.width &&
+                extent.height == vulkanImage.extent.height && extent.depth == vulkanImage.extent.depth && samples == vulkanImage.samples &&
+                tiling == vulkanImage.tiling && usage == vulkanImage.usage && mipCount == vulkanImage.mipCount && layers == vulkanImage.layers;
+        }
+    };
+
+    std::unordered_map<Key, Entry, KeyHash> m_Entries;
+};
+
+static ImageDescriptionCache s_ImageDescriptionCache;
+#endif
+
+static InstanceTable<FSRAPI>& GetInstanceTable()
+{
+    static InstanceTable<FSRAPI> instances;
+    return instances;
 }
 
-uint64_t FSRAPI::Query(uint32_t fsrVersion)
+FSRAPI* GetFSRInstance(uint32_t id)
 {
-    uint64_t versionId = 0;
+    FSRAPI* instance = GetInstanceTable().Get(id);
+    if (instance == nullptr) {
+        FSR_ERROR("Instance ID out of range");
+    }
+    return instance;
+}
+
+FSRAPI* FindFSRInstance(uint32_t id)
+{
+    return GetInstanceTable().Find(id);
+}
+
+static JitterCache s_JitterCache;
+
+const JitterSequence* GetJitterSequence(int32_t renderWidth, int32_t displayWidth)
+{
+    return s_JitterCache.Get(renderWidth, displayWidth, [](int32_t renderWidth, int32_t displayWidth, JitterSequence& sequence) {
+        // The upscaler jitter queries do not need a context, so the sequence does not depend on any instance.
+        int32_t jitterPhaseCount = 0;
+        ffx::QueryDescUpscaleGetJitterPhaseCount getJitterPhaseDesc{};
+        getJitterPhaseDesc.renderWidth = static_cast<uint32_t>(renderWidth);
+        getJitterPhaseDesc.displayWidth = static_cast<uint32_t>(displayWidth);
+        getJitterPhaseDesc.pOutPhaseCount = &jitterPhaseCount;
+        if (ffxQuery(nullptr, &getJitterPhaseDesc.header) != FFX_API_RETURN_OK || jitterPhaseCount <= 0) {
+            FSR_ERROR("ffxQuery GetJitterPhaseCount failed");
+            return false;
+        }
+        sequence.resize(jitterPhaseCount);
+        for (int32_t i = 0; i < jitterPhaseCount; ++i) {
+            ffx::QueryDescUpscaleGetJitterOffset getJitterOffsetDesc{};
+            getJitterOffsetDesc.index = i;
+            getJitterOffsetDesc.phaseCount = jitterPhaseCount;
+            getJitterOffsetDesc.pOutX = &sequence[i][0];
+            getJitterOffsetDesc.pOutY = &sequence[i][1];
+            if (ffxQuery(nullptr, &getJitterOffsetDesc.header) != FFX_API_RETURN_OK) {
+                FSR_ERROR("ffxQuery GetJitterOffset failed");
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+// Providers reported by ffxQuery for the current device. Tables are immutable once published; a device
+// re-initialization publishes a new one and keeps the old alive, since readers may still hold it.
+static std::atomic<const FSRProviderTable*> s_ProviderTable = {nullptr};
+
+void EnumerateFSRProviders()
+{
+    static std::vector<std::unique_ptr<FSRProviderTable>> tables;
+    std::unique_ptr<FSRProviderTable> table(new FSRProviderTable{});
+    table->renderer = Device::Instance().GetDeviceType();
+
     ffx::QueryDescGetVersions versionQuery{};
     versionQuery.createDescType = FFX_API_CREATE_CONTEXT_DESC_TYPE_UPSCALE;
-    if (Device::Instance().GetDeviceType() == kUnityGfxRendererD3D12) {
+    if (table->renderer == kUnityGfxRendererD3D12) {
         versionQuery.device = Device::Instance().GetNativeDevice();
     }
     uint64_t versionCount = 0;
     versionQuery.outputCount = &versionCount;
-    ffxQuery(nullptr, &versionQuery.header);
-
-    std::vector<const char*> versionNames;
-    std::vector<uint64_t> fsrVersionIds;
-    fsrVersionIds.resize(versionCount);
-    versionNames.resize(versionCount);
-    versionQuery.versionIds = fsrVersionIds.data();
-    versionQuery.versionNames = versionNames.data();
-    ffxQuery(nullptr, &versionQuery.header);
+    if (ffxQuery(nullptr, &versionQuery.header) != FFX_API_RETURN_OK) {
+        FSR_ERROR("ffxQuery GetVersions failed");
+        versionCount = 0;
+    }
 
+    std::vector<const char*> versionNames(versionCount);
+    std::vector<uint64_t> fsrVersionIds(versionCount);
+    if (versionCount > 0) {
+        versionQuery.versionIds = fsrVersionIds.data();
+        versionQuery.versionNames = versionNames.data();
+        if (ffxQuery(nullptr, &versionQuery.header) != FFX_API_RETURN_OK) {
+            FSR_ERROR("ffxQuery GetVersions failed");
+            versionCount = 0;
+        }
+    }
     for (size_t i = 0; i < versionCount; ++i) {
-        if (static_cast<uint32_t>(versionNames[i][0] - '0') == fsrVersion) {
-            versionId = fsrVersionIds[i];
-            break;
+        FSRProvider provider{};
+        provider.versionId = fsrVersionIds[i];
+        provider.name = versionNames[i] != nullptr ? versionNames[i] : "";
+        provider.majorVersion = provider.name.empty() ? 0 : static_cast<uint32_t>(provider.name[0] - '0');
+        table->providers.push_back(provider);
+    }
+
+    s_ProviderTable.store(table.get(), std::memory_order_release);
+    tables.push_back(std::move(table));
+}
+
+const FSRProviderTable* GetFSRProviders()
+{
+    const FSRProviderTable* table = s_ProviderTable.load(std::memory_order_acquire);
+#if defined(FSR_BACKEND_ALL) || defined(FSR_BACKEND_NULL)
+    if (table == nullptr) {
+        DllLoader::WaitForPreload();
+        table = s_ProviderTable.load(std::memory_order_acquire);
+    }
+#endif
+    return table;
+}
+
+static std::atomic<uint64_t> s_HostMemoryLimit = {0};
+
+static void* HostArenaAlloc(void* pUserData, uint64_t size)
+{
+    return static_cast<HostArena*>(pUserData)->Allocate(size);
+}
+
+static void HostArenaDealloc(void* pUserData, void* pMem)
+{
+    static_cast<HostArena*>(pUserData)->Free(pMem);
+}
+
+static ffxAllocationCallbacks GetAllocationCallbacks(HostArena* hostArena)
+{
+    return ffxAllocationCallbacks{hostArena, HostArenaAlloc, HostArenaDealloc};
+}
+
+// The arena outlives the context, its memory is freed in one go after the provider has destroyed it. The GPU
+// memory is released from the budget right away instead, so FSRAPI::Init sees it gone without having to retire
+// releases off the render thread.
+static void ReleaseContext(uint64_t fenceValue, ffx::Context context, std::shared_ptr<HostArena> hostArena, std::shared_ptr<GpuMemoryCharge> gpuMemory)
+{
+    Device::Instance().DeferRelease(fenceValue, [context, hostArena]() mutable {
+        ffxAllocationCallbacks callbacks = GetAllocationCallbacks(hostArena.get());
+        ffx::DestroyContext(context, &callbacks);
+    });
+}
+
+// Result of one context creation, written by the creating thread and read once it has finished.
+struct CreatedContext
+{
+    ffx::Context context = nullptr;
+    ffx::ReturnCode error = ffx::ReturnCode::Ok;
+};
+
+// Recently used contexts parked by FSRAPI::Init, so switching back to a configuration (alt-tab, window resize)
+// reuses its context instead of creating a new one. Parked contexts are kept in LRU order; evicted ones are
+// handed to the device's deferred release queue and destroyed once their last submission has completed.
+class ContextPool
+{
+public:
+    static constexpr uint32_t DefaultCapacity = 2;
+
+public:
+    void Park(const ContextKey& key, ffx::Context context, uint64_t fenceValue, std::shared_ptr<HostArena> hostArena, std::shared_ptr<GpuMemoryCharge> gpuMemory)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Parked.push_back(Entry{key, context, fenceValue, std::move(hostArena), std::move(gpuMemory)});
+        Trim();
+    }
+
+    bool Take(const ContextKey& key, ffx::Context& context, uint64_t& fenceValue, std::shared_ptr<HostArena>& hostArena, std::shared_ptr<GpuMemoryCharge>& gpuMemory)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (auto it = m_Parked.rbegin(); it != m_Parked.rend(); ++it) {
+            if (it->key == key) {
+                context = it->context;
+                fenceValue = it->fenceValue;
+                hostArena = std::move(it->hostArena);
+                gpuMemory = std::move(it->gpuMemory);
+                m_Parked.erase(std::next(it).base());
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void SetCapacity(uint32_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Capacity = capacity;
+        Trim();
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (Entry& entry : m_Parked) {
+            ReleaseEntry(entry);
+        }
+        m_Parked.clear();
+    }
+
+    // Releases every parked context, returns whether there was any.
+    bool Evict()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        const bool evicted = !m_Parked.empty();
+        for (Entry& entry : m_Parked) {
+            ReleaseEntry(entry);
         }
+        m_Parked.clear();
+        return evicted;
     }
-    return versionId;
+
+private:
+    struct Entry
+    {
+        ContextKey key;
+        ffx::Context context;
+        uint64_t fenceValue;
+        std::shared_ptr<HostArena> hostArena;
+        std::shared_ptr<GpuMemoryCharge> gpuMemory;
+    };
+
+    void Trim()
+    {
+        while (m_Parked.size() > m_Capacity) {
+            ReleaseEntry(m_Parked.front());
+            m_Parked.erase(m_Parked.begin());
+        }
+    }
+
+    static void ReleaseEntry(const Entry& entry)
+    {
+        ReleaseContext(entry.fenceValue, entry.context, entry.hostArena, entry.gpuMemory);
+    }
+
+private:
+    std::mutex m_Mutex;
+    uint32_t m_Capacity = DefaultCapacity;
+    std::vector<Entry> m_Parked;
+};
+
+static ContextPool s_ContextPool;
+
+void SetFSRContextPoolCapacity(uint32_t capacity)
+{
+    s_ContextPool.SetCapacity(capacity);
+}
+
+void ReleaseFSRContextPool()
+{
+    s_ContextPool.Clear();
+}
+
+void SetFSRHostMemoryLimit(uint64_t bytes)
+{
+    s_HostMemoryLimit.store(bytes, std::memory_order_relaxed);
+}
+
+uint64_t FSRAPI::Query(uint32_t fsrVersion)
+{
+    const FSRProviderTable* table = GetFSRProviders();
+    if (table != nullptr) {
+        for (const FSRProvider& provider : table->providers) {
+            if (provider.majorVersion == fsrVersion) {
+                return provider.versionId;
+            }
+        }
+    }
+    return 0;
 }
 
 ffx::ReturnCode FSRAPI::Init(const InitParam& initParam, uint32_t fsrVersion)
 {
-    Destroy();
+    FSR_TRACE_SCOPE("FSRAPI::Init");
+    // A sequence that failed before, e.g. while the FFX libraries were loading, is tried again.
+    s_JitterCache.ClearFailures();
+    m_InitTask.Reset();
+    std::unique_lock<std::mutex> contextLock(m_ContextMutex);
+    const bool replacing = m_ContextCreated;
+    const ContextKey replacedKey = m_ContextKey;
+    uint64_t replacedBytes = 0;
+    if (m_ContextCreated) {
+        std::shared_ptr<GpuMemoryCharge> replacedGpuMemory = std::atomic_exchange(&m_GpuMemory, std::shared_ptr<GpuMemoryCharge>());
+        replacedBytes = replacedGpuMemory != nullptr ? replacedGpuMemory->GetUsage().totalBytes : 0;
+        s_ContextPool.Park(m_ContextKey, m_Context, m_FenceValue, std::atomic_exchange(&m_HostArena, std::shared_ptr<HostArena>()),
+            std::move(replacedGpuMemory));
+        m_ContextCreated = false;
+    }
 
     // get version info from ffxapi
     ffx::CreateContextDescOverrideVersion versionOverride{};
@@ -72,167 +403,344 @@ ffx::ReturnCode FSRAPI::Init(const InitParam& initParam, uint32_t fsrVersion)
 
     m_Reset = true;
 
+    m_RenderSizeLimits = GetRenderSizeLimits(initParam.displaySizeWidth, initParam.displaySizeHeight,
+        initParam.maxRenderSizeWidth, initParam.maxRenderSizeHeight, initParam.maxUpscaleRatio);
+    m_Governor.SetLimits(m_RenderSizeLimits);
+    m_GpuTimers.Reset();
+    m_ContextKey = ContextKey{initParam.displaySizeWidth, initParam.displaySizeHeight,
+        m_RenderSizeLimits.maxWidth, m_RenderSizeLimits.maxHeight, initParam.flags, versionOverride.versionId};
+    std::shared_ptr<HostArena> hostArena;
+    std::shared_ptr<GpuMemoryCharge> gpuMemory;
+    if (s_ContextPool.Take(m_ContextKey, m_Context, m_FenceValue, hostArena, gpuMemory)) {
+        std::atomic_store(&m_HostArena, hostArena);
+        std::atomic_store(&m_GpuMemory, gpuMemory);
+        m_ContextCreated = true;
+        contextLock.unlock();
+        m_InitTask.Start([]() { return true; }, [](bool) {}, []() {}, false);
+        return ffx::ReturnCode::Ok;
+    }
+    contextLock.unlock();
+
     ffx::CreateContextDescUpscale createFsr{};
     createFsr.maxUpscaleSize = {initParam.displaySizeWidth, initParam.displaySizeHeight};
-    createFsr.maxRenderSize = {initParam.displaySizeWidth, initParam.displaySizeHeight};
+    createFsr.maxRenderSize = {m_RenderSizeLimits.maxWidth, m_RenderSizeLimits.maxHeight};
     createFsr.flags = initParam.flags;
 
-    ffx::ReturnCode retCode = ffx::ReturnCode::Error;
-    UnityGfxRenderer renderer = Device::Instance().GetDeviceType();
-    switch (renderer) {
-#if defined(FSR_BACKEND_DX12) || defined(FSR_BACKEND_ALL)
-    case kUnityGfxRendererD3D12:
-    {
-        ffx::CreateBackendDX12Desc backendDesc{};
-        backendDesc.header.type = FFX_API_CREATE_CONTEXT_DESC_TYPE_BACKEND_DX12;
-        backendDesc.device = static_cast<ID3D12Device*>(Device::Instance().GetNativeDevice());
-        if (fsrVersion != 0) {
-            retCode = ffx::CreateContext(m_Context, nullptr, createFsr, backendDesc, versionOverride);
-        } else {
-            retCode = ffx::CreateContext(m_Context, nullptr, createFsr, backendDesc);
+    // Parked contexts, the one just replaced included, stay charged until they are evicted. If the new one does
+    // not fit even without the replaced one, the whole pool is evicted; if it only fits without it, just the
+    // replaced one is released.
+    const uint64_t estimatedBytes = EstimateUpscalerMemory(createFsr.maxRenderSize.width, createFsr.maxRenderSize.height,
+        createFsr.maxUpscaleSize.width, createFsr.maxUpscaleSize.height);
+    if (!GpuMemoryBudget::Instance().Fits(estimatedBytes, replacedBytes)) {
+        s_ContextPool.Evict();
+    } else if (replacing && !GpuMemoryBudget::Instance().Fits(estimatedBytes)) {
+        ffx::Context replacedContext = nullptr;
+        uint64_t replacedFenceValue = 0;
+        if (s_ContextPool.Take(replacedKey, replacedContext, replacedFenceValue, hostArena, gpuMemory)) {
+            ReleaseContext(replacedFenceValue, replacedContext, std::move(hostArena), std::move(gpuMemory));
         }
-        break;
     }
+    gpuMemory = GpuMemoryBudget::Instance().Charge(estimatedBytes);
+    if (gpuMemory == nullptr) {
+        return ffx::ReturnCode::ErrorMemory;
+    }
+    std::atomic_store(&m_GpuMemory, gpuMemory);
+    hostArena = std::make_shared<HostArena>(s_HostMemoryLimit.load(std::memory_order_relaxed));
+    std::atomic_store(&m_HostArena, hostArena);
+
+    // The creating thread only writes into created, commit() hands it to the instance.
+    std::shared_ptr<CreatedContext> created = std::make_shared<CreatedContext>();
+    m_InitTask.Start([created, createFsr, versionOverride, fsrVersion, hostArena, gpuMemory]() mutable {
+        FSR_TRACE_SCOPE("ffxCreateContext");
+        ffxAllocationCallbacks callbacks = GetAllocationCallbacks(hostArena.get());
+        ffx::ReturnCode retCode = ffx::ReturnCode::Error;
+        UnityGfxRenderer renderer = Device::Instance().GetDeviceType();
+        switch (renderer) {
+#if defined(FSR_BACKEND_DX12) || defined(FSR_BACKEND_ALL)
+        case kUnityGfxRendererD3D12:
+        {
+            ffx::CreateBackendDX12Desc backendDesc{};
+            backendDesc.header.type = FFX_API_CREATE_CONTEXT_DESC_TYPE_BACKEND_DX12;
+            backendDesc.device = static_cast<ID3D12Device*>(Device::Instance().GetNativeDevice());
+            if (fsrVersion != 0) {
+                retCode = ffx::CreateContext(created->context, &callbacks, createFsr, backendDesc, versionOverride);
+            } else {
+                retCode = ffx::CreateContext(created->context, &callbacks, createFsr, backendDesc);
+            }
+            break;
+        }
 #endif
 #if defined(FSR_BACKEND_VK) || defined(FSR_BACKEND_ALL)
-    case kUnityGfxRendererVulkan:
-    {
-        ffx::CreateBackendVKDesc backendDesc{};
-        backendDesc.header.type = FFX_API_CREATE_CONTEXT_DESC_TYPE_BACKEND_VK;
-        backendDesc.vkDevice = static_cast<VkDevice>(Device::Instance().GetNativeDevice());
-        backendDesc.vkPhysicalDevice = static_cast<IUnityGraphicsVulkanV2*>(Device::Instance().GetGraphicsInterfaces())->Instance().physicalDevice;
-        backendDesc.vkDeviceProcAddr = vkGetDeviceProcAddr;
-        if (fsrVersion != 0) {
-            retCode = ffx::CreateContext(m_Context, nullptr, createFsr, backendDesc, versionOverride);
-        } else {
-            retCode = ffx::CreateContext(m_Context, nullptr, createFsr, backendDesc);
+        case kUnityGfxRendererVulkan:
+        {
+            ffx::CreateBackendVKDesc backendDesc{};
+            backendDesc.header.type = FFX_API_CREATE_CONTEXT_DESC_TYPE_BACKEND_VK;
+            backendDesc.vkDevice = static_cast<VkDevice>(Device::Instance().GetNativeDevice());
+            backendDesc.vkPhysicalDevice = static_cast<IUnityGraphicsVulkanV2*>(Device::Instance().GetGraphicsInterfaces())->Instance().physicalDevice;
+            backendDesc.vkDeviceProcAddr = vkGetDeviceProcAddr;
+            if (fsrVersion != 0) {
+                retCode = ffx::CreateContext(created->context, &callbacks, createFsr, backendDesc, versionOverride);
+            } else {
+                retCode = ffx::CreateContext(created->context, &callbacks, createFsr, backendDesc);
+            }
+            break;
         }
-        break;
-    }
 #endif
-    default:
-        FSR_ERROR("Unsupported fsrapi backend");
-        break;
-    }
+#if defined(FSR_BACKEND_NULL)
+        case kUnityGfxRendererNull:
+        {
+            if (fsrVersion != 0) {
+                retCode = ffx::CreateContext(created->context, &callbacks, createFsr, versionOverride);
+            } else {
+                retCode = ffx::CreateContext(created->context, &callbacks, createFsr);
+            }
+            break;
+        }
+#endif
+        default:
+            FSR_ERROR("Unsupported fsrapi backend");
+            break;
+        }
 
-    if (retCode == ffx::ReturnCode::Ok) {
-        m_ContextCreated = true;
-    } else {
-        FSR_ERROR("ffxCreateContext Init failed");
-    }
-    return retCode;
+        created->error = retCode;
+        if (retCode != ffx::ReturnCode::Ok) {
+            FSR_ERROR("ffxCreateContext Init failed");
+            return false;
+        }
+        hostArena->SetTransient(true);
+        // Providers that cannot report their usage keep the estimate charged.
+        FfxApiEffectMemoryUsage memoryUsage{};
+        ffx::QueryDescUpscaleGetGPUMemoryUsage memoryQuery{};
+        memoryQuery.gpuMemoryUsageUpscaler = &memoryUsage;
+        if (ffx::Query(created->context, memoryQuery) == ffx::ReturnCode::Ok) {
+            gpuMemory->Update(GpuMemoryUsage{memoryUsage.totalUsageInBytes, memoryUsage.aliasableUsageInBytes});
+        }
+        return true;
+    }, [this, created](bool succeeded) {
+        m_InitError = created->error;
+        if (succeeded) {
+            std::lock_guard<std::mutex> lock(m_ContextMutex);
+            m_Context = created->context;
+            m_ContextCreated = true;
+        } else {
+            std::atomic_store(&m_GpuMemory, std::shared_ptr<GpuMemoryCharge>());
+        }
+    }, [created, hostArena, gpuMemory]() {
+        // Superseded before its first dispatch, so nothing on the GPU refers to it.
+        ReleaseContext(0, created->context, hostArena, gpuMemory);
+    }, FSRUnityPlugin::AsyncInit.load(std::memory_order_relaxed));
+    return m_InitTask.IsPending() ? static_cast<ffx::ReturnCode>(FSRUnityPlugin::ReturnNotReady) : m_InitError;
 }
 
 void FSRAPI::Destroy()
 {
+    m_InitTask.Reset();
+    std::lock_guard<std::mutex> lock(m_ContextMutex);
     if (m_ContextCreated) {
-        Device::Instance().Wait(m_FenceValue);
-        ffx::DestroyContext(m_Context);
+        ReleaseContext(m_FenceValue, m_Context, m_HostArena, m_GpuMemory);
         m_ContextCreated = false;
     }
+    std::atomic_store(&m_HostArena, std::shared_ptr<HostArena>());
+    std::atomic_store(&m_GpuMemory, std::shared_ptr<GpuMemoryCharge>());
 }
 
-std::array<float, 2> FSRAPI::GetJitterOffset(const int32_t index, const int32_t renderWidth, const int32_t displayWidth)
+HostArenaCounters FSRAPI::GetHostMemoryUsage() const
 {
-    std::array<float, 2> jitterOffset{};
-    if (m_ContextCreated) {
-        ffx::ReturnCode retCode;
-        int32_t jitterPhaseCount;
-        ffx::QueryDescUpscaleGetJitterPhaseCount getJitterPhaseDesc{};
-        getJitterPhaseDesc.displayWidth = renderWidth;
-        getJitterPhaseDesc.renderWidth = displayWidth;
-        getJitterPhaseDesc.pOutPhaseCount = &jitterPhaseCount;
+    std::shared_ptr<HostArena> hostArena = std::atomic_load(&m_HostArena);
+    return hostArena != nullptr ? hostArena->GetCounters() : HostArenaCounters{};
+}
 
-        retCode = ffx::Query(m_Context, getJitterPhaseDesc);
-        if (retCode != ffx::ReturnCode::Ok) {
-            FSR_ERROR("ffxQuery GetJitterPhaseCount failed");
+GpuMemoryUsage FSRAPI::GetGpuMemoryUsage() const
+{
+    std::shared_ptr<GpuMemoryCharge> gpuMemory = std::atomic_load(&m_GpuMemory);
+    return gpuMemory != nullptr ? gpuMemory->GetUsage() : GpuMemoryUsage{};
+}
+
+GovernorResult FSRAPI::GetGovernedRenderSize() const
+{
+    GovernorResult result = {};
+    m_Governor.GetRenderSize(result.renderSizeWidth, result.renderSizeHeight);
+    const JitterSequence* sequence = GetJitterSequence(static_cast<int32_t>(result.renderSizeWidth), static_cast<int32_t>(m_RenderSizeLimits.displayWidth));
+    result.jitterPhaseCount = sequence != nullptr ? static_cast<int32_t>(sequence->size()) : 0;
+    return result;
+}
+
+// An instance created for a specific provider asks its context once it exists, the others the default provider.
+// The caller holds m_ContextMutex, so the context cannot be parked or released while it is queried.
+static ffxContext* GetQueryContext(const ffx::Context& context, const ContextKey& contextKey, bool contextCreated, uint64_t& versionId)
+{
+    versionId = contextCreated ? contextKey.versionId : 0;
+    return versionId != 0 ? const_cast<ffx::Context*>(&context) : nullptr;
+}
+
+bool FSRAPI::GetRenderResolution(uint32_t qualityMode, uint32_t displayWidth, uint32_t displayHeight, RenderResolution& resolution) const
+{
+    static RenderResolutionCache cache;
+    std::lock_guard<std::mutex> lock(m_ContextMutex);
+    uint64_t versionId = 0;
+    ffxContext* context = GetQueryContext(m_Context, m_ContextKey, m_ContextCreated, versionId);
+    return cache.Get(qualityMode, displayWidth, displayHeight, versionId, resolution, [&](RenderResolution& resolved) {
+        ffx::QueryDescUpscaleGetUpscaleRatioFromQualityMode ratioDesc{};
+        ratioDesc.qualityMode = qualityMode;
+        ratioDesc.pOutUpscaleRatio = &resolved.upscaleRatio;
+        ffx::QueryDescUpscaleGetRenderResolutionFromQualityMode resolutionDesc{};
+        resolutionDesc.displayWidth = displayWidth;
+        resolutionDesc.displayHeight = displayHeight;
+        resolutionDesc.qualityMode = qualityMode;
+        resolutionDesc.pOutRenderWidth = &resolved.width;
+        resolutionDesc.pOutRenderHeight = &resolved.height;
+        if (ffxQuery(context, &ratioDesc.header) != FFX_API_RETURN_OK || ffxQuery(context, &resolutionDesc.header) != FFX_API_RETURN_OK) {
+            FSR_ERROR("ffxQuery GetRenderResolutionFromQualityMode failed");
+            return false;
         }
-        ffx::QueryDescUpscaleGetJitterOffset getJitterOffsetDesc{};
-        getJitterOffsetDesc.index = index;
-        getJitterOffsetDesc.phaseCount = jitterPhaseCount;
-        getJitterOffsetDesc.pOutX = &jitterOffset[0];
-        getJitterOffsetDesc.pOutY = &jitterOffset[1];
+        return true;
+    });
+}
 
-        retCode = ffx::Query(m_Context, getJitterOffsetDesc);
-    }
-    return jitterOffset;
+bool FSRAPI::GetUpscaleRatio(uint32_t qualityMode, float& ratio) const
+{
+    static UpscaleRatioCache cache;
+    std::lock_guard<std::mutex> lock(m_ContextMutex);
+    uint64_t versionId = 0;
+    ffxContext* context = GetQueryContext(m_Context, m_ContextKey, m_ContextCreated, versionId);
+    return cache.Get(qualityMode, 0, 0, versionId, ratio, [&](float& resolved) {
+        ffx::QueryDescUpscaleGetUpscaleRatioFromQualityMode ratioDesc{};
+        ratioDesc.qualityMode = qualityMode;
+        ratioDesc.pOutUpscaleRatio = &resolved;
+        if (ffxQuery(context, &ratioDesc.header) != FFX_API_RETURN_OK) {
+            FSR_ERROR("ffxQuery GetUpscaleRatioFromQualityMode failed");
+            return false;
+        }
+        return true;
+    });
 }
 
 ffx::ReturnCode FSRAPI::GenerateReactiveMask(const GenReactiveParam& genReactiveParam)
 {
-    if (m_ContextCreated) {
+    FSR_TRACE_SCOPE("FSRAPI::GenerateReactiveMask");
+    if (m_InitTask.IsReady()) {
+        m_GpuTimers.Collect();
         void* commandList = Device::Instance().GetNativeCommandList();
 
         ffx::DispatchDescUpscaleGenerateReactiveMask genReactiveDesc{};
-        genReactiveDesc.commandList = commandList;
-        genReactiveDesc.colorOpaqueOnly = ffxApiGetResource(genReactiveParam.colorOpaqueOnly);
-        //genReactiveDesc.colorOpaqueOnly = ffxApiGetResourceByID(m_TextureIDs[TextureName::COLOR_OPAQUE_ONLY]);
-        genReactiveDesc.colorPreUpscale = ffxApiGetResource(genReactiveParam.colorPreUpscale);
-        //genReactiveDesc.colorPreUpscale = ffxApiGetResourceByID(m_TextureIDs[TextureName::COLOR_PRE_UPSCALE]);
-        genReactiveDesc.outReactive = ffxApiGetResource(genReactiveParam.outReactive, FFX_API_RESOURCE_STATE_UNORDERED_ACCESS);
-        //genReactiveDesc.outReactive = ffxApiGetResourceByID(m_TextureIDs[TextureName::REACTIVE], FFX_API_RESOURCE_STATE_UNORDERED_ACCESS);
-        genReactiveDesc.renderSize.width = genReactiveParam.renderSizeWidth;
-        genReactiveDesc.renderSize.height = genReactiveParam.renderSizeHeight;
-        genReactiveDesc.scale = genReactiveParam.scale;
-        genReactiveDesc.cutoffThreshold = genReactiveParam.cutoffThreshold;
-        genReactiveDesc.binaryValue = genReactiveParam.binaryValue;
-        genReactiveDesc.flags = genReactiveParam.flags;
-        ffx::ReturnCode retCode = ffx::Dispatch(m_Context, genReactiveDesc);
-        if (retCode != ffx::ReturnCode::Ok) {
-            FSR_ERROR("ffxDispatch GenerateReactiveMask failed");
-        }
+        SetupGenerateReactiveMask(genReactiveDesc, genReactiveParam, commandList);
+        Device::Instance().FlushResourceBarriers(commandList);
+        uint64_t timer = Device::Instance().BeginGpuTimer(commandList);
+        ffx::ReturnCode retCode = RecordGenerateReactiveMask(genReactiveDesc);
+        Device::Instance().EndGpuTimer(commandList, timer);
         m_FenceValue = Device::Instance().ExecuteCommandList(commandList);
+        m_GpuTimers.Submit(GPU_TIMER_REACTIVE_MASK, timer, m_FenceValue);
         return retCode;
+    } else if (m_InitTask.IsPending()) {
+        return static_cast<ffx::ReturnCode>(FSRUnityPlugin::ReturnNotReady);
     } else
         return ffx::ReturnCode::Error;
 }
 
 ffx::ReturnCode FSRAPI::Dispatch(const DispatchParam& dispatchParam)
 {
-    if (m_ContextCreated) {
+    FSR_TRACE_SCOPE("FSRAPI::Dispatch");
+    if (m_InitTask.IsReady()) {
+        m_GpuTimers.Collect();
         void* commandList = Device::Instance().GetNativeCommandList();
 
         ffx::DispatchDescUpscale dispatchDesc{};
-        dispatchDesc.commandList = commandList;
-        dispatchDesc.color = ffxApiGetResource(dispatchParam.color);
-        //dispatchDesc.color = ffxApiGetResourceByID(m_TextureIDs[TextureName::COLOR]);
-        dispatchDesc.depth = ffxApiGetResource(dispatchParam.depth);
-        //dispatchDesc.depth = ffxApiGetResourceByID(m_TextureIDs[TextureName::DEPTH]);
-        dispatchDesc.motionVectors = ffxApiGetResource(dispatchParam.motionVectors);
-        //dispatchDesc.motionVectors = ffxApiGetResourceByID(m_TextureIDs[TextureName::MOTION_VECTORS]);
-        dispatchDesc.reactive = ffxApiGetResource(dispatchParam.reactive);
-        //dispatchDesc.reactive = ffxApiGetResourceByID(m_TextureIDs[TextureName::REACTIVE]);
-        dispatchDesc.transparencyAndComposition = ffxApiGetResource(dispatchParam.transparencyAndComposition);
-        //dispatchDesc.transparencyAndComposition = ffxApiGetResourceByID(m_TextureIDs[TextureName::TRANSPARENT_AND_COMPOSITION]);
-        dispatchDesc.output = ffxApiGetResource(dispatchParam.output, FFX_API_RESOURCE_STATE_UNORDERED_ACCESS);
-        //dispatchDesc.output = ffxApiGetResourceByID(m_TextureIDs[TextureName::OUTPUT], FFX_API_RESOURCE_STATE_UNORDERED_ACCESS);
-        dispatchDesc.jitterOffset.x = dispatchParam.jitterOffsetX;
-        dispatchDesc.jitterOffset.y = dispatchParam.jitterOffsetY;
-        dispatchDesc.motionVectorScale.x = dispatchParam.motionVectorScaleX;
-        dispatchDesc.motionVectorScale.y = dispatchParam.motionVectorScaleY;
-        dispatchDesc.reset = m_Reset;
-        dispatchDesc.enableSharpening = dispatchParam.enableSharpening;
-        dispatchDesc.sharpness = dispatchParam.sharpness;
-        dispatchDesc.frameTimeDelta = dispatchParam.frameTimeDelta;
-        dispatchDesc.preExposure = dispatchParam.preExposure;
-        dispatchDesc.renderSize.width = dispatchParam.renderSizeWidth;
-        dispatchDesc.renderSize.height = dispatchParam.renderSizeHeight;
-        dispatchDesc.cameraFovAngleVertical = dispatchParam.cameraFovAngleVertical;
-        dispatchDesc.cameraFar = dispatchParam.cameraFar;
-        dispatchDesc.cameraNear = dispatchParam.cameraNear;
-        dispatchDesc.flags = 0;
-
+        SetupDispatch(dispatchDesc, dispatchParam, commandList);
         m_Reset = false;
-        ffx::ReturnCode retCode = ffx::Dispatch(m_Context, dispatchDesc);
-        if (retCode != ffx::ReturnCode::Ok) {
-            FSR_ERROR("ffxDispatch Dispatch failed");
-        }
+        Device::Instance().FlushResourceBarriers(commandList);
+        uint64_t timer = Device::Instance().BeginGpuTimer(commandList);
+        ffx::ReturnCode retCode = RecordDispatch(dispatchDesc);
+        Device::Instance().EndGpuTimer(commandList, timer);
         m_FenceValue = Device::Instance().ExecuteCommandList(commandList);
+        m_GpuTimers.Submit(GPU_TIMER_UPSCALE, timer, m_FenceValue);
         return retCode;
+    } else if (m_InitTask.IsPending()) {
+        return static_cast<ffx::ReturnCode>(FSRUnityPlugin::ReturnNotReady);
     } else
         return ffx::ReturnCode::Error;
 }
 
+ffx::ReturnCode FSRAPI::GenerateReactiveMaskAndDispatch(const ReactiveDispatchParam& reactiveDispatchParam)
+{
+    FSR_TRACE_SCOPE("FSRAPI::GenerateReactiveMaskAndDispatch");
+    return FSRSubmission<FSRAPI>::GenerateReactiveMaskAndDispatch(*this, reactiveDispatchParam);
+}
+
+ffx::ReturnCode FSRAPI::RecordGenerateReactiveMask(const ffx::DispatchDescUpscaleGenerateReactiveMask& genReactiveDesc)
+{
+    ffx::ReturnCode retCode = ffx::Dispatch(m_Context, genReactiveDesc);
+    if (retCode != ffx::ReturnCode::Ok) {
+        FSR_ERROR("ffxDispatch GenerateReactiveMask failed");
+    }
+    return retCode;
+}
+
+ffx::ReturnCode FSRAPI::RecordDispatch(const ffx::DispatchDescUpscale& dispatchDesc)
+{
+    ffx::ReturnCode retCode = ffx::Dispatch(m_Context, dispatchDesc);
+    if (retCode != ffx::ReturnCode::Ok) {
+        FSR_ERROR("ffxDispatch Dispatch failed");
+    }
+    return retCode;
+}
+
+void FSRAPI::SetupGenerateReactiveMask(ffx::DispatchDescUpscaleGenerateReactiveMask& genReactiveDesc, const GenReactiveParam& genReactiveParam, void* commandList)
+{
+    genReactiveDesc.commandList = commandList;
+    genReactiveDesc.colorOpaqueOnly = ffxApiGetResource(genReactiveParam.colorOpaqueOnly);
+    //genReactiveDesc.colorOpaqueOnly = ffxApiGetResourceByID(m_TextureIDs[TextureName::COLOR_OPAQUE_ONLY]);
+    genReactiveDesc.colorPreUpscale = ffxApiGetResource(genReactiveParam.colorPreUpscale);
+    //genReactiveDesc.colorPreUpscale = ffxApiGetResourceByID(m_TextureIDs[TextureName::COLOR_PRE_UPSCALE]);
+    genReactiveDesc.outReactive = ffxApiGetResource(genReactiveParam.outReactive, FFX_API_RESOURCE_STATE_UNORDERED_ACCESS);
+    //genReactiveDesc.outReactive = ffxApiGetResourceByID(m_TextureIDs[TextureName::REACTIVE], FFX_API_RESOURCE_STATE_UNORDERED_ACCESS);
+    genReactiveDesc.renderSize.width = genReactiveParam.renderSizeWidth;
+    genReactiveDesc.renderSize.height = genReactiveParam.renderSizeHeight;
+    genReactiveDesc.scale = genReactiveParam.scale;
+    genReactiveDesc.cutoffThreshold = genReactiveParam.cutoffThreshold;
+    genReactiveDesc.binaryValue = genReactiveParam.binaryValue;
+    genReactiveDesc.flags = genReactiveParam.flags;
+}
+
+void FSRAPI::SetupDispatch(ffx::DispatchDescUpscale& dispatchDesc, const DispatchParam& dispatchParam, void* commandList, const FfxApiResource* reactive)
+{
+    dispatchDesc.commandList = commandList;
+    dispatchDesc.color = ffxApiGetResource(dispatchParam.color);
+    //dispatchDesc.color = ffxApiGetResourceByID(m_TextureIDs[TextureName::COLOR]);
+    dispatchDesc.depth = ffxApiGetResource(dispatchParam.depth);
+    //dispatchDesc.depth = ffxApiGetResourceByID(m_TextureIDs[TextureName::DEPTH]);
+    dispatchDesc.motionVectors = ffxApiGetResource(dispatchParam.motionVectors);
+    //dispatchDesc.motionVectors = ffxApiGetResourceByID(m_TextureIDs[TextureName::MOTION_VECTORS]);
+    dispatchDesc.reactive = reactive != nullptr ? *reactive : ffxApiGetResource(dispatchParam.reactive);
+    //dispatchDesc.reactive = ffxApiGetResourceByID(m_TextureIDs[TextureName::REACTIVE]);
+    dispatchDesc.transparencyAndComposition = ffxApiGetResource(dispatchParam.transparencyAndComposition);
+    //dispatchDesc.transparencyAndComposition = ffxApiGetResourceByID(m_TextureIDs[TextureName::TRANSPARENT_AND_COMPOSITION]);
+    dispatchDesc.output = ffxApiGetResource(dispatchParam.output, FFX_API_RESOURCE_STATE_UNORDERED_ACCESS);
+    //dispatchDesc.output = ffxApiGetResourceByID(m_TextureIDs[TextureName::OUTPUT], FFX_API_RESOURCE_STATE_UNORDERED_ACCESS);
+    dispatchDesc.jitterOffset.x = dispatchParam.jitterOffsetX;
+    dispatchDesc.jitterOffset.y = dispatchParam.jitterOffsetY;
+    dispatchDesc.motionVectorScale.x = dispatchParam.motionVectorScaleX;
+    dispatchDesc.motionVectorScale.y = dispatchParam.motionVectorScaleY;
+    dispatchDesc.reset = m_Reset;
+    dispatchDesc.enableSharpening = dispatchParam.enableSharpening;
+    dispatchDesc.sharpness = dispatchParam.sharpness;
+    dispatchDesc.frameTimeDelta = dispatchParam.frameTimeDelta;
+    dispatchDesc.preExposure = dispatchParam.preExposure;
+    dispatchDesc.renderSize.width = dispatchParam.renderSizeWidth;
+    dispatchDesc.renderSize.height = dispatchParam.renderSizeHeight;
+    ClampRenderSize(m_RenderSizeLimits, dispatchDesc.renderSize.width, dispatchDesc.renderSize.height);
+    m_Governor.Update(dispatchParam.frameTimeDelta, m_GpuTimers.GetLastUpscaleTime());
+    dispatchDesc.cameraFovAngleVertical = dispatchParam.cameraFovAngleVertical;
+    dispatchDesc.cameraFar = dispatchParam.cameraFar;
+    dispatchDesc.cameraNear = dispatchParam.cameraNear;
+    dispatchDesc.flags = 0;
+}
+
+ffx::ReturnCode DispatchFSRBatch(uint32_t count, const uint32_t* instanceIDs, const DispatchParam* dispatchParams)
+{
+    FSR_TRACE_SCOPE("DispatchFSRBatch");
+    return FSRSubmission<FSRAPI>::DispatchBatch(count, instanceIDs, dispatchParams, &FindFSRInstance);
+}
+
 void FSRAPI::SetTextureID(const TextureName textureName, const UnityTextureID textureID)
 {
     if (textureName > TextureName::INVALID && textureName < TextureName::MAX) {
@@ -242,6 +750,7 @@ void FSRAPI::SetTextureID(const TextureName textureName, const UnityTextureID te
 
 FfxApiResource ffxApiGetResource(void* resource, uint32_t state, uint32_t additionalUsages)
 {
+    FSR_TRACE_SCOPE("ffxApiGetResource");
     UnityGfxRenderer renderer = Device::Instance().GetDeviceType();
     switch (renderer) {
 #if defined(FSR_BACKEND_DX12) || defined(FSR_BACKEND_ALL)
@@ -270,21 +779,32 @@ FfxApiResource ffxApiGetResource(void* resource, uint32_t state, uint32_t additi
 #if defined(FSR_BACKEND_VK) || defined(FSR_BACKEND_ALL)
     case kUnityGfxRendererVulkan:
     {
+        auto getImageLayout = [](uint32_t ffxState) {
+            switch (ffxState) {
+            case FFX_API_RESOURCE_STATE_UNORDERED_ACCESS:
+            case FFX_API_RESOURCE_STATE_GENERIC_READ:
+                return VK_IMAGE_LAYOUT_GENERAL;
+            case FFX_API_RESOURCE_STATE_COPY_SRC:
+                return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            case FFX_API_RESOURCE_STATE_COPY_DEST:
+                return VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            default:
+                return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            }
+        };
         UnityVulkanImage vulkanImage = {};
-        void* nativeResource = Device::Instance().GetNativeResource(resource, &vulkanImage);
-        VkImageCreateInfo createInfo = {};
-        createInfo.imageType = vulkanImage.type;
-        createInfo.format = vulkanImage.format;
-        createInfo.extent = vulkanImage.extent;
-        createInfo.mipLevels = vulkanImage.mipCount;
-        createInfo.arrayLayers = vulkanImage.layers;
-        createInfo.samples = vulkanImage.samples;
-        createInfo.tiling = vulkanImage.tiling;
-        createInfo.usage = vulkanImage.usage;
-        createInfo.queueFamilyIndexCount = static_cast<IUnityGraphicsVulkanV2*>(Device::Instance().GetGraphicsInterfaces())->Instance().queueFamilyIndex;
-        createInfo.initialLayout = vulkanImage.layout;
-        createInfo.pNext = vulkanImage.image;
-        return ffxApiGetResourceVK(nativeResource, ffxApiGetImageResourceDescriptionVK(vulkanImage.image, createInfo, additionalUsages), state);
+        void* nativeResource = Device::Instance().GetNativeResource(resource, &vulkanImage, getImageLayout(state));
+        return ffxApiGetResourceVK(nativeResource, s_ImageDescriptionCache.Get(vulkanImage, additionalUsages), state);
+    }
+#endif
+#if defined(FSR_BACKEND_NULL)
+    case kUnityGfxRendererNull:
+    {
+        FfxApiResource res{};
+        res.resource = Device::Instance().GetNativeResource(resource);
+        res.description.usage = additionalUsages;
+        res.state = state;
+        return res;
     }
 #endif
     default:
@@ -295,6 +815,7 @@ FfxApiResource ffxApiGetResource(void* resource, uint32_t state, uint32_t additi
 
 FfxApiResource ffxApiGetResourceByID(UnityTextureID textureID, uint32_t state, uint32_t additionalUsages)
 {
+    FSR_TRACE_SCOPE("ffxApiGetResourceByID");
     UnityGfxRenderer renderer = Device::Instance().GetDeviceType();
     switch (renderer) {
 #if defined(FSR_BACKEND_DX12) || defined(FSR_BACKEND_ALL)
@@ -323,21 +844,32 @@ FfxApiResource ffxApiGetResourceByID(UnityTextureID textureID, uint32_t state, u
 #if defined(FSR_BACKEND_VK) || defined(FSR_BACKEND_ALL)
     case kUnityGfxRendererVulkan:
     {
+        auto getImageLayout = [](uint32_t ffxState) {
+            switch (ffxState) {
+            case FFX_API_RESOURCE_STATE_UNORDERED_ACCESS:
+            case FFX_API_RESOURCE_STATE_GENERIC_READ:
+                return VK_IMAGE_LAYOUT_GENERAL;
+            case FFX_API_RESOURCE_STATE_COPY_SRC:
+                return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            case FFX_API_RESOURCE_STATE_COPY_DEST:
+                return VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            default:
+                return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            }
+        };
         UnityVulkanImage vulkanImage = {};
-        void* nativeResource = Device::Instance().GetNativeResourceByID(textureID, &vulkanImage);
-        VkImageCreateInfo createInfo = {};
-        createInfo.imageType = vulkanImage.type;
-        createInfo.format = vulkanImage.format;
-        createInfo.extent = vulkanImage.extent;
-        createInfo.mipLevels = vulkanImage.mipCount;
-        createInfo.arrayLayers = vulkanImage.layers;
-        createInfo.samples = vulkanImage.samples;
-        createInfo.tiling = vulkanImage.tiling;
-        createInfo.usage = vulkanImage.usage;
-        createInfo.queueFamilyIndexCount = static_cast<IUnityGraphicsVulkanV2*>(Device::Instance().GetGraphicsInterfaces())->Instance().queueFamilyIndex;
-        createInfo.initialLayout = vulkanImage.layout;
-        createInfo.pNext = vulkanImage.image;
-        return ffxApiGetResourceVK(nativeResource, ffxApiGetImageResourceDescriptionVK(vulkanImage.image, createInfo, additionalUsages), state);
+        void* nativeResource = Device::Instance().GetNativeResourceByID(textureID, &vulkanImage, getImageLayout(state));
+        return ffxApiGetResourceVK(nativeResource, s_ImageDescriptionCache.Get(vulkanImage, additionalUsages), state);
+    }
+#endif
+#if defined(FSR_BACKEND_NULL)
+    case kUnityGfxRendererNull:
+    {
+        FfxApiResource res{};
+        res.resource = Device::Instance().GetNativeResourceByID(textureID);
+        res.description.usage = additionalUsages;
+        res.state = state;
+        return res;
     }
 #endif
     default:
@@ -369,33 +901,88 @@ inline std::wstring GetDllName()
     }
 }
 
+struct FfxApiFunctions
+{
+    PfnFfxCreateContext createContext;
+    PfnFfxDestroyContext destroyContext;
+    PfnFfxConfigure configure;
+    PfnFfxQuery query;
+    PfnFfxDispatch dispatch;
+};
+
+static DllFunctionTable<FfxApiFunctions> s_FfxApi;
+
+inline const FfxApiFunctions* GetFfxApiFunctions()
+{
+    return s_FfxApi.Get();
+}
+
+bool LoadFSRFunctions()
+{
+    FSR_TRACE_SCOPE("LoadFSRFunctions");
+    static UnityGfxRenderer loadedRenderer = kUnityGfxRendererNull;
+    UnityGfxRenderer renderer = Device::Instance().GetDeviceType();
+    if (s_FfxApi.IsPublished() && loadedRenderer == renderer) {
+        return true;
+    }
+    s_FfxApi.Invalidate();
+
+    DllLoader& dll = DllLoader::Instance(GetDllName().c_str());
+    if (!dll.IsLoaded()) {
+        return s_FfxApi.Fail();
+    }
+    FfxApiFunctions functions = {};
+    bool resolved = true;
+    resolved &= dll.Resolve("ffxCreateContext", functions.createContext);
+    resolved &= dll.Resolve("ffxDestroyContext", functions.destroyContext);
+    resolved &= dll.Resolve("ffxConfigure", functions.configure);
+    resolved &= dll.Resolve("ffxQuery", functions.query);
+    resolved &= dll.Resolve("ffxDispatch", functions.dispatch);
+    if (!resolved) {
+        return s_FfxApi.Fail();
+    }
+    loadedRenderer = renderer;
+    return s_FfxApi.Publish(functions);
+}
+
 ffxReturnCode_t ffxCreateContext(ffxContext* context, ffxCreateContextDescHeader* desc, const ffxAllocationCallbacks* memCb)
 {
-    static PfnFfxCreateContext createContext = reinterpret_cast<PfnFfxCreateContext>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxCreateContext"));
-    return createContext(context, desc, memCb);
+    const FfxApiFunctions* functions = GetFfxApiFunctions();
+    return functions != nullptr ? functions->createContext(context, desc, memCb) : FFX_API_RETURN_NO_PROVIDER;
 }
 
 ffxReturnCode_t ffxDestroyContext(ffxContext* context, const ffxAllocationCallbacks* memCb)
 {
-    static PfnFfxDestroyContext destroyContext = reinterpret_cast<PfnFfxDestroyContext>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxDestroyContext"));
-    return destroyContext(context, memCb);
+    const FfxApiFunctions* functions = GetFfxApiFunctions();
+    return functions != nullptr ? functions->destroyContext(context, memCb) : FFX_API_RETURN_NO_PROVIDER;
 }
 
 ffxReturnCode_t ffxConfigure(ffxContext* context, const ffxConfigureDescHeader* desc)
 {
-    static PfnFfxConfigure configure = reinterpret_cast<PfnFfxConfigure>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxConfigure"));
-    return configure(context, desc);
+    const FfxApiFunctions* functions = GetFfxApiFunctions();
+    return functions != nullptr ? functions->configure(context, desc) : FFX_API_RETURN_NO_PROVIDER;
 }
 
 ffxReturnCode_t ffxQuery(ffxContext* context, ffxQueryDescHeader* desc)
 {
-    static PfnFfxQuery query = reinterpret_cast<PfnFfxQuery>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxQuery"));
-    return query(context, desc);
+    const FfxApiFunctions* functions = GetFfxApiFunctions();
+    return functions != nullptr ? functions->query(context, desc) : FFX_API_RETURN_NO_PROVIDER;
 }
 
 ffxReturnCode_t ffxDispatch(ffxContext* context, const ffxDispatchDescHeader* desc)
 {
-    static PfnFfxDispatch dispatch = reinterpret_cast<PfnFfxDispatch>(DllLoader::Instance(GetDllName().c_str()).GetProcAddress("ffxDispatch"));
-    return dispatch(context, desc);
+    const FfxApiFunctions* functions = GetFfxApiFunctions();
+    return functions != nullptr ? functions->dispatch(context, desc) : FFX_API_RETURN_NO_PROVIDER;
+}
+#elif defined(FSR_BACKEND_NULL)
+bool LoadFSRFunctions()
+{
+    // The stub provider is linked directly, locating it runs the same discovery path as FSR_BACKEND_ALL builds.
+    return DllLoader::Instance(DLL_LOADER_TEXT(FFX_STUB_LIBRARY_NAME)).IsLoaded();
+}
+#else
+bool LoadFSRFunctions()
+{
+    return true;
 }
 #endif
\ No newline at end of file
@@ -1,9 +1,21 @@
 #pragma once
 
 #include <array>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include "IUnityInterface.h"
+#include "IUnityGraphics.h"
+#include "contextinittask.h"
+#include "fsrsubmission.h"
+#include "gpumemorybudget.h"
+#include "gputimerstats.h"
+#include "hostarena.h"
+#include "jittercache.h"
+#include "rendersize.h"
+#include "resolutiongovernor.h"
 #include "ffx_upscale.hpp"
 
 
@@ -21,11 +33,18 @@ enum TextureName
     MAX
 };
 
+// FSRInit reads up to displaySizeHeight, the layout callers had before the render size envelope was added.
+// FSRInitEx takes the size of the caller's struct, and the fields past it are 0.
 struct InitParam
 {
     uint32_t flags;
     uint32_t displaySizeWidth;
     uint32_t displaySizeHeight;
+    // Largest render size the instance dispatches at, the context is sized for it. 0 for the display size.
+    uint32_t maxRenderSizeWidth;
+    uint32_t maxRenderSizeHeight;
+    // Largest display to render size ratio dynamic resolution may go to, 0 for no limit.
+    float maxUpscaleRatio;
 };
 
 struct GenReactiveParam
@@ -64,6 +83,60 @@ struct DispatchParam
     float cameraFovAngleVertical;
 };
 
+// Payload of the REACTIVEMASK_DISPATCH event. genReactive.outReactive is written and then read by the upscale,
+// dispatch.reactive is ignored.
+struct ReactiveDispatchParam
+{
+    GenReactiveParam genReactive;
+    DispatchParam dispatch;
+};
+
+// Payload of the DISPATCH_BATCH event, params[i] is the dispatch of instance instanceIDs[i].
+struct DispatchBatchParam
+{
+    uint32_t count;
+    const uint32_t* instanceIDs;
+    const DispatchParam* params;
+};
+
+// Payload of the INITIALIZE_EX event, the FSRInitEx arguments. initParamSize is sizeof the caller's InitParam.
+struct InitExParam
+{
+    uint32_t initParamSize;
+    uint32_t fsrVersion;
+    InitParam initParam;
+};
+
+struct FSRProvider
+{
+    uint64_t versionId;
+    std::string name;
+    uint32_t majorVersion;
+};
+
+struct FSRProviderTable
+{
+    UnityGfxRenderer renderer;
+    std::vector<FSRProvider> providers;
+};
+
+struct ContextKey
+{
+    uint32_t displayWidth;
+    uint32_t displayHeight;
+    uint32_t maxRenderWidth;
+    uint32_t maxRenderHeight;
+    uint32_t flags;
+    uint64_t versionId;
+
+    bool operator==(const ContextKey& other) const
+    {
+        return displayWidth == other.displayWidth && displayHeight == other.displayHeight &&
+            maxRenderWidth == other.maxRenderWidth && maxRenderHeight == other.maxRenderHeight &&
+            flags == other.flags && versionId == other.versionId;
+    }
+};
+
 class FSRAPI
 {
 public:
@@ -71,18 +144,89 @@ public:
     uint64_t Query(uint32_t fsrVersion);
     ffx::ReturnCode Init(const InitParam& initParam, uint32_t fsrVersion = 0);
     void Destroy();
-    std::array<float, 2> GetJitterOffset(const int32_t index, const int32_t renderWidth, const int32_t displayWidth);
     ffx::ReturnCode GenerateReactiveMask(const GenReactiveParam& genReactiveParam);
     ffx::ReturnCode Dispatch(const DispatchParam& dispatchParam);
+    // Both passes in one command list and one submission.
+    ffx::ReturnCode GenerateReactiveMaskAndDispatch(const ReactiveDispatchParam& reactiveDispatchParam);
     void SetTextureID(const TextureName textureName, const UnityTextureID textureID);
+    uint32_t GetInitStatus() const { return m_InitTask.GetStatus(); }
+    HostArenaCounters GetHostMemoryUsage() const;
+    GpuMemoryUsage GetGpuMemoryUsage() const;
+    void SetGovernor(const GovernorParam& governorParam) { m_Governor.Configure(governorParam); }
+    bool IsGovernorEnabled() const { return m_Governor.IsEnabled(); }
+    GovernorResult GetGovernedRenderSize() const;
+    FSRStats GetStats() const { return m_GpuTimers.GetStats(); }
+    // Render size and upscale ratio of a quality mode at a display size.
+    bool GetRenderResolution(uint32_t qualityMode, uint32_t displayWidth, uint32_t displayHeight, RenderResolution& resolution) const;
+    // Upscale ratio of a quality mode, without a render size.
+    bool GetUpscaleRatio(uint32_t qualityMode, float& ratio) const;
+
+    friend class FSRSubmission<FSRAPI>;
+
+private:
+    // The SDK as FSRSubmission sees it.
+    using ErrorCode = ffx::ReturnCode;
+    using GenReactiveDescription = ffx::DispatchDescUpscaleGenerateReactiveMask;
+    using DispatchDescription = ffx::DispatchDescUpscale;
+    static constexpr ffx::ReturnCode ErrorOk = ffx::ReturnCode::Ok;
+    static constexpr ffx::ReturnCode ErrorFailed = ffx::ReturnCode::Error;
+
+    void SetupGenerateReactiveMask(ffx::DispatchDescUpscaleGenerateReactiveMask& genReactiveDesc, const GenReactiveParam& genReactiveParam, void* commandList);
+    // reactive overrides dispatchParam.reactive with a resource that is already translated.
+    void SetupDispatch(ffx::DispatchDescUpscale& dispatchDesc, const DispatchParam& dispatchParam, void* commandList, const FfxApiResource* reactive = nullptr);
+    // Record a pass into the command list of its description, logging a failure.
+    ffx::ReturnCode RecordGenerateReactiveMask(const ffx::DispatchDescUpscaleGenerateReactiveMask& genReactiveDesc);
+    ffx::ReturnCode RecordDispatch(const ffx::DispatchDescUpscale& dispatchDesc);
 
 private:
+    // Guards m_Context, m_ContextKey and m_ContextCreated against GetRenderResolution and GetUpscaleRatio, which
+    // may run on any thread. The render thread that owns the instance reads them without it.
+    mutable std::mutex m_ContextMutex;
     ffx::Context m_Context;
+    ContextKey m_ContextKey = {};
     bool m_ContextCreated = false;
+    ContextInitTask m_InitTask;
+    ffx::ReturnCode m_InitError = ffx::ReturnCode::Ok;
+    RenderSizeLimits m_RenderSizeLimits = {};
+    // Fed by every upscale with its frame time and the GPU time of the latest measured upscale in milliseconds,
+    // which stays 0 while GPU timestamps are off.
+    ResolutionGovernor m_Governor;
+    GpuTimerStats m_GpuTimers;
     bool m_Reset = true;
     uint64_t m_FenceValue = 0;
+    BatchDispatch<DispatchDescription> m_Batch;
+    // Host allocations of the current context, handed on with it to the context pool and the release queue.
+    std::shared_ptr<HostArena> m_HostArena;
+    // GPU memory of the current context, travels with it like the arena.
+    std::shared_ptr<GpuMemoryCharge> m_GpuMemory;
 
     std::array<uint32_t, TextureName::MAX> m_TextureIDs = {};
 };
 
-FSRAPI& GetFSRInstance(uint32_t id);
+// Resolves every FFX entry point used by the plugin for the current device, see DllLoader.
+bool LoadFSRFunctions();
+
+// Enumerates the upscaler providers once per device initialization, FSRAPI::Query and version overrides read
+// the resulting table.
+void EnumerateFSRProviders();
+const FSRProviderTable* GetFSRProviders();
+
+// Number of recently used contexts FSRAPI::Init keeps parked for reuse, 0 disables pooling.
+void SetFSRContextPoolCapacity(uint32_t capacity);
+// Destroys every parked context, called before the device goes away.
+void ReleaseFSRContextPool();
+// Caps the host memory each context created afterwards may allocate, 0 removes the cap.
+void SetFSRHostMemoryLimit(uint64_t bytes);
+
+// Creates the instance on first use. Returns nullptr for an ID outside the instance table.
+FSRAPI* GetFSRInstance(uint32_t id);
+// Returns nullptr unless the instance was used before, for callers that must not create one.
+FSRAPI* FindFSRInstance(uint32_t id);
+
+// Records the upscales of several instances into one command list with one submission. Instances still being
+// created are skipped, an instance listed more than once is upscaled once. An instance must not read what
+// another one in the same batch writes.
+ffx::ReturnCode DispatchFSRBatch(uint32_t count, const uint32_t* instanceIDs, const DispatchParam* dispatchParams);
+
+// Jitter sequence for the given widths, shared by all instances. Returns nullptr if it could not be queried.
+const JitterSequence* GetJitterSequence(int32_t renderWidth, int32_t displayWidth);
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+
+#include "fsrunityplugin.h"
+#include "device.h"
+#include "gputimerstats.h"
+
+
+enum class BatchState : uint8_t
+{
+    NONE,
+    SETUP,
+    RECORDED
+};
+
+// Upscale of one instance in the batch being recorded, see FSRSubmission::DispatchBatch.
+template<typename DispatchDescription>
+struct BatchDispatch
+{
+    DispatchDescription dispatchDesc = {};
+    uint64_t timer = Device::InvalidGpuTimer;
+    BatchState state = BatchState::NONE;
+};
+
+// Recording and submission shared by the FSR2, FSR3 and FSRAPI instances. Each SDK has its own descriptions and
+// entry points, which the instance class exposes to FSRSubmission<Instance>, a friend of it, as:
+//   ErrorCode, ErrorOk, ErrorFailed                   result type of the SDK, its success and generic failure
+//   GenReactiveDescription, DispatchDescription       descriptions of the two passes
+//   SetupGenerateReactiveMask(), SetupDispatch()      translate the parameters and resources into a description
+//   RecordGenerateReactiveMask(), RecordDispatch()    record a pass into the description's command list
+//   m_Batch                                           its upscale in the batch being recorded
+template<typename Instance>
+class FSRSubmission
+{
+public:
+    using ErrorCode = typename Instance::ErrorCode;
+
+    // Both passes in one command list and one submission. Every resource of both passes is translated before
+    // FlushResourceBarriers, so a backend that records the transitions itself does so with one barrier. The
+    // upscale reads the reactive mask in the unordered access state the first pass declared for it, the provider
+    // inserts the barrier between the two passes.
+    template<typename ReactiveDispatchParam>
+    static ErrorCode GenerateReactiveMaskAndDispatch(Instance& instance, const ReactiveDispatchParam& reactiveDispatchParam)
+    {
+        if (!instance.m_InitTask.IsReady()) {
+            return instance.m_InitTask.IsPending() ? static_cast<ErrorCode>(FSRUnityPlugin::ReturnNotReady) : Instance::ErrorFailed;
+        }
+        instance.m_GpuTimers.Collect();
+        void* commandList = Device::Instance().GetNativeCommandList();
+        typename Instance::GenReactiveDescription genReactiveDesc{};
+        instance.SetupGenerateReactiveMask(genReactiveDesc, reactiveDispatchParam.genReactive, commandList);
+        typename Instance::DispatchDescription dispatchDesc{};
+        instance.SetupDispatch(dispatchDesc, reactiveDispatchParam.dispatch, commandList, &genReactiveDesc.outReactive);
+        Device::Instance().FlushResourceBarriers(commandList);
+        uint64_t timer = Device::Instance().BeginGpuTimer(commandList);
+        ErrorCode err = instance.RecordGenerateReactiveMask(genReactiveDesc);
+        if (err == Instance::ErrorOk) {
+            instance.m_Reset = false;
+            err = instance.RecordDispatch(dispatchDesc);
+        }
+        Device::Instance().EndGpuTimer(commandList, timer);
+        instance.m_FenceValue = Device::Instance().ExecuteCommandList(commandList);
+        instance.m_GpuTimers.Submit(GPU_TIMER_UPSCALE, timer, instance.m_FenceValue);
+        return err;
+    }
+
+    // Records the upscales of several instances into one command list with one submission. Each instance keeps
+    // the description and timer of its upscale in m_Batch, so the batch needs no storage of its own. Instances
+    // still being created are skipped, an instance listed more than once is upscaled once, with its first
+    // parameters.
+    template<typename DispatchParam>
+    static ErrorCode DispatchBatch(uint32_t count, const uint32_t* instanceIDs, const DispatchParam* dispatchParams, Instance* (*findInstance)(uint32_t))
+    {
+        ErrorCode err = Instance::ErrorOk;
+        void* commandList = nullptr;
+        for (uint32_t i = 0; i < count; ++i) {
+            Instance* instance = findInstance(instanceIDs[i]);
+            if (instance == nullptr || !instance->m_InitTask.IsReady()) {
+                err = instance != nullptr && instance->m_InitTask.IsPending() ? static_cast<ErrorCode>(FSRUnityPlugin::ReturnNotReady) : Instance::ErrorFailed;
+                continue;
+            }
+            if (instance->m_Batch.state != BatchState::NONE) {
+                continue;
+            }
+            if (commandList == nullptr) {
+                commandList = Device::Instance().GetNativeCommandList();
+            }
+            instance->m_GpuTimers.Collect();
+            instance->m_Batch.dispatchDesc = {};
+            instance->SetupDispatch(instance->m_Batch.dispatchDesc, dispatchParams[i], commandList);
+            instance->m_Batch.state = BatchState::SETUP;
+        }
+        if (commandList == nullptr) {
+            return err;
+        }
+
+        // Every resource was translated above, so a backend that records the transitions itself does so for the
+        // whole batch with one barrier. Each instance is timed on its own, the batch shares one submission.
+        Device::Instance().FlushResourceBarriers(commandList);
+        for (uint32_t i = 0; i < count; ++i) {
+            Instance* instance = findInstance(instanceIDs[i]);
+            if (instance == nullptr || instance->m_Batch.state != BatchState::SETUP) {
+                continue;
+            }
+            instance->m_Reset = false;
+            instance->m_Batch.timer = Device::Instance().BeginGpuTimer(commandList);
+            const ErrorCode entryError = instance->RecordDispatch(instance->m_Batch.dispatchDesc);
+            if (entryError != Instance::ErrorOk) {
+                err = entryError;
+            }
+            Device::Instance().EndGpuTimer(commandList, instance->m_Batch.timer);
+            instance->m_Batch.state = BatchState::RECORDED;
+        }
+        uint64_t fenceValue = Device::Instance().ExecuteCommandList(commandList);
+        for (uint32_t i = 0; i < count; ++i) {
+            Instance* instance = findInstance(instanceIDs[i]);
+            if (instance == nullptr || instance->m_Batch.state != BatchState::RECORDED) {
+                continue;
+            }
+            instance->m_FenceValue = fenceValue;
+            instance->m_GpuTimers.Submit(GPU_TIMER_UPSCALE, instance->m_Batch.timer, fenceValue);
+            instance->m_Batch.state = BatchState::NONE;
+        }
+        return err;
+    }
+};
@@ -1,9 +1,22 @@
 #include "fsrunityplugin.h"
 
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
 
 #include "IUnityRenderingExtensions.h"
 #include "device.h"
+#if defined(FSR_BACKEND_NULL)
+#include "device_null.h"
+#endif
+#if defined(FSR_BACKEND_VK) || defined(FSR_BACKEND_ALL)
+#include "device_vk.h"
+#endif
+#if defined(FSR_BACKEND_ALL) || defined(FSR_BACKEND_NULL)
+#include "dllloader.h"
+#endif
+#include "trace.h"
 
 #if defined(FSR_2)
 #include "fsr2.h"
@@ -19,29 +32,96 @@
 IUnityInterfaces* FSRUnityPlugin::UnityInterfaces = nullptr;
 IUnityGraphics* FSRUnityPlugin::UnityGraphics = nullptr;
 IUnityLog* FSRUnityPlugin::UnityLog = nullptr;
+std::atomic<bool> FSRUnityPlugin::AsyncInit = {false};
+
+// Returned by the entry points that take an instance ID outside the instance table.
+#if defined(FSR_API)
+static const uint32_t s_InvalidInstance = static_cast<uint32_t>(ffx::ReturnCode::ErrorParameter);
+#else
+static const uint32_t s_InvalidInstance = static_cast<uint32_t>(FFX_ERROR_INVALID_ARGUMENT);
+#endif
 
 void UNITY_INTERFACE_API
 OnGraphicsDeviceEvent(UnityGfxDeviceEventType eventType)
 {
     switch (eventType) {
     case kUnityGfxDeviceEventInitialize:
-        Device::Instance(FSRUnityPlugin::UnityGraphics->GetRenderer()).Init(FSRUnityPlugin::UnityInterfaces);
+        if (Device::Instance(FSRUnityPlugin::UnityGraphics->GetRenderer()).Init(FSRUnityPlugin::UnityInterfaces)) {
+#if defined(FSR_BACKEND_ALL) || defined(FSR_BACKEND_NULL)
+            // Searching for the FFX libraries can take a while, keep it off the thread that loads the plugin.
+            DllLoader::Preload([]() {
+                bool loaded = LoadFSRFunctions();
+                if (!loaded) {
+                    FSR_ERROR("Failed to load FFX entry points, FSR is unavailable");
+                    return false;
+                }
+#if defined(FSR_API)
+                EnumerateFSRProviders();
+#endif
+                return true;
+            });
+#else
+            if (!LoadFSRFunctions()) {
+                FSR_ERROR("Failed to load FFX entry points, FSR is unavailable");
+                break;
+            }
+#if defined(FSR_API)
+            EnumerateFSRProviders();
+#endif
+#endif
+        }
         break;
     case kUnityGfxDeviceEventShutdown:
+        // Abandoned creations queue their contexts for release, which has to happen before the device goes.
+        ContextInitTask::WaitForAbandoned();
+#if defined(FSR_API)
+        ReleaseFSRContextPool();
+#endif
         Device::Instance().Destroy();
         break;
     }
 }
 
+// Size of the InitParam FSRInit reads, the fields before the render size envelope.
+static const size_t s_InitParamSizeV1 = offsetof(InitParam, maxRenderSizeWidth);
+
+static uint32_t InitInstance(uint32_t instanceID, const InitParam* initParam, size_t initParamSize, uint32_t fsrVersion)
+{
+    Device::Instance().ConfigurePluginEvent(static_cast<int>((instanceID << 16) | FSRUnityPlugin::PassEvent::DISPATCH));
+    Device::Instance().ConfigurePluginEvent(static_cast<int>((instanceID << 16) | FSRUnityPlugin::PassEvent::REACTIVEMASK));
+    Device::Instance().ConfigurePluginEvent(static_cast<int>((instanceID << 16) | FSRUnityPlugin::PassEvent::REACTIVEMASK_DISPATCH));
+    Device::Instance().ConfigurePluginEvent(static_cast<int>(FSRUnityPlugin::PassEvent::DISPATCH_BATCH));
+    Device::Instance().ConfigurePluginEvent(static_cast<int>(FSRUnityPlugin::PassEvent::ASYNC_ACQUIRE));
+    auto* instance = GetFSRInstance(instanceID);
+    if (instance == nullptr || initParam == nullptr || initParamSize < s_InitParamSizeV1) {
+        return s_InvalidInstance;
+    }
+    // Fields the caller's struct does not have stay 0, fields this plugin does not know are ignored.
+    InitParam param = {};
+    std::memcpy(&param, initParam, initParamSize < sizeof(param) ? initParamSize : sizeof(param));
+#if defined(FSR_API)
+    return static_cast<uint32_t>(instance->Init(param, fsrVersion));
+#else
+    return static_cast<uint32_t>(instance->Init(param));
+#endif
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
     void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginLoad(IUnityInterfaces* unityInterfaces)
     {
+        // FSR_TRACE in the environment traces from the start, which includes loading the FFX libraries.
+        if (std::getenv("FSR_TRACE") != nullptr) {
+            Trace::SetEnabled(true);
+        }
         FSRUnityPlugin::UnityInterfaces = unityInterfaces;
         FSRUnityPlugin::UnityLog = unityInterfaces->Get<IUnityLog>();
         FSRUnityPlugin::UnityGraphics = unityInterfaces->Get<IUnityGraphics>();
+#if defined(FSR_BACKEND_VK) || defined(FSR_BACKEND_ALL)
+        DeviceVK::InterceptInitialization(unityInterfaces);
+#endif
         FSRUnityPlugin::UnityGraphics->RegisterDeviceEventCallback(&OnGraphicsDeviceEvent);
         OnGraphicsDeviceEvent(kUnityGfxDeviceEventInitialize);
     }
@@ -49,11 +129,14 @@ extern "C" {
     void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginUnload()
     {
         FSRUnityPlugin::UnityGraphics->UnregisterDeviceEventCallback(&OnGraphicsDeviceEvent);
+#if defined(FSR_BACKEND_ALL) || defined(FSR_BACKEND_NULL)
+        DllLoader::WaitForPreload();
+#endif
     }
 
     bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRQuery(uint32_t fsrVersion)
     {
-        return GetFSRInstance(0).Query(fsrVersion) != 0;
+        return GetFSRInstance(0)->Query(fsrVersion) != 0;
     }
 
     uint32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRInit(
@@ -61,11 +144,74 @@ extern "C" {
         const InitParam* initParam,
         uint32_t fsrVersion = 0)
     {
-#if defined(FSR_API)
-        return static_cast<uint32_t>(GetFSRInstance(instanceID).Init(*initParam, fsrVersion));
-#else
-        return static_cast<uint32_t>(GetFSRInstance(instanceID).Init(*initParam));
-#endif
+        return InitInstance(instanceID, initParam, s_InitParamSizeV1, fsrVersion);
+    }
+
+    // FSRInit with the render size envelope. initParamSize is sizeof the caller's InitParam; the fields past it
+    // are 0, so a caller built against an older layout keeps working. The INITIALIZE_EX event does the same on
+    // the render thread.
+    uint32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRInitEx(
+        uint32_t instanceID,
+        const InitParam* initParam,
+        uint32_t initParamSize,
+        uint32_t fsrVersion)
+    {
+        return InitInstance(instanceID, initParam, initParamSize, fsrVersion);
+    }
+
+    // When enabled, FSRInit returns FSRUnityPlugin::ReturnNotReady and creates the context on a worker thread.
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRSetAsyncInit(bool enabled)
+    {
+        FSRUnityPlugin::AsyncInit.store(enabled, std::memory_order_relaxed);
+    }
+
+    // When enabled, dispatches are recorded into the command buffer Unity is recording instead of being submitted
+    // separately. Only dispatches issued as plugin events record there, the events of instances already
+    // initialized are configured for it when it is enabled. Returns false if the renderer does not support it, in
+    // which case every dispatch keeps its own submission.
+    bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRSetRecordIntoUnityCommandBuffer(bool enabled)
+    {
+        return Device::Instance().SetRecordIntoHostCommandList(enabled);
+    }
+
+    // When enabled, dispatches run on an asynchronous compute queue so they can overlap Unity's graphics work.
+    // Takes effect for instances initialized afterwards; returns false if the renderer has no such queue.
+    bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRSetAsyncCompute(bool enabled)
+    {
+        return Device::Instance().SetAsyncCompute(enabled);
+    }
+
+    // Timestamps around every recorded reactive mask and upscale. Returns false if the device cannot take them.
+    bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRSetGpuTimestamps(bool enabled)
+    {
+        return Device::Instance().SetGpuTimestamps(enabled);
+    }
+
+    // Records the plugin's CPU work per thread, see FSRWriteTrace. Off unless FSR_TRACE is set.
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRSetTracing(bool enabled)
+    {
+        Trace::SetEnabled(enabled);
+    }
+
+    // Writes what was traced since the last call to path as a Chrome trace, for chrome://tracing or Perfetto.
+    bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRWriteTrace(const char* path)
+    {
+        return Trace::Write(path);
+    }
+
+    // How many command buffers the device created, out of the ring capacity, and how often a submission had
+    // to wait for the GPU to release one.
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGetCommandBufferCounters(CommandBufferRingCounters* outCounters)
+    {
+        if (outCounters != nullptr) {
+            *outCounters = Device::Instance().GetCommandBufferCounters();
+        }
+    }
+
+    uint32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGetInitStatus(uint32_t instanceID)
+    {
+        const auto* instance = FindFSRInstance(instanceID);
+        return instance != nullptr ? instance->GetInitStatus() : static_cast<uint32_t>(FSRUnityPlugin::INIT_STATUS_NONE);
     }
 
     void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGetProjectionMatrixJitterOffset(
@@ -74,47 +220,226 @@ extern "C" {
         const int32_t displayWidth,
         float* outJitterOffset)
     {
-        const auto& jitterOffset = GetFSRInstance(0).GetJitterOffset(index, renderWidth, displayWidth);
+        const auto& jitterOffset = GetJitterOffset(GetJitterSequence(renderWidth, displayWidth), index);
         if (outJitterOffset != nullptr) {
             outJitterOffset[0] = jitterOffset[0];
             outJitterOffset[1] = jitterOffset[1];
         }
     }
 
+    // Copies up to capacity (x, y) pairs of the jitter sequence into outJitterOffsets and returns the phase count,
+    // so callers can pass a null buffer to size it first. Returns 0 if the sequence is unavailable.
+    int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGetJitterSequence(
+        const int32_t renderWidth,
+        const int32_t displayWidth,
+        float* outJitterOffsets,
+        const int32_t capacity)
+    {
+        const JitterSequence* sequence = GetJitterSequence(renderWidth, displayWidth);
+        if (sequence == nullptr) {
+            return 0;
+        }
+        int32_t phaseCount = static_cast<int32_t>(sequence->size());
+        if (outJitterOffsets != nullptr && capacity > 0) {
+            size_t count = static_cast<size_t>(capacity < phaseCount ? capacity : phaseCount);
+            memcpy(outJitterOffsets, sequence->data(), count * sizeof(JitterSequence::value_type));
+        }
+        return phaseCount;
+    }
+
     uint32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGenerateReactiveMask(
         uint32_t instanceID,
         const GenReactiveParam* genReactiveParam)
     {
-        return static_cast<uint32_t>(GetFSRInstance(instanceID).GenerateReactiveMask(*genReactiveParam));
+        auto* instance = FindFSRInstance(instanceID);
+        return instance != nullptr ? static_cast<uint32_t>(instance->GenerateReactiveMask(*genReactiveParam)) : s_InvalidInstance;
     }
 
     uint32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRDispatch(
         uint32_t instanceID,
         const DispatchParam* dispatchParam)
     {
-        return static_cast<uint32_t>(GetFSRInstance(instanceID).Dispatch(*dispatchParam));
+        auto* instance = FindFSRInstance(instanceID);
+        return instance != nullptr ? static_cast<uint32_t>(instance->Dispatch(*dispatchParam)) : s_InvalidInstance;
+    }
+
+    uint32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGenerateReactiveMaskAndDispatch(
+        uint32_t instanceID,
+        const ReactiveDispatchParam* reactiveDispatchParam)
+    {
+        auto* instance = FindFSRInstance(instanceID);
+        return instance != nullptr ? static_cast<uint32_t>(instance->GenerateReactiveMaskAndDispatch(*reactiveDispatchParam)) : s_InvalidInstance;
+    }
+
+    uint32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRDispatchBatch(
+        uint32_t count,
+        const uint32_t* instanceIDs,
+        const DispatchParam* dispatchParams)
+    {
+        if (count == 0 || instanceIDs == nullptr || dispatchParams == nullptr) {
+            return 0;
+        }
+        return static_cast<uint32_t>(DispatchFSRBatch(count, instanceIDs, dispatchParams));
+    }
+
+    // Host memory held for the instance's current context: reserved and used bytes, and allocation counts.
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGetHostMemoryUsage(uint32_t instanceID, HostArenaCounters* outCounters)
+    {
+        if (outCounters != nullptr) {
+            const auto* instance = FindFSRInstance(instanceID);
+            *outCounters = instance != nullptr ? instance->GetHostMemoryUsage() : HostArenaCounters{};
+        }
+    }
+
+    // GPU memory of the instance's current context, as reported by the provider or counted from the resources
+    // the backend created. Before the context exists this is the estimate charged to the budget.
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGetMemoryUsage(uint32_t instanceID, GpuMemoryUsage* outUsage)
+    {
+        if (outUsage != nullptr) {
+            const auto* instance = FindFSRInstance(instanceID);
+            *outUsage = instance != nullptr ? instance->GetGpuMemoryUsage() : GpuMemoryUsage{};
+        }
+    }
+
+    // Sum over every context not yet destroyed, including pooled ones and those waiting for the GPU.
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGetDeviceMemoryUsage(GpuMemoryBudgetCounters* outCounters)
+    {
+        if (outCounters != nullptr) {
+            *outCounters = GpuMemoryBudget::Instance().GetCounters();
+        }
+    }
+
+    // Checked by FSRInit before a context is created, 0 disables the check. Over budget, FSRInit fails with an
+    // out of memory error if refuse is set and logs a warning otherwise.
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRSetMemoryBudget(uint64_t bytes, bool refuse)
+    {
+        GpuMemoryBudget::Instance().SetBudget(bytes, refuse);
+    }
+
+    // Lets the plugin pick the render size of the instance from the frameTimeDelta of its dispatches, within the
+    // envelope given to FSRInit. A null param or a target frame time of 0 turns it off.
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRSetResolutionGovernor(uint32_t instanceID, const GovernorParam* governorParam)
+    {
+        if (auto* instance = GetFSRInstance(instanceID)) {
+            instance->SetGovernor(governorParam != nullptr ? *governorParam : GovernorParam{});
+        }
+    }
+
+    // Render size and jitter phase count for the next frame of the instance. Returns false if its governor is off,
+    // the size is then the maximum render size.
+    bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGetGovernedRenderSize(uint32_t instanceID, GovernorResult* outResult)
+    {
+        const auto* instance = FindFSRInstance(instanceID);
+        if (instance == nullptr) {
+            return false;
+        }
+        if (outResult != nullptr) {
+            *outResult = instance->GetGovernedRenderSize();
+        }
+        return instance->IsGovernorEnabled();
+    }
+
+    // GPU time of the instance's recent upscales and reactive masks, see FSRSetGpuTimestamps. Results arrive a few
+    // frames after their dispatch.
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGetStats(uint32_t instanceID, FSRStats* outStats)
+    {
+        if (outStats != nullptr) {
+            const auto* instance = FindFSRInstance(instanceID);
+            *outStats = instance != nullptr ? instance->GetStats() : FSRStats{};
+        }
+    }
+
+    // Render size of a quality mode (see QualityMode) at the given display size. With FSR_API the provider decides,
+    // an instance created for a specific provider version asks that one. Results are cached, so only the first
+    // call for a mode and display size reaches FFX. Returns false for an unknown mode.
+    bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGetRenderResolution(
+        uint32_t instanceID,
+        uint32_t qualityMode,
+        uint32_t displayWidth,
+        uint32_t displayHeight,
+        uint32_t* outRenderWidth,
+        uint32_t* outRenderHeight)
+    {
+        const auto* instance = GetFSRInstance(instanceID);
+        RenderResolution resolution = {};
+        if (instance == nullptr || !instance->GetRenderResolution(qualityMode, displayWidth, displayHeight, resolution)) {
+            return false;
+        }
+        if (outRenderWidth != nullptr) {
+            *outRenderWidth = resolution.width;
+        }
+        if (outRenderHeight != nullptr) {
+            *outRenderHeight = resolution.height;
+        }
+        return true;
+    }
+
+    // Display to render size ratio of a quality mode, 0 for an unknown mode.
+    float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRGetUpscaleRatio(uint32_t instanceID, uint32_t qualityMode)
+    {
+        const auto* instance = GetFSRInstance(instanceID);
+        float ratio = 0.0f;
+        return instance != nullptr && instance->GetUpscaleRatio(qualityMode, ratio) ? ratio : 0.0f;
     }
 
     void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRDestroy(uint32_t instanceID)
     {
-        GetFSRInstance(instanceID).Destroy();
+        if (auto* instance = FindFSRInstance(instanceID)) {
+            instance->Destroy();
+        }
+    }
+
+#if defined(FSR_API)
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRSetContextPoolCapacity(uint32_t capacity)
+    {
+        SetFSRContextPoolCapacity(capacity);
+    }
+
+    // Caps the host memory the provider may allocate for each context created afterwards, 0 removes the cap.
+    // Context creation fails once the cap is reached.
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRSetHostMemoryLimit(uint64_t bytes)
+    {
+        SetFSRHostMemoryLimit(bytes);
     }
+#endif
 
     void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRCallback(int eventID, void* data)
     {
+        static const char* const s_TraceNames[FSRUnityPlugin::PassEvent::MAX] = {"FSRCallback", "FSRCallback(INITIALIZE)",
+            "FSRCallback(DISPATCH)", "FSRCallback(REACTIVEMASK)", "FSRCallback(DESTROY)", "FSRCallback(REACTIVEMASK_DISPATCH)",
+            "FSRCallback(DISPATCH_BATCH)", "FSRCallback(ASYNC_ACQUIRE)", "FSRCallback(INITIALIZE_EX)"};
         uint32_t instanceID = (uint32_t)eventID >> 16;
+        Device::Instance().SetCurrentPluginEvent(eventID);
         eventID &= 65535;
-        if (data != nullptr) {
+        FSR_TRACE_SCOPE(eventID < FSRUnityPlugin::PassEvent::MAX ? s_TraceNames[eventID] : s_TraceNames[0]);
+        if (eventID == FSRUnityPlugin::PassEvent::ASYNC_ACQUIRE) {
+            Device::Instance().AcquireAsyncCompute();
+        } else if (data != nullptr) {
             switch ((FSRUnityPlugin::PassEvent)eventID) {
             case FSRUnityPlugin::PassEvent::INITIALIZE:
                 FSRInit(instanceID, static_cast<InitParam*>(data));
                 break;
+            case FSRUnityPlugin::PassEvent::INITIALIZE_EX:
+            {
+                const InitExParam* initExParam = static_cast<InitExParam*>(data);
+                InitInstance(instanceID, &initExParam->initParam, initExParam->initParamSize, initExParam->fsrVersion);
+                break;
+            }
             case FSRUnityPlugin::PassEvent::DISPATCH:
                 FSRDispatch(instanceID, static_cast<DispatchParam*>(data));
                 break;
             case FSRUnityPlugin::PassEvent::REACTIVEMASK:
                 FSRGenerateReactiveMask(instanceID, static_cast<GenReactiveParam*>(data));
                 break;
+            case FSRUnityPlugin::PassEvent::REACTIVEMASK_DISPATCH:
+                FSRGenerateReactiveMaskAndDispatch(instanceID, static_cast<ReactiveDispatchParam*>(data));
+                break;
+            case FSRUnityPlugin::PassEvent::DISPATCH_BATCH:
+            {
+                const DispatchBatchParam* batchParam = static_cast<DispatchBatchParam*>(data);
+                FSRDispatchBatch(batchParam->count, batchParam->instanceIDs, batchParam->params);
+                break;
+            }
             case FSRUnityPlugin::PassEvent::DESTROY:
                 FSRDestroy(instanceID);
                 break;
@@ -123,6 +448,7 @@ extern "C" {
             }
         } else
             FSR_ERROR("FSR Callback data is nullptr");
+        Device::Instance().SetCurrentPluginEvent(0);
     }
 
     UnityRenderingEventAndData UNITY_INTERFACE_EXPORT  FSRGetCallback()
@@ -137,7 +463,9 @@ extern "C" {
             uint32_t userData = params->userData;
             uint32_t instanceID = userData >> 16;
             userData &= 65535;
-            GetFSRInstance(instanceID).SetTextureID(static_cast<TextureName>(userData), static_cast<uint32_t>(params->textureID));
+            if (auto* instance = GetFSRInstance(instanceID)) {
+                instance->SetTextureID(static_cast<TextureName>(userData), static_cast<uint32_t>(params->textureID));
+            }
         }
     }
 
@@ -148,6 +476,20 @@ extern "C" {
         return FSRTextureUpdateCallback;
     }
 
+#if defined(FSR_BACKEND_NULL)
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRNullDeviceSetGpuLatency(uint32_t microseconds)
+    {
+        static_cast<DeviceNull&>(Device::Instance(kUnityGfxRendererNull)).SetGpuLatency(microseconds);
+    }
+
+    void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API FSRNullDeviceGetCounters(DeviceNull::Counters* outCounters)
+    {
+        if (outCounters != nullptr) {
+            *outCounters = static_cast<DeviceNull&>(Device::Instance(kUnityGfxRendererNull)).GetCounters();
+        }
+    }
+#endif
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
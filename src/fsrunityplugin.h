@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include "IUnityInterface.h"
 #include "IUnityLog.h"
 #include "IUnityGraphics.h"
@@ -15,14 +17,40 @@ public:
         DISPATCH,
         REACTIVEMASK,
         DESTROY,
+        // REACTIVEMASK and DISPATCH in one submission, takes a ReactiveDispatchParam.
+        REACTIVEMASK_DISPATCH,
+        // Several instances in one submission, takes a DispatchBatchParam. The instance bits of the event ID are
+        // ignored.
+        DISPATCH_BATCH,
+        // With async compute, hands the images of the upscales recorded so far back to the graphics queue. Issue
+        // it right before the output is used; Unity's work issued between the upscale and this event runs
+        // alongside the upscale. Takes no data, the instance bits of the event ID are ignored.
+        ASYNC_ACQUIRE,
+        // INITIALIZE with the render size envelope, takes an InitExParam. INITIALIZE reads the InitParam layout
+        // FSRInit takes.
+        INITIALIZE_EX,
         MAX
     };
 
+    // Reported by FSRGetInitStatus, see ContextInitTask.
+    enum InitStatus
+    {
+        INIT_STATUS_NONE = 0,
+        INIT_STATUS_PENDING,
+        INIT_STATUS_READY,
+        INIT_STATUS_FAILED
+    };
+
+    // Returned by FSRInit and the dispatch entry points while an asynchronous context creation is pending.
+    static constexpr uint32_t ReturnNotReady = 0x4E524459u;
+
 public:
     static IUnityInterfaces* UnityInterfaces;
     static IUnityGraphics* UnityGraphics;
     static IUnityLog* UnityLog;
+    static std::atomic<bool> AsyncInit;
 };
 
 #define FSR_LOG(msg) UNITY_LOG(FSRUnityPlugin::UnityLog, msg);
+#define FSR_WARNING(msg) UNITY_LOG_WARNING(FSRUnityPlugin::UnityLog, msg);
 #define FSR_ERROR(msg) UNITY_LOG_ERROR(FSRUnityPlugin::UnityLog, msg);
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "gpumemorybudget.h"
+
+#include <algorithm>
+#include <string>
+
+#include "fsrunityplugin.h"
+
+
+GpuMemoryCharge::GpuMemoryCharge(uint64_t estimatedBytes, uint64_t chargedBytes) : m_EstimatedBytes(estimatedBytes), m_TotalBytes(chargedBytes)
+{
+}
+
+GpuMemoryCharge::~GpuMemoryCharge()
+{
+    GpuMemoryBudget::Instance().Release(m_TotalBytes.load(std::memory_order_relaxed));
+}
+
+void GpuMemoryCharge::Update(const GpuMemoryUsage& usage)
+{
+    m_AliasableBytes.store(usage.aliasableBytes, std::memory_order_relaxed);
+    uint64_t previousBytes = m_TotalBytes.exchange(usage.totalBytes, std::memory_order_relaxed);
+    GpuMemoryBudget::Instance().Adjust(previousBytes, usage.totalBytes);
+    GpuMemoryBudget::Instance().Calibrate(m_EstimatedBytes, usage.totalBytes);
+}
+
+GpuMemoryUsage GpuMemoryCharge::GetUsage() const
+{
+    return GpuMemoryUsage{m_TotalBytes.load(std::memory_order_relaxed), m_AliasableBytes.load(std::memory_order_relaxed)};
+}
+
+GpuMemoryBudget& GpuMemoryBudget::Instance()
+{
+    static GpuMemoryBudget budget;
+    return budget;
+}
+
+void GpuMemoryBudget::SetBudget(uint64_t bytes, bool refuse)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Counters.budgetBytes = bytes;
+    m_Refuse = refuse;
+}
+
+bool GpuMemoryBudget::Fits(uint64_t estimatedBytes, uint64_t releasingBytes) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    const uint64_t usedBytes = m_Counters.usedBytes - (std::min)(m_Counters.usedBytes, releasingBytes);
+    return m_Counters.budgetBytes == 0 || usedBytes + GetCalibratedBytes(estimatedBytes) <= m_Counters.budgetBytes;
+}
+
+std::shared_ptr<GpuMemoryCharge> GpuMemoryBudget::Charge(uint64_t estimatedBytes)
+{
+    uint64_t chargedBytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        chargedBytes = GetCalibratedBytes(estimatedBytes);
+        if (m_Counters.budgetBytes != 0 && m_Counters.usedBytes + chargedBytes > m_Counters.budgetBytes) {
+            std::string message = "FFX context needs about " + std::to_string(chargedBytes >> 20) + " MiB of GPU memory, " +
+                std::to_string(m_Counters.usedBytes >> 20) + " of the " + std::to_string(m_Counters.budgetBytes >> 20) + " MiB budget are in use";
+            if (m_Refuse) {
+                ++m_Counters.refusedCount;
+                FSR_ERROR(message.c_str());
+                return nullptr;
+            }
+            FSR_WARNING(message.c_str());
+        }
+        m_Counters.usedBytes += chargedBytes;
+        m_Counters.peakUsedBytes = (std::max)(m_Counters.peakUsedBytes, m_Counters.usedBytes);
+        ++m_Counters.contextCount;
+    }
+    return std::make_shared<GpuMemoryCharge>(estimatedBytes, chargedBytes);
+}
+
+GpuMemoryBudgetCounters GpuMemoryBudget::GetCounters() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Counters;
+}
+
+void GpuMemoryBudget::Adjust(uint64_t releasedBytes, uint64_t chargedBytes)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Counters.usedBytes = m_Counters.usedBytes - releasedBytes + chargedBytes;
+    m_Counters.peakUsedBytes = (std::max)(m_Counters.peakUsedBytes, m_Counters.usedBytes);
+}
+
+void GpuMemoryBudget::Release(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Counters.usedBytes -= bytes;
+    --m_Counters.contextCount;
+}
+
+void GpuMemoryBudget::Calibrate(uint64_t estimatedBytes, uint64_t reportedBytes)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (estimatedBytes != 0 && reportedBytes != 0) {
+        m_CalibrationEstimatedBytes = estimatedBytes;
+        m_CalibrationReportedBytes = reportedBytes;
+    }
+}
+
+uint64_t GpuMemoryBudget::GetCalibratedBytes(uint64_t estimatedBytes) const
+{
+    if (m_CalibrationEstimatedBytes == 0 || estimatedBytes == m_CalibrationEstimatedBytes) {
+        return m_CalibrationEstimatedBytes == 0 ? estimatedBytes : m_CalibrationReportedBytes;
+    }
+    return static_cast<uint64_t>(static_cast<double>(estimatedBytes) * m_CalibrationReportedBytes / m_CalibrationEstimatedBytes);
+}
+
+uint64_t EstimateUpscalerMemory(uint32_t maxRenderWidth, uint32_t maxRenderHeight, uint32_t displayWidth, uint32_t displayHeight)
+{
+    // Two frames of history in 16-bit color, lock status and luma at display size, dilated depth, motion vectors,
+    // prepared color and masks at render size, and a fixed share for lookup tables and the luminance pyramid.
+    const uint64_t bytesPerDisplayPixel = 36;
+    const uint64_t bytesPerRenderPixel = 32;
+    const uint64_t fixedBytes = 1 << 20;
+    return uint64_t(displayWidth) * displayHeight * bytesPerDisplayPixel + uint64_t(maxRenderWidth) * maxRenderHeight * bytesPerRenderPixel + fixedBytes;
+}
+
+uint64_t GetTextureMemory(uint32_t width, uint32_t height, uint32_t depth, uint32_t mipCount, uint32_t bytesPerPixel)
+{
+    uint64_t bytes = 0;
+    for (uint32_t mip = 0; mip < (std::max)(mipCount, 1u); ++mip) {
+        bytes += uint64_t((std::max)(width >> mip, 1u)) * (std::max)(height >> mip, 1u) * (std::max)(depth, 1u) * bytesPerPixel;
+    }
+    return bytes;
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+
+struct GpuMemoryUsage
+{
+    uint64_t totalBytes;
+    uint64_t aliasableBytes;
+};
+
+struct GpuMemoryBudgetCounters
+{
+    uint64_t budgetBytes;
+    uint64_t usedBytes;
+    uint64_t peakUsedBytes;
+    uint32_t contextCount;
+    uint32_t refusedCount;
+};
+
+// GPU memory of one FFX context. It stays charged to the device until the charge is released, which happens
+// once the context has been handed to the deferred release queue, not when its instance lets go of it.
+class GpuMemoryCharge
+{
+public:
+    // estimatedBytes is the raw estimate of the context, chargedBytes what the budget charged for it.
+    GpuMemoryCharge(uint64_t estimatedBytes, uint64_t chargedBytes);
+    ~GpuMemoryCharge();
+
+    // Replaces the charge made before the context existed with what was reported for it, and calibrates the
+    // estimates of later contexts with it.
+    void Update(const GpuMemoryUsage& usage);
+    GpuMemoryUsage GetUsage() const;
+
+private:
+    GpuMemoryCharge(const GpuMemoryCharge&) = delete;
+    GpuMemoryCharge& operator=(const GpuMemoryCharge&) = delete;
+
+private:
+    const uint64_t m_EstimatedBytes;
+    std::atomic<uint64_t> m_TotalBytes;
+    std::atomic<uint64_t> m_AliasableBytes = {0};
+};
+
+// Device-wide sum of the charges. The budget is checked against the estimate of a context before it is created,
+// so going over it is reported while the caller can still back off instead of by an allocation failure. Once a
+// context has reported its usage, estimates are scaled by how far off its own estimate was, and one of the same
+// size is charged exactly what it reported.
+class GpuMemoryBudget
+{
+public:
+    static GpuMemoryBudget& Instance();
+
+    // bytes of 0 disables the check. A context that does not fit is refused if refuse is set and only warned
+    // about otherwise.
+    void SetBudget(uint64_t bytes, bool refuse);
+    // Whether a context of estimatedBytes fits without going over the budget, once charges of releasingBytes the
+    // caller is about to release are gone.
+    bool Fits(uint64_t estimatedBytes, uint64_t releasingBytes = 0) const;
+    // Charges a context of estimatedBytes about to be created, nullptr if the budget refuses it.
+    std::shared_ptr<GpuMemoryCharge> Charge(uint64_t estimatedBytes);
+    GpuMemoryBudgetCounters GetCounters() const;
+
+private:
+    friend class GpuMemoryCharge;
+    GpuMemoryBudget() {}
+    void Adjust(uint64_t releasedBytes, uint64_t chargedBytes);
+    void Release(uint64_t bytes);
+    void Calibrate(uint64_t estimatedBytes, uint64_t reportedBytes);
+    uint64_t GetCalibratedBytes(uint64_t estimatedBytes) const;
+
+private:
+    mutable std::mutex m_Mutex;
+    bool m_Refuse = false;
+    GpuMemoryBudgetCounters m_Counters = {};
+    // Estimate and reported usage of the latest context that reported one, 0 until then.
+    uint64_t m_CalibrationEstimatedBytes = 0;
+    uint64_t m_CalibrationReportedBytes = 0;
+};
+
+// Size of the internal resources of an upscaler context with the given limits. Used for the budget check before
+// the provider can be asked, errs on the large side.
+uint64_t EstimateUpscalerMemory(uint32_t maxRenderWidth, uint32_t maxRenderHeight, uint32_t displayWidth, uint32_t displayHeight);
+// Size of a texture including its mip chain.
+uint64_t GetTextureMemory(uint32_t width, uint32_t height, uint32_t depth, uint32_t mipCount, uint32_t bytesPerPixel);
\ No newline at end of file
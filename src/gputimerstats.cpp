@@ -0,0 +1,92 @@
+#include "gputimerstats.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "device.h"
+
+
+void GpuTimerStats::Submit(GpuTimerKind kind, uint64_t timer, uint64_t fenceValue)
+{
+    if (timer == Device::InvalidGpuTimer) {
+        return;
+    }
+    if (m_PendingCount == m_Pending.size()) {
+        m_PendingHead = (m_PendingHead + 1) % m_Pending.size();
+        --m_PendingCount;
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        ++m_LostCount;
+    }
+    m_Pending[(m_PendingHead + m_PendingCount) % m_Pending.size()] = PendingTimer{kind, timer, fenceValue};
+    ++m_PendingCount;
+}
+
+void GpuTimerStats::Collect()
+{
+    // Submissions of one instance complete in order, the first pending timer holds back the rest.
+    while (m_PendingCount > 0) {
+        const PendingTimer& pending = m_Pending[m_PendingHead];
+        uint64_t nanoseconds = 0;
+        GpuTimerStatus status = Device::Instance().ReadGpuTimer(pending.timer, pending.fenceValue, nanoseconds);
+        if (status == GPU_TIMER_PENDING) {
+            break;
+        }
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (status == GPU_TIMER_LOST) {
+            ++m_LostCount;
+        } else {
+            float microseconds = nanoseconds / 1000.0f;
+            Window& window = m_Windows[pending.kind];
+            window.samples[window.next] = microseconds;
+            window.next = (window.next + 1) % WindowSize;
+            window.count = (std::min)(window.count + 1, WindowSize);
+            window.last = microseconds;
+            if (pending.kind == GPU_TIMER_UPSCALE) {
+                m_LastUpscaleTime.store(microseconds / 1000.0f, std::memory_order_relaxed);
+            }
+        }
+        m_PendingHead = (m_PendingHead + 1) % m_Pending.size();
+        --m_PendingCount;
+    }
+}
+
+FSRStats GpuTimerStats::GetStats() const
+{
+    FSRStats stats = {};
+    std::array<float, WindowSize> sorted;
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    stats.lostCount = m_LostCount;
+    GpuTimeStats* kindStats[GPU_TIMER_KIND_COUNT] = {&stats.upscale, &stats.reactiveMask};
+    for (uint32_t kind = 0; kind < GPU_TIMER_KIND_COUNT; ++kind) {
+        const Window& window = m_Windows[kind];
+        if (window.count == 0) {
+            continue;
+        }
+        GpuTimeStats& result = *kindStats[kind];
+        std::copy(window.samples.begin(), window.samples.begin() + window.count, sorted.begin());
+        std::sort(sorted.begin(), sorted.begin() + window.count);
+        float sum = 0.0f;
+        for (uint32_t i = 0; i < window.count; ++i) {
+            sum += sorted[i];
+        }
+        result.sampleCount = window.count;
+        result.lastMicroseconds = window.last;
+        result.meanMicroseconds = sum / window.count;
+        result.minMicroseconds = sorted[0];
+        result.maxMicroseconds = sorted[window.count - 1];
+        // Nearest rank.
+        uint32_t rank = static_cast<uint32_t>(std::ceil(0.95f * window.count));
+        result.p95Microseconds = sorted[(std::max)(rank, 1u) - 1];
+    }
+    return stats;
+}
+
+void GpuTimerStats::Reset()
+{
+    m_PendingHead = 0;
+    m_PendingCount = 0;
+    m_LastUpscaleTime.store(0.0f, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Windows = {};
+    m_LostCount = 0;
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "device.h"
+
+
+// GPU times in microseconds over the last GpuTimerStats::WindowSize recordings of one kind.
+struct GpuTimeStats
+{
+    uint32_t sampleCount;
+    float lastMicroseconds;
+    float meanMicroseconds;
+    float minMicroseconds;
+    float maxMicroseconds;
+    float p95Microseconds;
+};
+
+struct FSRStats
+{
+    // Upscales, including a reactive mask generated in the same event.
+    GpuTimeStats upscale;
+    // Reactive masks generated on their own.
+    GpuTimeStats reactiveMask;
+    // Timers whose queries were reused or turned off before their result could be read.
+    uint64_t lostCount;
+};
+
+enum GpuTimerKind
+{
+    GPU_TIMER_UPSCALE = 0,
+    GPU_TIMER_REACTIVE_MASK,
+    GPU_TIMER_KIND_COUNT
+};
+
+// GPU time of an instance's recordings. A timer is queued once its command list is submitted and read by a later
+// recording after the submission has completed, so results trail the GPU by a few frames and nothing waits for
+// them. While timestamps are off nothing is queued and Collect returns at once.
+class GpuTimerStats
+{
+public:
+    static constexpr uint32_t WindowSize = 128;
+
+    // Ignores Device::InvalidGpuTimer.
+    void Submit(GpuTimerKind kind, uint64_t timer, uint64_t fenceValue);
+    // Reads the queued timers that have a result, on the render thread.
+    void Collect();
+    // Latest upscale in milliseconds, 0 until one has been measured.
+    float GetLastUpscaleTime() const { return m_LastUpscaleTime.load(std::memory_order_relaxed); }
+    FSRStats GetStats() const;
+    // Drops the statistics and the queued timers, for a new context.
+    void Reset();
+
+private:
+    struct PendingTimer
+    {
+        GpuTimerKind kind;
+        uint64_t timer;
+        uint64_t fenceValue;
+    };
+    struct Window
+    {
+        std::array<float, WindowSize> samples;
+        uint32_t count;
+        uint32_t next;
+        float last;
+    };
+    // Ring of queued timers in submission order. It holds as many as the device has timers, a timer older than
+    // that has had its queries reused.
+    std::array<PendingTimer, Device::GpuTimerCapacity> m_Pending = {};
+    uint32_t m_PendingHead = 0;
+    uint32_t m_PendingCount = 0;
+    std::atomic<float> m_LastUpscaleTime = {0.0f};
+
+    mutable std::mutex m_Mutex;
+    std::array<Window, GPU_TIMER_KIND_COUNT> m_Windows = {};
+    uint64_t m_LostCount = 0;
+};
\ No newline at end of file
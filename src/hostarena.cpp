@@ -0,0 +1,176 @@
+#include "hostarena.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+
+HostArena::~HostArena()
+{
+    // One free per page and per large block still live, the blocks inside the pages are never visited.
+    for (Chunk* list : {m_Pages, m_LargeBlocks}) {
+        while (list != nullptr) {
+            Chunk* next = list->next;
+            std::free(list);
+            list = next;
+        }
+    }
+}
+
+void* HostArena::Allocate(uint64_t size)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    size = (std::max)(size, static_cast<uint64_t>(1));
+    void* memory = nullptr;
+    if (m_Transient) {
+        memory = AllocateTransient(size);
+    }
+    if (memory == nullptr) {
+        memory = sizeof(BlockHeader) + size <= MaxSizeClassSize ? AllocatePooled(size) : AllocateLarge(size);
+    }
+    return memory;
+}
+
+void HostArena::Free(void* memory)
+{
+    if (memory == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    BlockHeader* header = static_cast<BlockHeader*>(memory) - 1;
+    m_Counters.usedBytes -= header->size;
+    --m_Counters.liveAllocationCount;
+    switch (header->kind) {
+    case BLOCK_POOLED:
+    {
+        // The free list link overwrites the header.
+        uint32_t sizeClass = header->sizeClass;
+        *reinterpret_cast<void**>(header) = m_FreeLists[sizeClass];
+        m_FreeLists[sizeClass] = header;
+        break;
+    }
+    case BLOCK_TRANSIENT:
+        if (--m_TransientLive == 0) {
+            m_TransientOffset = 0;
+        }
+        break;
+    case BLOCK_LARGE:
+        FreeChunk(reinterpret_cast<Chunk*>(header) - 1, m_LargeBlocks);
+        break;
+    }
+}
+
+void HostArena::SetTransient(bool transient)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Transient = transient;
+}
+
+HostArenaCounters HostArena::GetCounters() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Counters;
+}
+
+HostArena::Chunk* HostArena::AllocateChunk(uint64_t size, Chunk*& list)
+{
+    uint64_t total = sizeof(Chunk) + size;
+    if (m_Limit != 0 && m_Counters.reservedBytes + total > m_Limit) {
+        return nullptr;
+    }
+    Chunk* chunk = static_cast<Chunk*>(std::malloc(static_cast<size_t>(total)));
+    if (chunk == nullptr) {
+        return nullptr;
+    }
+    chunk->prev = nullptr;
+    chunk->next = list;
+    chunk->size = total;
+    if (list != nullptr) {
+        list->prev = chunk;
+    }
+    list = chunk;
+    m_Counters.reservedBytes += total;
+    return chunk;
+}
+
+void HostArena::FreeChunk(Chunk* chunk, Chunk*& list)
+{
+    if (chunk->prev != nullptr) {
+        chunk->prev->next = chunk->next;
+    } else {
+        list = chunk->next;
+    }
+    if (chunk->next != nullptr) {
+        chunk->next->prev = chunk->prev;
+    }
+    m_Counters.reservedBytes -= chunk->size;
+    std::free(chunk);
+}
+
+void* HostArena::AllocatePooled(uint64_t size)
+{
+    uint32_t sizeClass = 0;
+    while ((Alignment << sizeClass) < sizeof(BlockHeader) + size) {
+        ++sizeClass;
+    }
+    size_t blockSize = Alignment << sizeClass;
+    void* block = m_FreeLists[sizeClass];
+    if (block != nullptr) {
+        m_FreeLists[sizeClass] = *static_cast<void**>(block);
+    } else {
+        if (m_PoolCursor == nullptr || static_cast<size_t>(m_PoolEnd - m_PoolCursor) < blockSize) {
+            // The tail of the previous page is abandoned, at most one block of the largest class.
+            Chunk* page = AllocateChunk(PageSize, m_Pages);
+            if (page == nullptr) {
+                return nullptr;
+            }
+            m_PoolCursor = reinterpret_cast<char*>(page + 1);
+            m_PoolEnd = m_PoolCursor + PageSize;
+        }
+        block = m_PoolCursor;
+        m_PoolCursor += blockSize;
+    }
+    return Commit(static_cast<BlockHeader*>(block), BLOCK_POOLED, sizeClass, size);
+}
+
+void* HostArena::AllocateTransient(uint64_t size)
+{
+    size_t blockSize = (sizeof(BlockHeader) + static_cast<size_t>(size) + Alignment - 1) & ~(Alignment - 1);
+    if (blockSize > PageSize / 4) {
+        return nullptr;
+    }
+    if (m_TransientBase == nullptr) {
+        Chunk* page = AllocateChunk(PageSize, m_Pages);
+        if (page == nullptr) {
+            return nullptr;
+        }
+        m_TransientBase = reinterpret_cast<char*>(page + 1);
+    }
+    if (PageSize - m_TransientOffset < blockSize) {
+        return nullptr;
+    }
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(m_TransientBase + m_TransientOffset);
+    m_TransientOffset += blockSize;
+    ++m_TransientLive;
+    return Commit(header, BLOCK_TRANSIENT, 0, size);
+}
+
+void* HostArena::AllocateLarge(uint64_t size)
+{
+    Chunk* chunk = AllocateChunk(sizeof(BlockHeader) + size, m_LargeBlocks);
+    if (chunk == nullptr) {
+        return nullptr;
+    }
+    return Commit(reinterpret_cast<BlockHeader*>(chunk + 1), BLOCK_LARGE, 0, size);
+}
+
+void* HostArena::Commit(BlockHeader* header, BlockKind kind, uint32_t sizeClass, uint64_t size)
+{
+    header->kind = kind;
+    header->sizeClass = sizeClass;
+    header->size = size;
+    ++m_Counters.allocationCount;
+    ++m_Counters.liveAllocationCount;
+    m_Counters.usedBytes += size;
+    m_Counters.peakUsedBytes = (std::max)(m_Counters.peakUsedBytes, m_Counters.usedBytes);
+    return header + 1;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+
+struct HostArenaCounters
+{
+    uint64_t reservedBytes;
+    uint64_t usedBytes;
+    uint64_t peakUsedBytes;
+    uint64_t allocationCount;
+    uint64_t liveAllocationCount;
+};
+
+// Host memory of one FFX context. Blocks allocated while the context is being created live as long as it does
+// and come from size-class free lists carved out of fixed pages. Allocations made afterwards are treated as
+// transient and bumped from a page that is rewound once all of them have been freed. Blocks larger than the
+// biggest size class get an allocation of their own. Destroying the arena never visits individual blocks, but
+// it frees each page and each large block still live on its own, so teardown is linear in their number, not
+// constant. A context's host memory is a few dozen pages.
+class HostArena
+{
+public:
+    static constexpr size_t PageSize = 64 * 1024;
+    static constexpr size_t Alignment = 16;
+    static constexpr uint32_t SizeClassCount = 9;
+    static constexpr size_t MaxSizeClassSize = Alignment << (SizeClassCount - 1);
+
+public:
+    // limit caps reservedBytes, 0 for no limit. An allocation that would exceed it fails.
+    explicit HostArena(uint64_t limit = 0) : m_Limit(limit) {}
+    ~HostArena();
+
+    void* Allocate(uint64_t size);
+    void Free(void* memory);
+    // Switched on once the context exists.
+    void SetTransient(bool transient);
+    HostArenaCounters GetCounters() const;
+
+private:
+    HostArena(const HostArena&) = delete;
+    HostArena& operator=(const HostArena&) = delete;
+
+    enum BlockKind : uint32_t
+    {
+        BLOCK_POOLED = 0,
+        BLOCK_TRANSIENT,
+        BLOCK_LARGE
+    };
+
+    // Precedes every block, keeps the payload aligned.
+    struct alignas(Alignment) BlockHeader
+    {
+        uint32_t kind;
+        uint32_t sizeClass;
+        uint64_t size;
+    };
+
+    // Precedes every page and large block, large blocks are unlinked when freed.
+    struct alignas(Alignment) Chunk
+    {
+        Chunk* prev;
+        Chunk* next;
+        uint64_t size;
+    };
+
+    Chunk* AllocateChunk(uint64_t size, Chunk*& list);
+    void FreeChunk(Chunk* chunk, Chunk*& list);
+    void* AllocatePooled(uint64_t size);
+    void* AllocateTransient(uint64_t size);
+    void* AllocateLarge(uint64_t size);
+    void* Commit(BlockHeader* header, BlockKind kind, uint32_t sizeClass, uint64_t size);
+
+private:
+    mutable std::mutex m_Mutex;
+    const uint64_t m_Limit;
+    bool m_Transient = false;
+
+    Chunk* m_Pages = nullptr;
+    Chunk* m_LargeBlocks = nullptr;
+
+    void* m_FreeLists[SizeClassCount] = {};
+    char* m_PoolCursor = nullptr;
+    char* m_PoolEnd = nullptr;
+
+    char* m_TransientBase = nullptr;
+    size_t m_TransientOffset = 0;
+    uint64_t m_TransientLive = 0;
+
+    HostArenaCounters m_Counters = {};
+};
\ No newline at end of file
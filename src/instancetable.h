@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+// Fixed-capacity table of per-instance records indexed by the 16-bit instance ID that the C# side packs
+// into the upper half of the render event ID. Finding an existing record is a single acquire load, so the
+// render thread never waits on the main thread. A record is created on first use and published with a
+// compare-exchange, so concurrent creators agree on one record. Records live as long as the table: the
+// render thread may still be inside an instance while the main thread destroys it, so freeing the record
+// would need a reclamation scheme on every lookup. Destroying an instance releases its context instead,
+// and a record left behind is only the instance object itself.
+template<typename T>
+class InstanceTable
+{
+public:
+    static constexpr uint32_t Capacity = 1u << 16;
+    static constexpr size_t CacheLineSize = 64;
+
+public:
+    InstanceTable() = default;
+    ~InstanceTable()
+    {
+        for (auto& slot : m_Slots) {
+            delete slot.exchange(nullptr, std::memory_order_acq_rel);
+        }
+    }
+
+    // Returns nullptr for an ID outside the table or a record not created yet.
+    T* Find(uint32_t id) const
+    {
+        if (id >= Capacity) {
+            return nullptr;
+        }
+        Record* record = m_Slots[id].load(std::memory_order_acquire);
+        return record != nullptr ? &record->instance : nullptr;
+    }
+
+    // Creates the record on first use, returns nullptr for an ID outside the table.
+    T* Get(uint32_t id)
+    {
+        if (id >= Capacity) {
+            return nullptr;
+        }
+        Record* record = m_Slots[id].load(std::memory_order_acquire);
+        if (record == nullptr) {
+            Record* newRecord = new Record();
+            if (m_Slots[id].compare_exchange_strong(record, newRecord, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                record = newRecord;
+            } else {
+                delete newRecord;
+            }
+        }
+        return &record->instance;
+    }
+
+private:
+    InstanceTable(const InstanceTable&) = delete;
+    InstanceTable& operator=(const InstanceTable&) = delete;
+
+private:
+    // Each record gets its own cache lines so instances driven from different threads do not false-share.
+    struct alignas(CacheLineSize) Record
+    {
+        T instance;
+    };
+    std::atomic<Record*> m_Slots[Capacity] = {};
+};
\ No newline at end of file
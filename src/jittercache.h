@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+using JitterSequence = std::vector<std::array<float, 2>>;
+static_assert(sizeof(JitterSequence::value_type) == 2 * sizeof(float), "jitter offsets are copied out as float pairs");
+
+// Jitter sequences keyed by (renderWidth, displayWidth). A sequence depends only on the two widths, so it is
+// generated once on first request and shared by every instance. Sequences are never modified or freed while
+// the cache lives, and the most recently used one is found with a single acquire load.
+class JitterCache
+{
+public:
+    JitterCache() = default;
+
+    // generate(renderWidth, displayWidth, sequence) fills sequence and returns false on failure. A failed key is
+    // not generated again, so a caller asking every frame logs its failure once, until ClearFailures().
+    template<typename Generate>
+    const JitterSequence* Get(int32_t renderWidth, int32_t displayWidth, Generate generate)
+    {
+        uint64_t key = MakeKey(renderWidth, displayWidth);
+        const Entry* last = m_Last.load(std::memory_order_acquire);
+        if (last != nullptr && last->key == key) {
+            return &last->sequence;
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto found = m_Entries.find(key);
+        if (found == m_Entries.end()) {
+            if (m_Failed.count(key) != 0) {
+                return nullptr;
+            }
+            std::unique_ptr<Entry> entry(new Entry{key, {}});
+            if (!generate(renderWidth, displayWidth, entry->sequence) || entry->sequence.empty()) {
+                m_Failed.insert(key);
+                return nullptr;
+            }
+            found = m_Entries.emplace(key, std::move(entry)).first;
+        }
+        m_Last.store(found->second.get(), std::memory_order_release);
+        return &found->second->sequence;
+    }
+
+    // Lets the failed keys be generated again, e.g. once the FFX libraries have loaded.
+    void ClearFailures()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Failed.clear();
+    }
+
+private:
+    JitterCache(const JitterCache&) = delete;
+    JitterCache& operator=(const JitterCache&) = delete;
+
+    static uint64_t MakeKey(int32_t renderWidth, int32_t displayWidth)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(renderWidth)) << 32) | static_cast<uint32_t>(displayWidth);
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        JitterSequence sequence;
+    };
+    std::mutex m_Mutex;
+    std::unordered_map<uint64_t, std::unique_ptr<Entry>> m_Entries;
+    std::unordered_set<uint64_t> m_Failed;
+    std::atomic<const Entry*> m_Last = {nullptr};
+};
+
+// Offset of frame index within sequence, wrapping the same way as the FFX jitter functions.
+inline std::array<float, 2> GetJitterOffset(const JitterSequence* sequence, int32_t index)
+{
+    if (sequence == nullptr) {
+        return {};
+    }
+    int32_t count = static_cast<int32_t>(sequence->size());
+    int32_t phase = index % count;
+    return (*sequence)[phase < 0 ? phase + count : phase];
+}
\ No newline at end of file
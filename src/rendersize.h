@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+
+// Envelope of the render sizes an instance dispatches at. The maximum is what the context's render resolution
+// resources are allocated for, the minimum is the display size divided by the largest upscale ratio.
+struct RenderSizeLimits
+{
+    uint32_t displayWidth;
+    uint32_t displayHeight;
+    uint32_t maxWidth;
+    uint32_t maxHeight;
+    uint32_t minWidth;
+    uint32_t minHeight;
+};
+
+// A max render size with a zero dimension stands for the display size, a ratio below 1 for no lower bound.
+inline RenderSizeLimits GetRenderSizeLimits(uint32_t displayWidth, uint32_t displayHeight, uint32_t maxRenderWidth, uint32_t maxRenderHeight, float maxUpscaleRatio)
+{
+    RenderSizeLimits limits = {};
+    limits.displayWidth = displayWidth;
+    limits.displayHeight = displayHeight;
+    bool hasMaxRenderSize = maxRenderWidth != 0 && maxRenderHeight != 0;
+    limits.maxWidth = hasMaxRenderSize ? maxRenderWidth : displayWidth;
+    limits.maxHeight = hasMaxRenderSize ? maxRenderHeight : displayHeight;
+    limits.minWidth = 1;
+    limits.minHeight = 1;
+    if (maxUpscaleRatio >= 1.0f) {
+        limits.minWidth = static_cast<uint32_t>(std::ceil(displayWidth / maxUpscaleRatio));
+        limits.minHeight = static_cast<uint32_t>(std::ceil(displayHeight / maxUpscaleRatio));
+    }
+    limits.minWidth = (std::max)((std::min)(limits.minWidth, limits.maxWidth), 1u);
+    limits.minHeight = (std::max)((std::min)(limits.minHeight, limits.maxHeight), 1u);
+    return limits;
+}
+
+// Render sizes above the maximum would address past the context's resources. Sizes below the minimum are left
+// alone, the input holds only that many pixels.
+inline void ClampRenderSize(const RenderSizeLimits& limits, uint32_t& width, uint32_t& height)
+{
+    width = (std::min)(width, limits.maxWidth);
+    height = (std::min)(height, limits.maxHeight);
+}
+
+// Same values as the FFX quality modes.
+enum QualityMode : uint32_t
+{
+    QUALITY_MODE_NATIVE_AA = 0,
+    QUALITY_MODE_QUALITY,
+    QUALITY_MODE_BALANCED,
+    QUALITY_MODE_PERFORMANCE,
+    QUALITY_MODE_ULTRA_PERFORMANCE,
+    QUALITY_MODE_COUNT
+};
+
+struct RenderResolution
+{
+    uint32_t width;
+    uint32_t height;
+    float upscaleRatio;
+};
+
+// Display to render size ratio FSR 2 and 3 use for a quality mode, 0 for an unknown mode.
+inline float GetQualityModeUpscaleRatio(uint32_t qualityMode)
+{
+    static const float ratios[QUALITY_MODE_COUNT] = {1.0f, 1.5f, 1.7f, 2.0f, 3.0f};
+    return qualityMode < QUALITY_MODE_COUNT ? ratios[qualityMode] : 0.0f;
+}
+
+// Rounds down like the FFX render resolution functions.
+inline bool GetQualityModeRenderResolution(uint32_t qualityMode, uint32_t displayWidth, uint32_t displayHeight, RenderResolution& resolution)
+{
+    float ratio = GetQualityModeUpscaleRatio(qualityMode);
+    if (ratio == 0.0f) {
+        return false;
+    }
+    resolution.width = static_cast<uint32_t>(displayWidth / ratio);
+    resolution.height = static_cast<uint32_t>(displayHeight / ratio);
+    resolution.upscaleRatio = ratio;
+    return true;
+}
+
+// Query results keyed by quality mode, display size and provider version. Each one is resolved once, on first
+// request, failures are not cached.
+template<typename Value>
+class QualityModeCache
+{
+public:
+    // resolve(value) fills in the result of the key and returns false on failure.
+    template<typename Resolve>
+    bool Get(uint32_t qualityMode, uint32_t displayWidth, uint32_t displayHeight, uint64_t versionId, Value& value, Resolve resolve)
+    {
+        Key key(qualityMode, displayWidth, displayHeight, versionId);
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto found = m_Entries.find(key);
+        if (found == m_Entries.end()) {
+            Value resolved = {};
+            if (!resolve(resolved)) {
+                return false;
+            }
+            found = m_Entries.emplace(key, resolved).first;
+        }
+        value = found->second;
+        return true;
+    }
+
+private:
+    using Key = std::tuple<uint32_t, uint32_t, uint32_t, uint64_t>;
+    std::mutex m_Mutex;
+    std::map<Key, Value> m_Entries;
+};
+
+using RenderResolutionCache = QualityModeCache<RenderResolution>;
+// Upscale ratios do not depend on the display size, they are cached at 0x0.
+using UpscaleRatioCache = QualityModeCache<float>;
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "resolutiongovernor.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+    // Weight of the newest frame in the filtered frame time, damps single-frame spikes.
+    const float FrameTimeSmoothing = 0.5f;
+    // Largest change of the log area per frame.
+    const float MaxStep = 0.5f;
+
+    uint32_t QuantizeSize(float size, uint32_t minSize, uint32_t maxSize)
+    {
+        uint32_t quantized = static_cast<uint32_t>(size) / ResolutionGovernor::SizeGranularity * ResolutionGovernor::SizeGranularity;
+        return (std::min)((std::max)(quantized, minSize), maxSize);
+    }
+}
+
+void ResolutionGovernor::Configure(const GovernorParam& param)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Param = param;
+    m_Param.proportionalGain = param.proportionalGain > 0.0f ? param.proportionalGain : DefaultProportionalGain;
+    m_Param.integralGain = param.integralGain > 0.0f ? param.integralGain : DefaultIntegralGain;
+    m_Param.derivativeGain = param.derivativeGain > 0.0f ? param.derivativeGain : DefaultDerivativeGain;
+    m_Param.deadband = param.deadband > 0.0f ? param.deadband : DefaultDeadband;
+    Reset();
+}
+
+void ResolutionGovernor::SetLimits(const RenderSizeLimits& limits)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Limits = limits;
+    Reset();
+}
+
+void ResolutionGovernor::Update(float frameTime, float upscaleTime)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    const float target = m_Param.targetFrameTime;
+    if (target <= 0.0f || frameTime <= 0.0f || m_Limits.maxWidth == 0 || m_Limits.maxHeight == 0) {
+        return;
+    }
+    m_FilteredFrameTime = m_FilteredFrameTime > 0.0f ? m_FilteredFrameTime + FrameTimeSmoothing * (frameTime - m_FilteredFrameTime) : frameTime;
+    if (std::fabs(target - m_FilteredFrameTime) <= m_Param.deadband * target) {
+        m_Error[0] = 0.0f;
+        m_Error[1] = 0.0f;
+        return;
+    }
+
+    float scaledTime = (std::max)(m_FilteredFrameTime - (std::max)(upscaleTime, 0.0f), 0.1f * target);
+    float error = (target - m_FilteredFrameTime) / scaledTime;
+    float step = m_Param.proportionalGain * (error - m_Error[0]) + m_Param.integralGain * error +
+        m_Param.derivativeGain * (error - 2.0f * m_Error[0] + m_Error[1]);
+    m_Error[1] = m_Error[0];
+    m_Error[0] = error;
+
+    float minAreaScale = static_cast<float>(m_Limits.minWidth) * m_Limits.minHeight / (static_cast<float>(m_Limits.maxWidth) * m_Limits.maxHeight);
+    m_AreaScale = (std::min)((std::max)(m_AreaScale * std::exp((std::min)((std::max)(step, -MaxStep), MaxStep)), minAreaScale), 1.0f);
+    float linearScale = std::sqrt(m_AreaScale);
+    m_Width = QuantizeSize(m_Limits.maxWidth * linearScale, m_Limits.minWidth, m_Limits.maxWidth);
+    m_Height = QuantizeSize(m_Limits.maxHeight * linearScale, m_Limits.minHeight, m_Limits.maxHeight);
+}
+
+bool ResolutionGovernor::IsEnabled() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Param.targetFrameTime > 0.0f;
+}
+
+void ResolutionGovernor::GetRenderSize(uint32_t& width, uint32_t& height) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    width = m_Width;
+    height = m_Height;
+}
+
+void ResolutionGovernor::Reset()
+{
+    m_AreaScale = 1.0f;
+    m_FilteredFrameTime = 0.0f;
+    m_Error[0] = 0.0f;
+    m_Error[1] = 0.0f;
+    m_Width = m_Limits.maxWidth;
+    m_Height = m_Limits.maxHeight;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "rendersize.h"
+
+
+struct GovernorParam
+{
+    // Frame time to hold in milliseconds, 0 turns the governor off.
+    float targetFrameTime;
+    // Gains of the controller, 0 picks the default of each.
+    float proportionalGain;
+    float integralGain;
+    float derivativeGain;
+    // Frame times within this fraction of the target leave the render size alone, 0 picks the default.
+    float deadband;
+};
+
+struct GovernorResult
+{
+    uint32_t renderSizeWidth;
+    uint32_t renderSizeHeight;
+    int32_t jitterPhaseCount;
+};
+
+// Picks the render size of the next frame from the time the last frames took. The controlled quantity is the
+// fraction of the maximum render area. Only the part of a frame that is not the upscale scales with that area,
+// so the error is the headroom relative to that part. The controller runs in velocity form, each frame
+// multiplies the area by exp(Kp * (e - e1) + Ki * e + Kd * (e - 2 * e1 + e2)), which makes the integral term
+// the one that settles it and keeps it from winding up against the limits.
+class ResolutionGovernor
+{
+public:
+    static constexpr float DefaultProportionalGain = 0.2f;
+    static constexpr float DefaultIntegralGain = 0.6f;
+    static constexpr float DefaultDerivativeGain = 0.05f;
+    static constexpr float DefaultDeadband = 0.05f;
+    // Render sizes move in steps of this many pixels, so a settled frame time does not resize every frame.
+    static constexpr uint32_t SizeGranularity = 8;
+
+public:
+    void Configure(const GovernorParam& param);
+    // Called when the context is created, starts again from the maximum render size.
+    void SetLimits(const RenderSizeLimits& limits);
+    // frameTime is the frame that was just dispatched, upscaleTime the GPU time of its upscale, both in
+    // milliseconds. upscaleTime may be 0 if it is not known.
+    void Update(float frameTime, float upscaleTime);
+    bool IsEnabled() const;
+    // Render size for the next frame, the maximum while the governor is off.
+    void GetRenderSize(uint32_t& width, uint32_t& height) const;
+
+private:
+    void Reset();
+
+private:
+    mutable std::mutex m_Mutex;
+    GovernorParam m_Param = {};
+    RenderSizeLimits m_Limits = {};
+    float m_AreaScale = 1.0f;
+    float m_FilteredFrameTime = 0.0f;
+    float m_Error[2] = {};
+    uint32_t m_Width = 0;
+    uint32_t m_Height = 0;
+};
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include "fsrunityplugin.h"
+
+
+std::atomic<bool> Trace::s_Enabled = {false};
+
+namespace
+{
+    // Written by the owning thread and read by Write while it may be overwritten. The sequence is odd while
+    // the event is being written and 2 * index + 2 once event number index is complete, Write skips an event
+    // whose sequence changed under it.
+    struct Event
+    {
+        std::atomic<uint64_t> sequence;
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> begin;
+        std::atomic<uint64_t> end;
+        std::atomic<uint32_t> threadId;
+    };
+
+    // A thread takes a free buffer on its first event and gives it back when it exits, so short-lived worker
+    // threads reuse buffers instead of adding new ones.
+    struct ThreadBuffer
+    {
+        std::unique_ptr<Event[]> events;
+        std::atomic<uint64_t> head;
+        std::atomic<bool> inUse;
+        // Events up to here have been written out, only touched by Write.
+        uint64_t written;
+    };
+
+    struct TraceEvent
+    {
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+        uint32_t threadId;
+    };
+
+    std::mutex s_BufferMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>>& GetBuffers()
+    {
+        static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        return buffers;
+    }
+
+    uint32_t GetTraceThreadId()
+    {
+#if defined(_WIN32)
+        return static_cast<uint32_t>(GetCurrentThreadId());
+#elif defined(__linux__)
+        return static_cast<uint32_t>(syscall(SYS_gettid));
+#else
+        static std::atomic<uint32_t> s_NextThreadId = {1};
+        return s_NextThreadId++;
+#endif
+    }
+
+    uint32_t GetTraceProcessId()
+    {
+#if defined(_WIN32)
+        return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+        return static_cast<uint32_t>(getpid());
+#endif
+    }
+
+    ThreadBuffer* AcquireBuffer()
+    {
+        std::lock_guard<std::mutex> lock(s_BufferMutex);
+        std::vector<std::unique_ptr<ThreadBuffer>>& buffers = GetBuffers();
+        for (std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+            bool inUse = false;
+            if (buffer->inUse.compare_exchange_strong(inUse, true)) {
+                return buffer.get();
+            }
+        }
+        std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer);
+        buffer->events.reset(new Event[Trace::EventsPerThread]);
+        for (uint32_t i = 0; i < Trace::EventsPerThread; ++i) {
+            buffer->events[i].sequence.store(0, std::memory_order_relaxed);
+        }
+        buffer->head.store(0, std::memory_order_relaxed);
+        buffer->inUse.store(true, std::memory_order_relaxed);
+        buffer->written = 0;
+        buffers.push_back(std::move(buffer));
+        return buffers.back().get();
+    }
+
+    struct ThreadState
+    {
+        ThreadBuffer* buffer = nullptr;
+        uint32_t threadId = GetTraceThreadId();
+
+        ~ThreadState()
+        {
+            if (buffer != nullptr) {
+                buffer->inUse.store(false, std::memory_order_release);
+            }
+        }
+    };
+    thread_local ThreadState t_ThreadState;
+}
+
+void Trace::SetEnabled(bool enabled)
+{
+    s_Enabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t Trace::Now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Trace::Record(const char* name, uint64_t begin, uint64_t end)
+{
+    ThreadState& state = t_ThreadState;
+    if (state.buffer == nullptr) {
+        state.buffer = AcquireBuffer();
+    }
+    ThreadBuffer& buffer = *state.buffer;
+    uint64_t index = buffer.head.load(std::memory_order_relaxed);
+    Event& event = buffer.events[index % EventsPerThread];
+    event.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    event.threadId.store(state.threadId, std::memory_order_relaxed);
+    event.sequence.store(2 * index + 2, std::memory_order_release);
+    buffer.head.store(index + 1, std::memory_order_release);
+}
+
+bool Trace::Write(const char* path)
+{
+    if (path == nullptr) {
+        return false;
+    }
+    std::vector<TraceEvent> events;
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(s_BufferMutex);
+        for (std::unique_ptr<ThreadBuffer>& buffer : GetBuffers()) {
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t first = head > EventsPerThread ? head - EventsPerThread : 0;
+            if (first > buffer->written) {
+                dropped += first - buffer->written;
+            } else {
+                first = buffer->written;
+            }
+            for (uint64_t index = first; index < head; ++index) {
+                const Event& event = buffer->events[index % EventsPerThread];
+                uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+                TraceEvent copy = {event.name.load(std::memory_order_relaxed), event.begin.load(std::memory_order_relaxed),
+                    event.end.load(std::memory_order_relaxed), event.threadId.load(std::memory_order_relaxed)};
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence != 2 * index + 2 || event.sequence.load(std::memory_order_relaxed) != sequence) {
+                    ++dropped;
+                    continue;
+                }
+                events.push_back(copy);
+            }
+            buffer->written = head;
+        }
+    }
+
+    FILE* file = std::fopen(path, "w");
+    if (file == nullptr) {
+        std::string message = std::string("Failed to write the trace to ") + path;
+        FSR_ERROR(message.c_str());
+        return false;
+    }
+    std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.begin < b.begin; });
+    const uint32_t processId = GetTraceProcessId();
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"droppedEvents\":%llu},\"traceEvents\":[", static_cast<unsigned long long>(dropped));
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent& event = events[i];
+        // Timestamps are in microseconds, the fraction keeps the nanoseconds.
+        std::fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"fsr\",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":%u,\"tid\":%u}",
+            i == 0 ? "" : ",", event.name,
+            static_cast<unsigned long long>(event.begin / 1000), static_cast<uint32_t>(event.begin % 1000),
+            static_cast<unsigned long long>((event.end - event.begin) / 1000), static_cast<uint32_t>((event.end - event.begin) % 1000),
+            processId, event.threadId);
+    }
+    std::fprintf(file, "\n]}\n");
+    bool written = std::ferror(file) == 0;
+    written &= std::fclose(file) == 0;
+    return written;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+// Opt-in timeline of the plugin's CPU work. Each thread records the scopes it runs into a ring of its own,
+// Write turns them into a Chrome trace that chrome://tracing and Perfetto open.
+class Trace
+{
+public:
+    // Each thread keeps this many of its latest events, older ones are overwritten.
+    static constexpr uint32_t EventsPerThread = 8192;
+
+public:
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled() { return s_Enabled.load(std::memory_order_relaxed); }
+    // Writes the events recorded since the last write as JSON and drops them. Returns false if the file cannot
+    // be written.
+    static bool Write(const char* path);
+
+    // Nanoseconds on a steady clock.
+    static uint64_t Now();
+    // name has to outlive the trace, a string literal in practice.
+    static void Record(const char* name, uint64_t begin, uint64_t end);
+
+private:
+    static std::atomic<bool> s_Enabled;
+};
+
+// Records the time from construction to destruction as one event. Costs a flag check while tracing is off.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) : m_Name(Trace::IsEnabled() ? name : nullptr), m_Begin(m_Name != nullptr ? Trace::Now() : 0) {}
+    ~TraceScope()
+    {
+        if (m_Name != nullptr) {
+            Trace::Record(m_Name, m_Begin, Trace::Now());
+        }
+    }
+
+private:
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_Name;
+    uint64_t m_Begin;
+};
+
+#define FSR_TRACE_CONCAT_(a, b) a##b
+#define FSR_TRACE_CONCAT(a, b) FSR_TRACE_CONCAT_(a, b)
+#define FSR_TRACE_SCOPE(name) TraceScope FSR_TRACE_CONCAT(traceScope, __LINE__)(name)
\ No newline at end of file